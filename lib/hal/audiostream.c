@@ -0,0 +1,596 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hal/audio.h>
+#include <hal/audiostream.h>
+#include <windows.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+// Playback is done in three stages, so that neither the file system nor the
+// decoder ever run in the audio DPC:
+//
+// - Two read buffers are kept in flight with overlapped NtReadFile requests.
+//   While one of them is being decoded, the next chunk of the file is already
+//   being read into the other one.
+// - A worker thread decodes from the read buffers into two contiguous output
+//   buffers and hands them to XAudioProvideSamples().
+// - The XAudio DPC callback only marks a buffer as played and wakes the
+//   worker thread up.
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IMA_ADPCM  0x0011
+#define WAVE_FORMAT_XBOX_ADPCM 0x0069
+
+#define STREAM_NUM_BUFFERS 2
+
+// FIXME: Move this constant to a common header file
+#define MAXRAM 0x03FFAFFF
+
+typedef struct
+{
+    unsigned char  *data;
+    IO_STATUS_BLOCK ioStatusBlock;
+    HANDLE          event;
+    ULONG           length;
+    bool            issued;
+    bool            pending;
+    bool            ready;
+} STREAM_READ;
+
+struct XAudioStream
+{
+    HANDLE          file;
+    bool            loop;
+
+    // Format of the file
+    unsigned short  format;
+    unsigned short  channels;
+    unsigned short  blockAlign;
+    unsigned int    samplesPerBlock;
+    ULONG           dataOffset;
+    ULONG           dataSize;
+
+    // Read-ahead state
+    STREAM_READ     reads[2];
+    ULONG           readChunkSize;
+    ULONG           readPosition;
+    unsigned int    currentRead;
+    ULONG           readCursor;
+
+    // Decoded ADPCM block, 16 bit stereo
+    short          *pcm;
+    unsigned int    pcmFrames;
+    unsigned int    pcmCursor;
+
+    // Output buffers in contiguous memory
+    unsigned char  *buffers[STREAM_NUM_BUFFERS];
+    unsigned int    nextBuffer;
+    volatile LONG   freeBuffers;
+
+    KEVENT          refillEvent;
+    HANDLE          thread;
+    volatile bool   stopping;
+    // Set once the last buffer was queued, and once it has been played
+    volatile bool   decoded;
+    volatile bool   finished;
+    // Buffers handed to XAudio that haven't completed yet. Only changed at
+    // DPC level, so the callback sees it in sync with decoded.
+    unsigned int    queuedBuffers;
+};
+
+extern AC97_DEVICE ac97Device;
+
+static const short imaStepTable[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const signed char imaIndexTable[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static inline short imaDecodeNibble(int *predictor, int *index, unsigned char nibble)
+{
+    int step = imaStepTable[*index];
+    int diff = step >> 3;
+
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+
+    if (nibble & 8)
+        *predictor -= diff;
+    else
+        *predictor += diff;
+
+    if (*predictor > 32767) *predictor = 32767;
+    else if (*predictor < -32768) *predictor = -32768;
+
+    *index += imaIndexTable[nibble];
+    if (*index < 0) *index = 0;
+    else if (*index > 88) *index = 88;
+
+    return (short)*predictor;
+}
+
+// Decodes a (possibly truncated) IMA ADPCM block into 16 bit stereo frames.
+// Returns the number of frames written to out.
+static unsigned int imaDecodeBlock(const unsigned char *in, ULONG length, unsigned int channels, short *out)
+{
+    int predictor[2];
+    int index[2];
+    unsigned int headerSize = 4 * channels;
+
+    if (length < headerSize)
+        return 0;
+
+    // Each channel starts with a header which contains the first sample
+    for (unsigned int c = 0; c < channels; c++) {
+        predictor[c] = (short)(in[0] | (in[1] << 8));
+        index[c] = in[2] > 88 ? 88 : in[2];
+        out[c] = (short)predictor[c];
+        in += 4;
+    }
+    if (channels == 1)
+        out[1] = out[0];
+
+    // The header is followed by groups of 4 bytes (8 samples) per channel
+    unsigned int groups = (length - headerSize) / headerSize;
+    for (unsigned int g = 0; g < groups; g++) {
+        short *frame = &out[(1 + g * 8) * 2];
+        for (unsigned int c = 0; c < channels; c++) {
+            for (unsigned int i = 0; i < 4; i++) {
+                unsigned char byte = in[c * 4 + i];
+                frame[(i * 2 + 0) * 2 + c] = imaDecodeNibble(&predictor[c], &index[c], byte & 0xF);
+                frame[(i * 2 + 1) * 2 + c] = imaDecodeNibble(&predictor[c], &index[c], byte >> 4);
+            }
+        }
+        if (channels == 1) {
+            for (unsigned int i = 0; i < 8; i++)
+                frame[i * 2 + 1] = frame[i * 2];
+        }
+        in += headerSize;
+    }
+
+    return 1 + groups * 8;
+}
+
+static NTSTATUS readSynchronous(XAudioStream *stream, ULONG offset, void *buffer, ULONG length, ULONG *bytesRead)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK ioStatusBlock;
+    LARGE_INTEGER byteOffset;
+
+    byteOffset.QuadPart = offset;
+    status = NtReadFile(stream->file, stream->reads[0].event, NULL, NULL, &ioStatusBlock, buffer, length, &byteOffset);
+    if (status == STATUS_PENDING) {
+        NtWaitForSingleObject(stream->reads[0].event, FALSE, NULL);
+        status = ioStatusBlock.Status;
+    }
+    *bytesRead = NT_SUCCESS(status) ? ioStatusBlock.Information : 0;
+    return status;
+}
+
+// Walks the RIFF chunks to locate the "fmt " and "data" chunks
+static bool parseWaveHeader(XAudioStream *stream)
+{
+    unsigned char header[20];
+    ULONG bytesRead;
+    ULONG offset;
+    bool haveFormat = false;
+
+    if (!NT_SUCCESS(readSynchronous(stream, 0, header, 12, &bytesRead)) || bytesRead != 12)
+        return false;
+    if (memcmp(&header[0], "RIFF", 4) || memcmp(&header[8], "WAVE", 4))
+        return false;
+
+    offset = 12;
+    while (true) {
+        if (!NT_SUCCESS(readSynchronous(stream, offset, header, 8, &bytesRead)) || bytesRead != 8)
+            return false;
+
+        ULONG chunkSize = header[4] | (header[5] << 8) | (header[6] << 16) | ((ULONG)header[7] << 24);
+        offset += 8;
+
+        if (!memcmp(&header[0], "fmt ", 4)) {
+            if (chunkSize < 16)
+                return false;
+            ULONG formatSize = chunkSize < sizeof(header) ? chunkSize : sizeof(header);
+            if (!NT_SUCCESS(readSynchronous(stream, offset, header, formatSize, &bytesRead)) || bytesRead != formatSize)
+                return false;
+
+            stream->format = header[0] | (header[1] << 8);
+            stream->channels = header[2] | (header[3] << 8);
+            ULONG sampleRate = header[4] | (header[5] << 8) | (header[6] << 16) | ((ULONG)header[7] << 24);
+            stream->blockAlign = header[12] | (header[13] << 8);
+            unsigned short bitsPerSample = header[14] | (header[15] << 8);
+
+            // The AC97 output always runs at 48kHz
+            if (sampleRate != 48000 || stream->channels < 1 || stream->channels > 2)
+                return false;
+
+            if (stream->format == WAVE_FORMAT_PCM) {
+                if (bitsPerSample != 16 || stream->blockAlign != 2 * stream->channels)
+                    return false;
+            } else if (stream->format == WAVE_FORMAT_IMA_ADPCM || stream->format == WAVE_FORMAT_XBOX_ADPCM) {
+                unsigned int headerSize = 4 * stream->channels;
+                if (bitsPerSample != 4 || stream->blockAlign < headerSize || stream->blockAlign % headerSize)
+                    return false;
+                stream->samplesPerBlock = 1 + (stream->blockAlign - headerSize) / headerSize * 8;
+            } else {
+                return false;
+            }
+            haveFormat = true;
+        } else if (!memcmp(&header[0], "data", 4)) {
+            if (!haveFormat || chunkSize == 0)
+                return false;
+            stream->dataOffset = offset;
+            stream->dataSize = chunkSize;
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        offset += chunkSize + (chunkSize & 1);
+    }
+}
+
+// Starts reading the next chunk of the file into the given read buffer
+static void issueRead(XAudioStream *stream, unsigned int index)
+{
+    STREAM_READ *read = &stream->reads[index];
+    NTSTATUS status;
+    LARGE_INTEGER byteOffset;
+
+    read->issued = false;
+    read->pending = false;
+    read->ready = false;
+    read->length = 0;
+
+    if (stream->readPosition >= stream->dataSize) {
+        if (!stream->loop)
+            return;
+        stream->readPosition = 0;
+    }
+
+    ULONG length = stream->dataSize - stream->readPosition;
+    if (length > stream->readChunkSize)
+        length = stream->readChunkSize;
+
+    byteOffset.QuadPart = stream->dataOffset + stream->readPosition;
+    status = NtReadFile(stream->file, read->event, NULL, NULL, &read->ioStatusBlock, read->data, length, &byteOffset);
+    if (!NT_SUCCESS(status))
+        return;
+
+    read->issued = true;
+    read->pending = (status == STATUS_PENDING);
+    stream->readPosition += length;
+}
+
+// Waits for a read to complete. Returns false if no data is available
+static bool completeRead(XAudioStream *stream, unsigned int index)
+{
+    STREAM_READ *read = &stream->reads[index];
+
+    if (!read->issued)
+        return false;
+
+    if (read->pending) {
+        NtWaitForSingleObject(read->event, FALSE, NULL);
+        read->pending = false;
+    }
+    read->issued = false;
+
+    if (!NT_SUCCESS(read->ioStatusBlock.Status) || read->ioStatusBlock.Information == 0)
+        return false;
+
+    read->length = read->ioStatusBlock.Information;
+    read->ready = true;
+    return true;
+}
+
+// Returns a pointer to up to maxLength bytes of undecoded data, or NULL once
+// the end of the stream has been reached. Whenever a read buffer has been
+// consumed completely, it is immediately refilled in the background.
+static const unsigned char *fetchInput(XAudioStream *stream, ULONG maxLength, ULONG *length)
+{
+    STREAM_READ *read = &stream->reads[stream->currentRead];
+
+    while (!read->ready || stream->readCursor >= read->length) {
+        if (read->ready) {
+            issueRead(stream, stream->currentRead);
+            stream->currentRead ^= 1;
+            stream->readCursor = 0;
+            read = &stream->reads[stream->currentRead];
+        }
+        if (!completeRead(stream, stream->currentRead))
+            return NULL;
+    }
+
+    const unsigned char *data = read->data + stream->readCursor;
+    *length = read->length - stream->readCursor;
+    if (*length > maxLength)
+        *length = maxLength;
+    stream->readCursor += *length;
+    return data;
+}
+
+// Decodes up to size bytes of 16 bit stereo samples into out. Returns the
+// number of bytes written, which is only less than size at the end of the
+// stream.
+static unsigned int fillBuffer(XAudioStream *stream, unsigned char *out, unsigned int size)
+{
+    unsigned int produced = 0;
+
+    while (produced < size) {
+        const unsigned char *in;
+        ULONG length;
+        unsigned int frames = (size - produced) / 4;
+
+        if (stream->format == WAVE_FORMAT_PCM) {
+            in = fetchInput(stream, frames * stream->blockAlign, &length);
+            if (in == NULL)
+                break;
+            frames = length / stream->blockAlign;
+
+            if (stream->channels == 2) {
+                _memcpy_wc(out + produced, in, frames * 4);
+            } else {
+                const short *src = (const short *)in;
+                short *dst = (short *)(out + produced);
+                for (unsigned int i = 0; i < frames; i++) {
+                    dst[i * 2 + 0] = src[i];
+                    dst[i * 2 + 1] = src[i];
+                }
+            }
+        } else {
+            if (stream->pcmCursor == stream->pcmFrames) {
+                // ADPCM blocks never straddle read buffers, as the read size
+                // is a multiple of the block size
+                in = fetchInput(stream, stream->blockAlign, &length);
+                if (in == NULL)
+                    break;
+                stream->pcmFrames = imaDecodeBlock(in, length, stream->channels, stream->pcm);
+                stream->pcmCursor = 0;
+                continue;
+            }
+
+            if (frames > stream->pcmFrames - stream->pcmCursor)
+                frames = stream->pcmFrames - stream->pcmCursor;
+            _memcpy_wc(out + produced, &stream->pcm[stream->pcmCursor * 2], frames * 4);
+            stream->pcmCursor += frames;
+        }
+
+        produced += frames * 4;
+    }
+
+    return produced;
+}
+
+// Decodes into the next output buffer and queues it for playback
+static void submitBuffer(XAudioStream *stream)
+{
+    unsigned char *buffer = stream->buffers[stream->nextBuffer];
+    unsigned int length = fillBuffer(stream, buffer, XAUDIO_STREAM_BUFFER_SIZE);
+    int isFinal = length < XAUDIO_STREAM_BUFFER_SIZE;
+
+    // Serialize with the XAudio DPC
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    if (length != 0) {
+        XAudioProvideSamples(buffer, length, isFinal);
+        stream->queuedBuffers++;
+    }
+    if (isFinal) {
+        stream->decoded = true;
+        // Nothing left playing if the stream ended on a buffer boundary
+        if (stream->queuedBuffers == 0)
+            stream->finished = true;
+    }
+    KfLowerIrql(oldIrql);
+
+    if (length == 0)
+        return;
+
+    stream->nextBuffer = (stream->nextBuffer + 1) % STREAM_NUM_BUFFERS;
+}
+
+// Called from DPC, so this must not touch the file system or the decoder
+static void streamCallback(void *pac97Device, void *data)
+{
+    XAudioStream *stream = (XAudioStream *)data;
+
+    if (stream->queuedBuffers > 0 && --stream->queuedBuffers == 0 && stream->decoded)
+        stream->finished = true;
+
+    InterlockedIncrement(&stream->freeBuffers);
+    KeSetEvent(&stream->refillEvent, EVENT_INCREMENT, FALSE);
+}
+
+static DWORD WINAPI streamThread(LPVOID lpParameter)
+{
+    XAudioStream *stream = (XAudioStream *)lpParameter;
+
+    while (true) {
+        KeWaitForSingleObject(&stream->refillEvent, Executive, KernelMode, FALSE, NULL);
+
+        if (stream->stopping || stream->decoded)
+            break;
+
+        while (stream->freeBuffers > 0 && !stream->decoded) {
+            submitBuffer(stream);
+            InterlockedDecrement(&stream->freeBuffers);
+        }
+    }
+
+    return 0;
+}
+
+static void freeStream(XAudioStream *stream)
+{
+    for (unsigned int i = 0; i < 2; i++) {
+        STREAM_READ *read = &stream->reads[i];
+        if (read->issued && read->pending)
+            NtWaitForSingleObject(read->event, FALSE, NULL);
+        if (read->event)
+            NtClose(read->event);
+        free(read->data);
+    }
+
+    for (unsigned int i = 0; i < STREAM_NUM_BUFFERS; i++) {
+        if (stream->buffers[i])
+            MmFreeContiguousMemory(stream->buffers[i]);
+    }
+
+    if (stream->file)
+        NtClose(stream->file);
+
+    free(stream->pcm);
+    free(stream);
+}
+
+XAudioStream *XAudioStreamOpen(const char *path, int loop)
+{
+    NTSTATUS status;
+    ANSI_STRING pathString;
+    OBJECT_ATTRIBUTES attributes;
+    IO_STATUS_BLOCK ioStatusBlock;
+    XAudioStream *stream;
+
+    stream = calloc(1, sizeof(XAudioStream));
+    if (stream == NULL)
+        return NULL;
+    stream->loop = loop;
+
+    RtlInitAnsiString(&pathString, path);
+    InitializeObjectAttributes(&attributes, &pathString, OBJ_CASE_INSENSITIVE, ObDosDevicesDirectory(), NULL);
+
+    // The file is deliberately opened without FILE_SYNCHRONOUS_IO_NONALERT,
+    // so reads can be overlapped with decoding
+    status = NtCreateFile(&stream->file, GENERIC_READ | SYNCHRONIZE, &attributes, &ioStatusBlock, NULL,
+                          FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OPEN,
+                          FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY);
+    if (!NT_SUCCESS(status)) {
+        stream->file = NULL;
+        freeStream(stream);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < 2; i++) {
+        status = NtCreateEvent(&stream->reads[i].event, NULL, NotificationEvent, FALSE);
+        if (!NT_SUCCESS(status)) {
+            stream->reads[i].event = NULL;
+            freeStream(stream);
+            return NULL;
+        }
+    }
+
+    if (!parseWaveHeader(stream)) {
+        freeStream(stream);
+        return NULL;
+    }
+
+    // Keep every read a multiple of the block size
+    stream->readChunkSize = XAUDIO_STREAM_READ_SIZE - (XAUDIO_STREAM_READ_SIZE % stream->blockAlign);
+    if (stream->readChunkSize == 0)
+        stream->readChunkSize = stream->blockAlign;
+
+    for (unsigned int i = 0; i < 2; i++) {
+        stream->reads[i].data = malloc(stream->readChunkSize);
+        if (stream->reads[i].data == NULL) {
+            freeStream(stream);
+            return NULL;
+        }
+    }
+
+    if (stream->format != WAVE_FORMAT_PCM) {
+        stream->pcm = malloc(stream->samplesPerBlock * 2 * sizeof(short));
+        if (stream->pcm == NULL) {
+            freeStream(stream);
+            return NULL;
+        }
+    }
+
+    for (unsigned int i = 0; i < STREAM_NUM_BUFFERS; i++) {
+        stream->buffers[i] = MmAllocateContiguousMemoryEx(XAUDIO_STREAM_BUFFER_SIZE, 0, MAXRAM, 0,
+                                                          (PAGE_READWRITE | PAGE_WRITECOMBINE));
+        if (stream->buffers[i] == NULL) {
+            freeStream(stream);
+            return NULL;
+        }
+    }
+
+    KeInitializeEvent(&stream->refillEvent, SynchronizationEvent, FALSE);
+
+    // Start reading ahead right away
+    issueRead(stream, 0);
+    issueRead(stream, 1);
+
+    return stream;
+}
+
+// Stops the output and detaches the stream from XAudio
+static void stopOutput(XAudioStream *stream)
+{
+    XAudioPause();
+
+    // Make sure a pending DPC doesn't call back into the freed stream
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    ac97Device.callback = NULL;
+    ac97Device.callbackData = NULL;
+    KfLowerIrql(oldIrql);
+}
+
+// Initializes XAudio, queues the first buffers and starts playback
+int XAudioStreamPlay(XAudioStream *stream)
+{
+    XAudioInit(16, 2, &streamCallback, stream);
+
+    for (unsigned int i = 0; i < STREAM_NUM_BUFFERS && !stream->decoded; i++)
+        submitBuffer(stream);
+
+    stream->thread = CreateThread(NULL, 0, streamThread, stream, 0, NULL);
+    if (stream->thread == NULL) {
+        stopOutput(stream);
+        return 0;
+    }
+
+    // Refilling is time-critical, decoding is cheap
+    SetThreadPriority(stream->thread, THREAD_PRIORITY_HIGHEST);
+
+    XAudioPlay();
+    return 1;
+}
+
+// Returns nonzero once the last buffer has been played, not just queued
+int XAudioStreamIsFinished(XAudioStream *stream)
+{
+    return stream->finished;
+}
+
+void XAudioStreamClose(XAudioStream *stream)
+{
+    if (stream->thread) {
+        stream->stopping = true;
+        KeSetEvent(&stream->refillEvent, EVENT_INCREMENT, FALSE);
+        NtWaitForSingleObject(stream->thread, FALSE, NULL);
+        NtClose(stream->thread);
+    }
+
+    stopOutput(stream);
+
+    freeStream(stream);
+}
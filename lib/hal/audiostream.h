@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef HAL_AUDIOSTREAM_H
+#define HAL_AUDIOSTREAM_H
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Size of each of the two contiguous output buffers handed to the AC97 DMA
+// engine. At 48kHz, 16 bit stereo this is roughly 256ms of audio.
+#define XAUDIO_STREAM_BUFFER_SIZE (48 * 1024)
+
+// Size of each of the two read-ahead buffers used for file I/O
+#define XAUDIO_STREAM_READ_SIZE (32 * 1024)
+
+typedef struct XAudioStream XAudioStream;
+
+// Streams a WAV file from disk through the XAudio backend. Supported are
+// 48kHz mono or stereo files that are either 16 bit PCM or IMA ADPCM
+// (including the Xbox ADPCM variant). The file is read with overlapped I/O
+// while the previously read chunk is being decoded, so only a small, fixed
+// amount of memory is used regardless of the length of the file.
+//
+// As the stream drives the (single) AC97 device, only one stream can be
+// played at a time and XAudioInit() must not be used while it is playing.
+XAudioStream *XAudioStreamOpen(const char *path, int loop);
+int XAudioStreamPlay(XAudioStream *stream);
+// Nonzero once the last buffer of a stream that isn't looped has been played
+int XAudioStreamIsFinished(XAudioStream *stream);
+void XAudioStreamClose(XAudioStream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
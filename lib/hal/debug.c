@@ -21,12 +21,15 @@
 #include "string.h"
 #include <hal/xbox.h>
 #include <hal/video.h>
+#include <windows.h>
 
 #include "debug.h"
 
 #define MARGIN         25
 #define MARGINS        50 // MARGIN*2
 
+#define LINE_HEIGHT    (FONT_HEIGHT+1)
+
 unsigned char *SCREEN_FB = NULL;
 int SCREEN_WIDTH	= 0;
 int SCREEN_HEIGHT	= 0;
@@ -40,67 +43,220 @@ static const unsigned char systemFont[] =
 #include "font_unscii_16.h"
 };
 
+// Each glyph row is a single byte of font data, so all possible rows are
+// expanded to pixel spans once. Drawing a glyph row then only takes four or
+// eight 32 bit stores instead of a per-pixel loop.
+#if FONT_WIDTH != 8
+#error Font has to be exactly 8 pixels wide
+#endif
+typedef union
+{
+	unsigned int p32[8];
+	unsigned short p16[16];
+} GLYPH_SPAN;
+
+static GLYPH_SPAN glyphSpans[256];
+static int glyphSpansBpp = 0;
+
+static int scrollMode = DEBUG_SCROLL_CLEAR;
+
+// In asynchronous mode, debugPrint() only formats the message into a record of
+// a lock-free ring. Any number of threads (and DPCs) may reserve records, the
+// flush thread is the only consumer. Cursor and screen changes are queued as
+// records too, so the flush thread is the only one touching the console state
+// and the changes stay in order with the messages around them.
+#define ASYNC_RECORDS     128 // Must be a power of two
+#define ASYNC_RECORD_SIZE 256
+#define ASYNC_LOG_BUFFER_SIZE 4096
+
+#define ASYNC_PRINT        0
+#define ASYNC_CLEAR        1
+#define ASYNC_ADVANCE      2
+#define ASYNC_MOVE_CURSOR  3
+#define ASYNC_RESET_CURSOR 4
+#define ASYNC_SCROLL_MODE  5
+
+typedef struct
+{
+	volatile LONG ready;
+	int command;
+	int x, y;
+	char text[ASYNC_RECORD_SIZE - sizeof(LONG) - 3 * sizeof(int)];
+} ASYNC_RECORD;
+
+static ASYNC_RECORD *asyncRecords = NULL;
+static volatile BOOL asyncEnabled = FALSE;
+static volatile LONG asyncHead = 0; // Next record to be reserved
+static volatile LONG asyncTail = 0; // Next record to be flushed
+static volatile LONG asyncDropped = 0;
+static LONG asyncDroppedReported = 0;
+static volatile BOOL asyncStopping = FALSE;
+static KEVENT asyncEvent;
+static HANDLE asyncThread = NULL;
+static HANDLE asyncFile = NULL;
+static char *asyncLogBuffer = NULL;
+static ULONG asyncLogLength = 0;
+
+// In DEBUG_SCROLL_RING mode the console draws into a framebuffer of twice the
+// screen height, and every row is written to both halves. Any SCREEN_HEIGHT
+// rows starting at ringTop then form a complete screen, so scrolling is done
+// by moving the scanout start instead of moving pixels.
+static unsigned char *ringMemory = NULL;
+static unsigned char *ringPreviousFB = NULL;
+static int ringTop = 0;
+static VIDEO_MODE ringMode = { 0, 0, 0, 0 };
+
+static void buildGlyphSpans(void)
+{
+	unsigned int fgColour;
+	unsigned int bgColour;
+
+	switch (SCREEN_BPP) {
+	case 32:
+		fgColour = WHITE;
+		bgColour = BLACK;
+		break;
+	case 16:
+		fgColour = WHITE_16BPP;
+		bgColour = BLACK_16BPP;
+		break;
+	case 15:
+		fgColour = WHITE_15BPP;
+		bgColour = BLACK_15BPP;
+		break;
+	default:
+		return;
+	}
+
+	for (int i = 0; i < 256; i++)
+	{
+		for (int w = 0; w < 8; w++)
+		{
+#if FONT_VMIRROR
+			int set = (i >> w) & 1;
+#else
+			int set = (i >> (7 - w)) & 1;
+#endif
+			if (SCREEN_BPP == 32)
+				glyphSpans[i].p32[w] = set ? fgColour : bgColour;
+			else
+				glyphSpans[i].p16[w] = set ? fgColour : bgColour;
+		}
+	}
+
+	glyphSpansBpp = SCREEN_BPP;
+}
+
+static void freeRing(void)
+{
+	if (ringMemory == NULL)
+		return;
+
+	if (XVideoGetFB() >= ringMemory && XVideoGetFB() < ringMemory + ringMode.width * ringMode.height * 2 * ((ringMode.bpp+7)/8))
+		XVideoSetFB(ringPreviousFB);
+
+	MmFreeContiguousMemory(ringMemory);
+	ringMemory = NULL;
+}
+
+static void allocateRing(VIDEO_MODE vm)
+{
+	int ringSize = vm.width * vm.height * 2 * ((vm.bpp+7)/8);
+
+	ringMemory = MmAllocateContiguousMemoryEx(ringSize, 0x00000000, 0x7FFFFFFF, 0x1000,
+	                                          PAGE_READWRITE | PAGE_WRITECOMBINE);
+	if (ringMemory == NULL) {
+		// Not enough memory, fall back to the default behaviour
+		scrollMode = DEBUG_SCROLL_CLEAR;
+		return;
+	}
+
+	memset(ringMemory, 0x00, ringSize);
+	ringPreviousFB = XVideoGetFB();
+	ringMode = vm;
+	ringTop = 0;
+	nextRow = MARGIN;
+	nextCol = MARGIN;
+	XVideoSetFB(ringMemory);
+}
+
 static void synchronizeFramebuffer(void)
 {
 	VIDEO_MODE vm = XVideoGetMode();
 	SCREEN_WIDTH = vm.width;
 	SCREEN_HEIGHT = vm.height;
 	SCREEN_BPP = vm.bpp;
-	SCREEN_FB = XVideoGetFB();
+
+	if (scrollMode == DEBUG_SCROLL_RING) {
+		// The ring has to follow video mode changes
+		if (ringMemory != NULL && (vm.width != ringMode.width || vm.height != ringMode.height || vm.bpp != ringMode.bpp)) {
+			MmFreeContiguousMemory(ringMemory);
+			ringMemory = NULL;
+		}
+		if (ringMemory == NULL)
+			allocateRing(vm);
+	}
+
+	SCREEN_FB = ringMemory ? ringMemory : XVideoGetFB();
+
+	if (glyphSpansBpp != SCREEN_BPP)
+		buildGlyphSpans();
+}
+
+// Returns the address of a row of the visible screen
+static inline unsigned char *rowAddress(int y)
+{
+	int pitch = SCREEN_WIDTH * ((SCREEN_BPP+7)/8);
+	if (ringMemory)
+		y += ringTop;
+	return SCREEN_FB + y * pitch;
 }
 
-static void drawChar(unsigned char c, int x, int y, int fgColour, int bgColour)
+// Returns the address of the second copy of a row in the ring
+static inline unsigned char *mirrorRowAddress(int y)
 {
-	unsigned char *videoBuffer = SCREEN_FB;
-	videoBuffer += (y * SCREEN_WIDTH + x) * ((SCREEN_BPP+7)/8);
+	int pitch = SCREEN_WIDTH * ((SCREEN_BPP+7)/8);
+	y += ringTop;
+	y = (y < SCREEN_HEIGHT) ? (y + SCREEN_HEIGHT) : (y - SCREEN_HEIGHT);
+	return SCREEN_FB + y * pitch;
+}
+
+static void clearRows(int y, int rows)
+{
+	int pitch = SCREEN_WIDTH * ((SCREEN_BPP+7)/8);
+
+	for (int h = y; h < y + rows; h++)
+	{
+		memset(rowAddress(h), 0x00, pitch);
+		if (ringMemory)
+			memset(mirrorRowAddress(h), 0x00, pitch);
+	}
+}
 
-	unsigned char mask;
+// debugPrint() may be called from DPCs, which must not touch the FPU, MMX or
+// SSE state of the thread they interrupted. The stores are volatile so they
+// can't be merged into SSE stores.
+static inline void storeSpan(unsigned char *dst, const GLYPH_SPAN *span)
+{
+	volatile unsigned int *d = (volatile unsigned int *)dst;
+	int words = (SCREEN_BPP == 32) ? 8 : 4;
+
+	for (int i = 0; i < words; i++)
+		d[i] = span->p32[i];
+}
+
+static void drawChar(unsigned char c, int x, int y)
+{
+	int offset = x * ((SCREEN_BPP+7)/8);
 	const unsigned char *font = systemFont + (c * ((FONT_WIDTH+7)/8) * FONT_HEIGHT);
-	int colourToDraw;
 
 	for (int h = 0; h < FONT_HEIGHT; h++)
 	{
-#if FONT_VMIRROR
-		mask = 0x01;
-#else
-		mask = 0x80;
-#endif
+		const GLYPH_SPAN *span = &glyphSpans[font[h]];
 
-		// This loop draws up to 1 byte (8 bit) per line; so 8 pixels at most
-#if FONT_WIDTH > 8
-#error Font can't be wider than 8 pixels
-#endif
-		for (int w = 0; w < FONT_WIDTH; w++)
-		{
-			if ((*font) & mask)
-			{
-				colourToDraw = fgColour;
-			}
-			else
-			{
-				colourToDraw = bgColour;
-			}
-			switch (SCREEN_BPP)
-			{
-				case 32:
-					*((int*)videoBuffer) = colourToDraw;
-					videoBuffer += sizeof(int);
-					break;
-				case 16:
-				case 15:
-					*((short*)videoBuffer) = colourToDraw & 0xFFFF;
-					videoBuffer += sizeof(short);
-					break;
-			}
-#if FONT_VMIRROR
-			mask <<= 1;
-#else
-			mask >>= 1;
-#endif
-		}
-		
-		videoBuffer += (SCREEN_WIDTH-FONT_WIDTH)  * ((SCREEN_BPP+7)/8);
-		font++;
+		storeSpan(rowAddress(y + h) + offset, span);
+		if (ringMemory)
+			storeSpan(mirrorRowAddress(y + h) + offset, span);
 	}
 }
 
@@ -160,39 +316,24 @@ void debugPrintBinary( int num )
    debugPrint("%s", binNum);
 }
 
-void debugPrint(const char *format, ...)
-{
-	char buffer[512];
-	unsigned short len;
-	va_list argList;
-	va_start(argList, format);
-	vsnprintf(buffer, sizeof(buffer), format, argList);
-	va_end(argList);
+static void clearScreen(void);
+static void advanceScreen(void);
+static void setScrollMode(int mode);
+static void resetCursor(void);
+static void moveCursor(int x, int y);
 
+static void printString(const char *buffer)
+{
 	synchronizeFramebuffer();
 
-	int fgColour;
-	int bgColour;
-	switch (SCREEN_BPP) {
-	case 32:
-		fgColour = WHITE;
-		bgColour = BLACK;
-		break;
-	case 16:
-		fgColour = WHITE_16BPP;
-		bgColour = BLACK_16BPP;
-		break;
-	case 15:
-		fgColour = WHITE_15BPP;
-		bgColour = BLACK_15BPP;
-	}
-
 	unsigned char *s = (unsigned char*)	buffer;
 	while (*s)
 	{
 		if( nextRow >= (SCREEN_HEIGHT-MARGINS) ) {
-			debugClearScreen();
-			// debugAdvanceScreen();
+			if (scrollMode == DEBUG_SCROLL_CLEAR)
+				clearScreen();
+			else
+				advanceScreen();
 		}
 		
 		if (*s == '\n')
@@ -206,7 +347,7 @@ void debugPrint(const char *format, ...)
 		}
 		else
 		{
-			drawChar( *s, nextCol, nextRow, fgColour, bgColour );
+			drawChar( *s, nextCol, nextRow );
 
 			nextCol += FONT_WIDTH+1;
 			if( nextCol > (SCREEN_WIDTH-MARGINS))
@@ -222,43 +363,344 @@ void debugPrint(const char *format, ...)
 	XVideoFlushFB();
 }
 
-void debugAdvanceScreen( void )
+static void writeLog(const char *text, ULONG length)
+{
+	IO_STATUS_BLOCK ioStatusBlock;
+
+	if (asyncLogLength + length > ASYNC_LOG_BUFFER_SIZE || text == NULL) {
+		if (asyncLogLength > 0)
+			NtWriteFile(asyncFile, NULL, NULL, NULL, &ioStatusBlock, asyncLogBuffer, asyncLogLength, NULL);
+		asyncLogLength = 0;
+	}
+
+	if (text == NULL)
+		return;
+
+	if (length > ASYNC_LOG_BUFFER_SIZE) {
+		NtWriteFile(asyncFile, NULL, NULL, NULL, &ioStatusBlock, (PVOID)text, length, NULL);
+		return;
+	}
+
+	memcpy(asyncLogBuffer + asyncLogLength, text, length);
+	asyncLogLength += length;
+}
+
+// Renders (and logs) all completed records. Only called by the flush thread.
+static void flushRecords(void)
+{
+	char report[64];
+
+	while (asyncTail != asyncHead)
+	{
+		ASYNC_RECORD *record = &asyncRecords[(ULONG)asyncTail % ASYNC_RECORDS];
+
+		// The producer might still be formatting this record
+		if (!record->ready)
+			break;
+
+		switch (record->command)
+		{
+			case ASYNC_PRINT:
+				printString(record->text);
+				if (asyncFile)
+					writeLog(record->text, strlen(record->text));
+				break;
+			case ASYNC_CLEAR:
+				clearScreen();
+				break;
+			case ASYNC_ADVANCE:
+				advanceScreen();
+				break;
+			case ASYNC_MOVE_CURSOR:
+				moveCursor(record->x, record->y);
+				break;
+			case ASYNC_RESET_CURSOR:
+				resetCursor();
+				break;
+			case ASYNC_SCROLL_MODE:
+				setScrollMode(record->x);
+				break;
+		}
+
+		InterlockedExchange(&record->ready, 0);
+		InterlockedIncrement(&asyncTail);
+	}
+
+	LONG dropped = asyncDropped;
+	if (dropped != asyncDroppedReported)
+	{
+		snprintf(report, sizeof(report), "[debug: %ld messages dropped]\n", dropped - asyncDroppedReported);
+		printString(report);
+		if (asyncFile)
+			writeLog(report, strlen(report));
+		asyncDroppedReported = dropped;
+	}
+
+	if (asyncFile)
+		writeLog(NULL, 0);
+}
+
+static DWORD WINAPI asyncFlushThread(LPVOID lpParameter)
+{
+	while (TRUE)
+	{
+		KeWaitForSingleObject(&asyncEvent, Executive, KernelMode, FALSE, NULL);
+		flushRecords();
+		if (asyncStopping)
+			break;
+	}
+	return 0;
+}
+
+static ASYNC_RECORD *reserveRecord(void)
+{
+	LONG head;
+
+	do
+	{
+		head = asyncHead;
+		if ((ULONG)(head - asyncTail) >= ASYNC_RECORDS)
+		{
+			InterlockedIncrement(&asyncDropped);
+			return NULL;
+		}
+	} while (InterlockedCompareExchange(&asyncHead, head + 1, head) != head);
+
+	return &asyncRecords[(ULONG)head % ASYNC_RECORDS];
+}
+
+// Producers check for asynchronous mode and fill their record at
+// DISPATCH_LEVEL. On the single CPU, debugStopAsync() (which runs at passive
+// level) therefore never finds a producer in the middle of a record, not even
+// one in a DPC, so no record is left unfinished or written after the queue
+// was freed.
+
+// Hands a cursor or screen change to the flush thread. Returns FALSE if the
+// console isn't in asynchronous mode and the caller has to do it itself.
+static BOOL queueCommand(int command, int x, int y)
+{
+	KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+
+	if (!asyncEnabled)
+	{
+		KfLowerIrql(oldIrql);
+		return FALSE;
+	}
+
+	ASYNC_RECORD *record = reserveRecord();
+	if (record != NULL)
+	{
+		record->command = command;
+		record->x = x;
+		record->y = y;
+		InterlockedExchange(&record->ready, 1);
+		KeSetEvent(&asyncEvent, IO_NO_INCREMENT, FALSE);
+	}
+
+	KfLowerIrql(oldIrql);
+	return TRUE;
+}
+
+void debugPrint(const char *format, ...)
+{
+	va_list argList;
+
+	KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+	if (asyncEnabled)
+	{
+		ASYNC_RECORD *record = reserveRecord();
+		if (record != NULL)
+		{
+			record->command = ASYNC_PRINT;
+			va_start(argList, format);
+			vsnprintf(record->text, sizeof(record->text), format, argList);
+			va_end(argList);
+
+			InterlockedExchange(&record->ready, 1);
+			KeSetEvent(&asyncEvent, IO_NO_INCREMENT, FALSE);
+		}
+
+		KfLowerIrql(oldIrql);
+		return;
+	}
+	KfLowerIrql(oldIrql);
+
+	char buffer[512];
+	va_start(argList, format);
+	vsnprintf(buffer, sizeof(buffer), format, argList);
+	va_end(argList);
+
+	printString(buffer);
+}
+
+int debugStartAsync(const char *logPath)
+{
+	NTSTATUS status;
+	ANSI_STRING path;
+	OBJECT_ATTRIBUTES attributes;
+	IO_STATUS_BLOCK ioStatusBlock;
+
+	if (asyncEnabled)
+		return 1;
+
+	if (logPath != NULL)
+	{
+		RtlInitAnsiString(&path, logPath);
+		InitializeObjectAttributes(&attributes, &path, OBJ_CASE_INSENSITIVE, ObDosDevicesDirectory(), NULL);
+		status = NtCreateFile(&asyncFile, GENERIC_WRITE | SYNCHRONIZE, &attributes, &ioStatusBlock, NULL,
+		                      FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OVERWRITE_IF,
+		                      FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT | FILE_SEQUENTIAL_ONLY);
+		if (!NT_SUCCESS(status))
+		{
+			asyncFile = NULL;
+			return 0;
+		}
+
+		asyncLogBuffer = malloc(ASYNC_LOG_BUFFER_SIZE);
+		asyncLogLength = 0;
+	}
+
+	asyncRecords = calloc(ASYNC_RECORDS, sizeof(ASYNC_RECORD));
+	if (asyncRecords == NULL || (logPath != NULL && asyncLogBuffer == NULL))
+	{
+		debugStopAsync();
+		return 0;
+	}
+
+	asyncHead = 0;
+	asyncTail = 0;
+	asyncDropped = 0;
+	asyncDroppedReported = 0;
+	asyncStopping = FALSE;
+	KeInitializeEvent(&asyncEvent, SynchronizationEvent, FALSE);
+
+	asyncThread = CreateThread(NULL, 0, asyncFlushThread, NULL, 0, NULL);
+	if (asyncThread == NULL)
+	{
+		debugStopAsync();
+		return 0;
+	}
+	SetThreadPriority(asyncThread, THREAD_PRIORITY_LOWEST);
+
+	asyncEnabled = TRUE;
+	return 1;
+}
+
+void debugStopAsync(void)
+{
+	// Producers that saw asynchronous mode have finished their records by the
+	// time this returns, see queueCommand()
+	KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+	asyncEnabled = FALSE;
+	KfLowerIrql(oldIrql);
+
+	if (asyncThread != NULL)
+	{
+		// Let the flush thread render everything which is still queued
+		asyncStopping = TRUE;
+		KeSetEvent(&asyncEvent, IO_NO_INCREMENT, FALSE);
+		NtWaitForSingleObject(asyncThread, FALSE, NULL);
+		NtClose(asyncThread);
+		asyncThread = NULL;
+	}
+
+	free(asyncRecords);
+	asyncRecords = NULL;
+
+	if (asyncFile != NULL)
+	{
+		NtClose(asyncFile);
+		asyncFile = NULL;
+	}
+	free(asyncLogBuffer);
+	asyncLogBuffer = NULL;
+}
+
+unsigned int debugGetDroppedCount(void)
+{
+	return asyncDropped;
+}
+
+static void advanceScreen(void)
 {
 	synchronizeFramebuffer();
 
+	if (ringMemory)
+	{
+		// Move the visible window down by one line. The rows which scrolled
+		// into the top margin and the new last line still hold old text.
+		ringTop = (ringTop + LINE_HEIGHT) % SCREEN_HEIGHT;
+		XVideoSetFB(rowAddress(0));
+
+		nextRow -= LINE_HEIGHT;
+		nextCol  = MARGIN;
+
+		int topRows = (MARGIN < LINE_HEIGHT) ? MARGIN : LINE_HEIGHT;
+		clearRows(MARGIN - topRows, topRows);
+		clearRows(nextRow, LINE_HEIGHT);
+
+		XVideoFlushFB();
+		return;
+	}
+
 	int pixelSize = (SCREEN_BPP+7)/8;
 	int screenSize  = SCREEN_WIDTH * (SCREEN_HEIGHT - MARGINS)  * pixelSize;
-	int lineSize    = SCREEN_WIDTH * (FONT_HEIGHT + 1) * pixelSize;
+	int lineSize    = SCREEN_WIDTH * LINE_HEIGHT * pixelSize;
 	
 	unsigned char* thisScreen = SCREEN_FB + (SCREEN_WIDTH * MARGIN)  * pixelSize;
 	unsigned char* prevScreen = thisScreen+lineSize;
 		
 	memmove(thisScreen, prevScreen, screenSize);
 
-	nextRow -= (FONT_HEIGHT+1);
+	nextRow -= LINE_HEIGHT;
 	nextCol  = MARGIN; 
 
+	clearRows(nextRow, LINE_HEIGHT);
+
 	XVideoFlushFB();
 }
 
-void debugClearScreen( void )
+static void clearScreen(void)
 {
 	synchronizeFramebuffer();
 
-	memset( SCREEN_FB, 0, ((SCREEN_BPP+7)/8) * (SCREEN_WIDTH * SCREEN_HEIGHT) );
+	int screenSize = ((SCREEN_BPP+7)/8) * (SCREEN_WIDTH * SCREEN_HEIGHT);
+	if (ringMemory)
+	{
+		memset( ringMemory, 0, screenSize * 2 );
+		ringTop = 0;
+		XVideoSetFB(ringMemory);
+	}
+	else
+	{
+		memset( SCREEN_FB, 0, screenSize );
+	}
 	nextRow = MARGIN;
 	nextCol = MARGIN; 
 
 	XVideoFlushFB();
 }
 
-void debugResetCursor ( void )
+static void setScrollMode(int mode)
+{
+	if (mode == scrollMode)
+		return;
+
+	if (scrollMode == DEBUG_SCROLL_RING)
+		freeRing();
+
+	scrollMode = mode;
+	if (mode == DEBUG_SCROLL_RING)
+		clearScreen();
+}
+
+static void resetCursor(void)
 {
 	nextRow = MARGIN;
 	nextCol = MARGIN;
 }
 
-void debugMoveCursor (int x, int y)
+static void moveCursor(int x, int y)
 {
 	if ( x < MARGIN || x > SCREEN_WIDTH-MARGIN-FONT_WIDTH ) {
 		return;
@@ -271,6 +713,36 @@ void debugMoveCursor (int x, int y)
 	nextCol = x;
 }
 
+void debugAdvanceScreen( void )
+{
+	if (!queueCommand(ASYNC_ADVANCE, 0, 0))
+		advanceScreen();
+}
+
+void debugClearScreen( void )
+{
+	if (!queueCommand(ASYNC_CLEAR, 0, 0))
+		clearScreen();
+}
+
+void debugSetScrollMode( int mode )
+{
+	if (!queueCommand(ASYNC_SCROLL_MODE, mode, 0))
+		setScrollMode(mode);
+}
+
+void debugResetCursor ( void )
+{
+	if (!queueCommand(ASYNC_RESET_CURSOR, 0, 0))
+		resetCursor();
+}
+
+void debugMoveCursor (int x, int y)
+{
+	if (!queueCommand(ASYNC_MOVE_CURSOR, x, y))
+		moveCursor(x, y);
+}
+
 void debugPrintHex(const char *buffer, int length)
 {
 	char tmp[10];
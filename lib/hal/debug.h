@@ -32,9 +32,21 @@ extern "C"
 #define WHITE_15BPP   0x7FFF
 #define BLACK_15BPP  0x0000
 
+// What happens when the console reaches the bottom of the screen
+#define DEBUG_SCROLL_CLEAR 0 // Clear the screen and start at the top (default)
+#define DEBUG_SCROLL_MOVE  1 // Move the text up by one line
+#define DEBUG_SCROLL_RING  2 // Like DEBUG_SCROLL_MOVE, but by changing the
+                             // scanout start of a private framebuffer of
+                             // twice the screen height. Fast, but uses extra
+                             // memory and replaces the framebuffer set with
+                             // XVideoSetFB() until another mode is selected.
+
 /**
  * Prints a message to whatever debug facilities might
  * be available.
+ * Glyphs are drawn with integer stores only, so this may be called from a
+ * DPC without saving the FPU state, unless the format converts floating
+ * point values.
  */
 void debugPrint(const char *format, ...) __attribute__((format(printf, 1, 2)));
 void debugPrintNum(int i);
@@ -44,6 +56,26 @@ void debugClearScreen( void );
 void debugAdvanceScreen( void );
 void debugMoveCursor(int x, int y);
 void debugResetCursor( void );
+void debugSetScrollMode( int mode );
+
+/**
+ * Switches debugPrint() to asynchronous mode: messages are only formatted
+ * into a lock-free queue by the caller and rendered (and optionally written
+ * to the file at logPath, e.g. "E:\\log.txt") by a low priority thread.
+ * Messages are dropped if the queue is full, the flush thread reports how
+ * many. Cursor and screen functions like debugClearScreen() are queued as
+ * well, and take effect in order with the messages around them.
+ * Returns non-zero on success.
+ */
+int debugStartAsync(const char *logPath);
+/**
+ * Renders all queued messages and returns to synchronous mode. Messages
+ * queued before, also from DPCs, are never lost. Calls that come in while
+ * this runs already draw directly and may overlap with the last queued
+ * messages, so other threads shouldn't print at that time.
+ */
+void debugStopAsync(void);
+unsigned int debugGetDroppedCount(void);
 
 #ifdef __cplusplus
 }
@@ -63,6 +63,28 @@ static KDPC DPCObject;
 static HANDLE VBlankEvent;
 static BOOL IsrRegistered = FALSE;
 
+// Vblank service state, updated by the ISR
+static volatile ULONG VBlankCount = 0;
+static volatile ULONGLONG VBlankTimestamps[XVIDEO_VBLANK_HISTORY];
+
+typedef struct _VBLANK_CALLBACK
+{
+	XVideoVBlankCallback callback;
+	void *context;
+} VBLANK_CALLBACK;
+
+// Only changed at DISPATCH_LEVEL, so the DPC sees consistent entries
+static VBLANK_CALLBACK VBlankCallbacks[XVIDEO_MAX_VBLANK_CALLBACKS];
+
+// Flip chain state. The ISR moves FlipPending to FlipDisplayed, everything
+// else is only changed through KeSynchronizeExecution().
+static unsigned char*	FlipBuffers[XVIDEO_MAX_FLIP_BUFFERS];
+static int			FlipCount = 0;
+static volatile int	FlipDisplayed = -1;
+static volatile int	FlipPending = -1;
+static int			FlipDrawing = -1;
+static unsigned char*	FlipPreviousFB = NULL;
+
 #define VBL_IRQ 3
 
 typedef struct _VIDEO_MODE_SETTING
@@ -142,6 +164,15 @@ PVOID DeferredContext,
 PVOID SystemArgument1,
 PVOID SystemArgument2)
 {
+	/* Several vblanks might have been coalesced into this DPC */
+	ULONG count = VBlankCount;
+
+	for (int i = 0; i < XVIDEO_MAX_VBLANK_CALLBACKS; i++)
+	{
+		if (VBlankCallbacks[i].callback)
+			VBlankCallbacks[i].callback(count, VBlankCallbacks[i].context);
+	}
+
 	/* Wake up waiting threads */
 	NtPulseEvent(VBlankEvent, NULL);
 	return;
@@ -151,8 +182,23 @@ static BOOLEAN __stdcall ISR(PKINTERRUPT Interrupt, PVOID ServiceContext)
 {
 	if (VIDEOREG(NV_PMC_INTR_EN_0))
 	{
+		ULONGLONG timestamp;
+		asm __volatile__("rdtsc" : "=A"(timestamp));
+
 		/* Reset interrupt */
 		VIDEOREG(PCRTC_INTR)=PCRTC_INTR_VBLANK_RESET;
+
+		ULONG count = VBlankCount + 1;
+		VBlankTimestamps[count % XVIDEO_VBLANK_HISTORY] = timestamp;
+		VBlankCount = count;
+
+		/* Show the frame which was presented last */
+		if (FlipPending >= 0)
+		{
+			VIDEOREG(PCRTC_START) = (unsigned int)FlipBuffers[FlipPending] & 0x7FFFFFFF;
+			FlipDisplayed = FlipPending;
+			FlipPending = -1;
+		}
 		/* Call our Dpc */
 		KeInsertQueueDpc(&DPCObject,NULL,NULL);
 		return TRUE;
@@ -357,6 +403,8 @@ void XVideoInit(DWORD dwMode, int width, int height, int bpp)
 		AvSetSavedDataAddress(NULL);
 	}
 
+	XVideoFlipChainShutdown();
+
 	if (framebufferMemory != NULL) {
 		MmFreeContiguousMemory(framebufferMemory);
 	}
@@ -366,8 +414,7 @@ void XVideoInit(DWORD dwMode, int width, int height, int bpp)
 	                                                 PAGE_READWRITE |
 	                                                 PAGE_WRITECOMBINE);
 	assert(framebufferMemory != NULL);
-	memset(framebufferMemory, 0x00, screenSize);
-	asm __volatile__("sfence");
+	_memset_wc(framebufferMemory, 0x00, screenSize);
 
 	do
 	{
@@ -468,25 +515,241 @@ void XVideoSetGammaRamp(unsigned int offset, const GAMMA_RAMP_ENTRY *entries, un
 }
 
 
-void XVideoWaitForVBlank()
+// The vblank interrupt stays enabled once it was needed, so waiting for
+// vblanks doesn't reprogram the interrupt every frame.
+static BOOL StartVBlankService(void)
 {
 	if (! IsrRegistered) {
 		if (InstallVBLInterrupt())
 			IsrRegistered = TRUE;
 		else
-			return; //Prevents deadlock in case user code hooks IRQ3 first
+			return FALSE; //Prevents deadlock in case user code hooks IRQ3 first
+
+		VIDEOREG(PCRTC_INTR)=PCRTC_INTR_VBLANK_RESET;
 	}
 
-	/* Enable vblank interrupt */
-	VIDEOREG(PCRTC_INTR)=PCRTC_INTR_VBLANK_RESET;
+	/* Mode changes might have disabled it */
 	VIDEOREG(PCRTC_INTR_EN)=PCRTC_INTR_EN_VBLANK_ENABLED;
-	
+	return TRUE;
+}
+
+void XVideoWaitForVBlank()
+{
+	if (!StartVBlankService())
+		return;
+
 	/* Wait for vblank */
 	NtWaitForSingleObject(VBlankEvent, FALSE, NULL);
-	
-	/* Disable vblank interrupt */
-	VIDEOREG(PCRTC_INTR_EN)=PCRTC_INTR_EN_VBLANK_DISABLED;
-	VIDEOREG(PCRTC_INTR)=PCRTC_INTR_VBLANK_RESET;
+}
+
+HANDLE XVideoGetVBlankEvent(void)
+{
+	if (!StartVBlankService())
+		return NULL;
+
+	return VBlankEvent;
+}
+
+ULONG XVideoGetVBlankCount(void)
+{
+	StartVBlankService();
+	return VBlankCount;
+}
+
+unsigned int XVideoGetVBlankTimestamps(ULONGLONG *timestamps, unsigned int max)
+{
+	ULONG count;
+	unsigned int n;
+
+	if (max > XVIDEO_VBLANK_HISTORY)
+		max = XVIDEO_VBLANK_HISTORY;
+
+	StartVBlankService();
+
+	/* Retry if a vblank happens while copying */
+	do {
+		count = VBlankCount;
+		n = (count < max) ? count : max;
+		for (unsigned int i = 0; i < n; i++)
+			timestamps[i] = VBlankTimestamps[(count - i) % XVIDEO_VBLANK_HISTORY];
+	} while (count != VBlankCount);
+
+	return n;
+}
+
+BOOL XVideoRegisterVBlankCallback(XVideoVBlankCallback callback, void *context)
+{
+	BOOL registered = FALSE;
+
+	if (!StartVBlankService())
+		return FALSE;
+
+	KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+	for (int i = 0; i < XVIDEO_MAX_VBLANK_CALLBACKS; i++)
+	{
+		if (VBlankCallbacks[i].callback == NULL)
+		{
+			VBlankCallbacks[i].context = context;
+			VBlankCallbacks[i].callback = callback;
+			registered = TRUE;
+			break;
+		}
+	}
+	KfLowerIrql(oldIrql);
+
+	return registered;
+}
+
+void XVideoUnregisterVBlankCallback(XVideoVBlankCallback callback, void *context)
+{
+	KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+	for (int i = 0; i < XVIDEO_MAX_VBLANK_CALLBACKS; i++)
+	{
+		if (VBlankCallbacks[i].callback == callback && VBlankCallbacks[i].context == context)
+		{
+			VBlankCallbacks[i].callback = NULL;
+			VBlankCallbacks[i].context = NULL;
+			break;
+		}
+	}
+	KfLowerIrql(oldIrql);
+}
+
+// Picks a buffer which is neither scanned out nor waiting to be.
+// Called through KeSynchronizeExecution.
+static BOOLEAN NTAPI FlipAcquireSync(PVOID SynchronizeContext)
+{
+	for (int i = 1; i <= FlipCount; i++)
+	{
+		int buffer = (FlipDrawing + i) % FlipCount;
+		if (buffer != FlipDisplayed && buffer != FlipPending)
+		{
+			FlipDrawing = buffer;
+			return TRUE;
+		}
+	}
+	FlipDrawing = -1;
+	return FALSE;
+}
+
+// Queues the buffer which was drawn to for the next vblank. A frame which is
+// still queued gets replaced, so it never becomes visible. Nothing is changed
+// if there is no buffer to continue drawing into.
+// Called through KeSynchronizeExecution.
+static BOOLEAN NTAPI FlipPresentSync(PVOID SynchronizeContext)
+{
+	int drawing = FlipDrawing;
+	int pending = FlipPending;
+
+	FlipPending = drawing;
+	if (FlipAcquireSync(NULL))
+		return TRUE;
+
+	FlipPending = pending;
+	FlipDrawing = drawing;
+	return FALSE;
+}
+
+static BOOLEAN NTAPI FlipShutdownSync(PVOID SynchronizeContext)
+{
+	FlipCount = 0;
+	FlipDisplayed = -1;
+	FlipPending = -1;
+	FlipDrawing = -1;
+	return TRUE;
+}
+
+BOOL XVideoFlipChainInit(int count)
+{
+	int bytesPerPixel = (vmCurrent.bpp+7)/8;
+	int screenSize = vmCurrent.width * bytesPerPixel * vmCurrent.height;
+
+	if (count < 3 || count > XVIDEO_MAX_FLIP_BUFFERS || screenSize == 0)
+		return FALSE;
+
+	XVideoFlipChainShutdown();
+
+	if (!StartVBlankService())
+		return FALSE;
+
+	for (int i = 0; i < count; i++)
+	{
+		FlipBuffers[i] = MmAllocateContiguousMemoryEx(screenSize,
+		                                              0x00000000, 0x7FFFFFFF,
+		                                              0x1000,
+		                                              PAGE_READWRITE |
+		                                              PAGE_WRITECOMBINE);
+		if (FlipBuffers[i] == NULL)
+		{
+			while (i--)
+				MmFreeContiguousMemory(FlipBuffers[i]);
+			return FALSE;
+		}
+		_memset_wc(FlipBuffers[i], 0x00, screenSize);
+	}
+
+	FlipPreviousFB = _fb;
+	XVideoSetFB(FlipBuffers[0]);
+
+	FlipDisplayed = 0;
+	FlipPending = -1;
+	FlipDrawing = 1;
+	FlipCount = count;
+	_fb = FlipBuffers[FlipDrawing];
+
+	return TRUE;
+}
+
+void XVideoFlipChainShutdown(void)
+{
+	int count = FlipCount;
+
+	if (count == 0)
+		return;
+
+	KeSynchronizeExecution(&InterruptObject, FlipShutdownSync, NULL);
+
+	XVideoSetFB(FlipPreviousFB);
+
+	for (int i = 0; i < count; i++)
+	{
+		MmFreeContiguousMemory(FlipBuffers[i]);
+		FlipBuffers[i] = NULL;
+	}
+}
+
+unsigned char* XVideoFlipChainGetBuffer(BOOL wait)
+{
+	if (FlipCount == 0)
+		return NULL;
+
+	while (FlipDrawing < 0)
+	{
+		if (KeSynchronizeExecution(&InterruptObject, FlipAcquireSync, NULL))
+			break;
+		if (!wait)
+			return NULL;
+		NtWaitForSingleObject(VBlankEvent, FALSE, NULL);
+	}
+
+	_fb = FlipBuffers[FlipDrawing];
+	return _fb;
+}
+
+unsigned char* XVideoFlipChainPresent(void)
+{
+	if (FlipCount == 0 || FlipDrawing < 0)
+		return NULL;
+
+	/* Make sure all pixels reached memory before scanout can start */
+	asm __volatile__("sfence");
+
+	/* The frame stays in _fb if it couldn't be queued */
+	if (!KeSynchronizeExecution(&InterruptObject, FlipPresentSync, NULL))
+		return NULL;
+
+	_fb = FlipBuffers[FlipDrawing];
+	return _fb;
 }
 
 unsigned char* XVideoGetVideoBase()
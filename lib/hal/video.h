@@ -92,6 +92,49 @@ If a value of 0 is provided for the bpp a default value of 32bpp is used.
 BOOLEAN XVideoListModes(VIDEO_MODE *vm, int bpp, int refresh, void **p);
 
 void XVideoWaitForVBlank(void);
+
+/*
+Once any of the vblank functions was used, the vblank interrupt stays enabled
+and the following information is kept up to date:
+XVideoGetVBlankCount returns the number of vblanks seen so far.
+XVideoGetVBlankTimestamps copies the rdtsc timestamps of up to `max` recent
+vblanks (at most XVIDEO_VBLANK_HISTORY) to `timestamps`, latest first, and
+returns how many were copied.
+XVideoGetVBlankEvent returns an event which is pulsed on every vblank; it can
+be used with NtWaitForMultipleObjectsEx or WaitForMultipleObjects and must not
+be closed.
+Registered callbacks are called on every vblank from a DPC, with the current
+vblank count. Be careful to save and restore the FPU state if they use floats.
+*/
+#define XVIDEO_VBLANK_HISTORY 16
+#define XVIDEO_MAX_VBLANK_CALLBACKS 4
+typedef void (*XVideoVBlankCallback)(ULONG vblankCount, void *context);
+ULONG XVideoGetVBlankCount(void);
+unsigned int XVideoGetVBlankTimestamps(ULONGLONG *timestamps, unsigned int max);
+HANDLE XVideoGetVBlankEvent(void);
+BOOL XVideoRegisterVBlankCallback(XVideoVBlankCallback callback, void *context);
+void XVideoUnregisterVBlankCallback(XVideoVBlankCallback callback, void *context);
+
+/*
+Flip chains let CPU rendering overlap scanout. XVideoFlipChainInit allocates
+`count` framebuffers (3 to XVIDEO_MAX_FLIP_BUFFERS) for the current video mode.
+One of them is scanned out, one may be queued for the next vblank, and the
+others are handed to the application for drawing. XVideoGetFB() always returns
+the buffer to draw into, so software renderers using it work unchanged.
+XVideoFlipChainPresent queues the current buffer to become visible at the next
+vblank (the vblank interrupt does the flip) and returns the next buffer to draw
+into without waiting. If a previously presented frame is still queued, it is
+dropped in favour of the new one. On failure, NULL is returned, nothing is
+queued and XVideoGetFB() still returns the buffer that was drawn into.
+XVideoFlipChainGetBuffer returns the buffer to draw into, optionally waiting
+for one to become free.
+The flip chain is destroyed by XVideoSetMode.
+*/
+#define XVIDEO_MAX_FLIP_BUFFERS 4
+BOOL XVideoFlipChainInit(int count);
+void XVideoFlipChainShutdown(void);
+unsigned char* XVideoFlipChainGetBuffer(BOOL wait);
+unsigned char* XVideoFlipChainPresent(void);
 unsigned char* XVideoGetVideoBase(void);
 int XVideoVideoMemorySize(void);
 
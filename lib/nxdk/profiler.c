@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include "profiler.h"
+#include <assert.h>
+#include <fileapi.h>
+#include <handleapi.h>
+#include <winnt.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+static KTIMER prof_timer;
+static KDPC prof_dpc;
+static bool prof_running;
+static nx_profiler_sample_t *prof_samples;
+static ULONG prof_capacity;
+static ULONG prof_next;
+static ULONG prof_count;
+static ULONG prof_sampleRate;
+
+static bool prof_in_image (ULONG_PTR address)
+{
+    return address >= CURRENT_XBE_HEADER->ImageBase &&
+           address - CURRENT_XBE_HEADER->ImageBase < CURRENT_XBE_HEADER->SizeOfImage;
+}
+
+// DPCs run on the stack of the thread that was interrupted by the clock
+// interrupt. The interrupt entry stores the interrupted EBP and EIP at the
+// start of the trap frame, so following the frame pointer chain from here
+// leads through the kernel frames into the interrupted code.
+static VOID NTAPI prof_dpc_routine (PKDPC Dpc, PVOID DeferredContext, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+    PKTHREAD thread = KeGetCurrentThread();
+    ULONG_PTR stackLimit = (ULONG_PTR)thread->StackLimit;
+    ULONG_PTR stackBase = (ULONG_PTR)thread->StackBase;
+    ULONG_PTR *frame = __builtin_frame_address(0);
+    nx_profiler_sample_t *sample = &prof_samples[prof_next];
+    ULONG depth = 0;
+
+    while (depth < NX_PROFILER_MAX_DEPTH) {
+        if ((ULONG_PTR)frame < stackLimit || (ULONG_PTR)frame > stackBase - 2 * sizeof(ULONG_PTR) || ((ULONG_PTR)frame & 3)) {
+            break;
+        }
+
+        ULONG_PTR address = frame[1];
+        // Kernel frames are skipped until the first address inside the XBE
+        if (prof_in_image(address)) {
+            sample->frames[depth++] = address;
+        } else if (depth > 0) {
+            break;
+        }
+
+        ULONG_PTR *nextFrame = (ULONG_PTR *)frame[0];
+        if (nextFrame <= frame) {
+            break;
+        }
+        frame = nextFrame;
+    }
+
+    sample->depth = depth;
+    prof_next = (prof_next + 1) % prof_capacity;
+    prof_count++;
+}
+
+bool nxProfilerStart (unsigned int sampleRate, unsigned int bufferSamples)
+{
+    NTSTATUS status;
+    PVOID buffer = NULL;
+    SIZE_T bufferSize;
+    LARGE_INTEGER dueTime;
+    LONG period;
+
+    if (prof_running || sampleRate == 0 || sampleRate > 1000 || bufferSamples == 0) {
+        return false;
+    }
+
+    if (prof_samples != NULL) {
+        SIZE_T freeSize = 0;
+        status = NtFreeVirtualMemory((PVOID *)&prof_samples, &freeSize, MEM_RELEASE);
+        assert(NT_SUCCESS(status));
+        prof_samples = NULL;
+    }
+
+    // Memory is never paged out, so the DPC can write to the buffer directly
+    bufferSize = bufferSamples * sizeof(nx_profiler_sample_t);
+    status = NtAllocateVirtualMemory(&buffer, 0, &bufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!NT_SUCCESS(status)) {
+        return false;
+    }
+
+    prof_samples = buffer;
+    prof_capacity = bufferSamples;
+    prof_next = 0;
+    prof_count = 0;
+    prof_sampleRate = sampleRate;
+
+    // The timer has a resolution of one millisecond
+    period = 1000 / sampleRate;
+    dueTime.QuadPart = -10000LL * period;
+
+    KeInitializeDpc(&prof_dpc, prof_dpc_routine, NULL);
+    KeInitializeTimerEx(&prof_timer, SynchronizationTimer);
+    KeSetTimerEx(&prof_timer, dueTime, period, &prof_dpc);
+    prof_running = true;
+
+    return true;
+}
+
+void nxProfilerStop (void)
+{
+    if (!prof_running) {
+        return;
+    }
+
+    // On the single CPU of the Xbox, a DPC that is already queued runs when
+    // KeCancelTimer lowers the IRQL again, so no sample is taken after this
+    KeCancelTimer(&prof_timer);
+    prof_running = false;
+}
+
+bool nxProfilerSave (const char *path)
+{
+    nx_profiler_file_header_t header;
+    HANDLE file;
+    DWORD written;
+    bool success;
+
+    if (prof_running || prof_samples == NULL) {
+        return false;
+    }
+
+    ULONG sampleCount = prof_count < prof_capacity ? prof_count : prof_capacity;
+    ULONG first = prof_count < prof_capacity ? 0 : prof_next;
+
+    header.magic = NX_PROFILER_MAGIC;
+    header.version = NX_PROFILER_VERSION;
+    header.sampleRate = prof_sampleRate;
+    header.maxDepth = NX_PROFILER_MAX_DEPTH;
+    header.sampleCount = sampleCount;
+    header.droppedCount = prof_count - sampleCount;
+    header.imageBase = CURRENT_XBE_HEADER->ImageBase;
+    header.imageSize = CURRENT_XBE_HEADER->SizeOfImage;
+
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // The ring buffer is written in two parts, oldest samples first
+    success = WriteFile(file, &header, sizeof(header), &written, NULL) && written == sizeof(header);
+    if (success) {
+        DWORD size = (sampleCount - first) * sizeof(nx_profiler_sample_t);
+        success = WriteFile(file, &prof_samples[first], size, &written, NULL) && written == size;
+    }
+    if (success && first != 0) {
+        DWORD size = first * sizeof(nx_profiler_sample_t);
+        success = WriteFile(file, prof_samples, size, &written, NULL) && written == size;
+    }
+
+    CloseHandle(file);
+    return success;
+}
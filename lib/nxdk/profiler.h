@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef __NXDK_PROFILER_H__
+#define __NXDK_PROFILER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stdint.h>
+
+// Maximum number of stack frames recorded per sample
+#define NX_PROFILER_MAX_DEPTH 16
+
+#define NX_PROFILER_MAGIC   0x4650584E // "NXPF"
+#define NX_PROFILER_VERSION 1
+
+// The file written by nxProfilerSave consists of this header, followed by
+// sampleCount samples in the order they were taken.
+typedef struct nx_profiler_file_header_t_
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t maxDepth;
+    uint32_t sampleCount;
+    // Samples which were overwritten because the buffer was full
+    uint32_t droppedCount;
+    uint32_t imageBase;
+    uint32_t imageSize;
+} nx_profiler_file_header_t;
+
+// frames[0] is the innermost address inside the XBE, the following entries
+// are return addresses. A depth of zero means the CPU was executing kernel
+// code that wasn't called from the XBE, for example the idle loop.
+typedef struct nx_profiler_sample_t_
+{
+    uint32_t depth;
+    uint32_t frames[NX_PROFILER_MAX_DEPTH];
+} nx_profiler_sample_t;
+
+/**
+ * Starts the sampling profiler. A kernel timer records the stack of the code
+ * that is running at the given rate into a ring buffer, overwriting the oldest
+ * samples when it is full. Stacks are found by following the frame pointer
+ * chain, so code should be built with -fno-omit-frame-pointer for complete
+ * stacks.
+ * @param sampleRate Samples per second, at most 1000
+ * @param bufferSamples Number of samples the ring buffer holds
+ * @return true on success, false if the profiler is already running or the
+ *         buffer could not be allocated.
+ */
+bool nxProfilerStart (unsigned int sampleRate, unsigned int bufferSamples);
+
+/**
+ * Stops taking samples. The recorded samples are kept until the profiler is
+ * started again.
+ */
+void nxProfilerStop (void);
+
+/**
+ * Writes the recorded samples to a file, which can be turned into folded
+ * stacks for flame graphs with the nxprof tool. The profiler must be stopped.
+ * @param path Path of the file to write
+ * @return true on success, false otherwise.
+ */
+bool nxProfilerSave (const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
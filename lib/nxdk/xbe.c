@@ -5,6 +5,7 @@
 #include "xbe.h"
 #include <string.h>
 #include <winnt.h>
+#include <xboxkrnl/xboxkrnl.h>
 
 PXBE_SECTION_HEADER nxXbeGetSectionByName (const char *name)
 {
@@ -18,3 +19,27 @@ PXBE_SECTION_HEADER nxXbeGetSectionByName (const char *name)
 
     return NULL;
 }
+
+PVOID nxXbeLoadSection (const char *name)
+{
+    PXBE_SECTION_HEADER sectionHeader = nxXbeGetSectionByName(name);
+    if (sectionHeader == NULL) {
+        return NULL;
+    }
+
+    if (!NT_SUCCESS(XeLoadSection(sectionHeader))) {
+        return NULL;
+    }
+
+    return (PVOID)sectionHeader->VirtualAddress;
+}
+
+BOOL nxXbeUnloadSection (const char *name)
+{
+    PXBE_SECTION_HEADER sectionHeader = nxXbeGetSectionByName(name);
+    if (sectionHeader == NULL) {
+        return FALSE;
+    }
+
+    return NT_SUCCESS(XeUnloadSection(sectionHeader));
+}
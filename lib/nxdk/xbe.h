@@ -13,6 +13,24 @@ extern "C" {
 
 PXBE_SECTION_HEADER nxXbeGetSectionByName (const char *name);
 
+/**
+ * Loads a section of the running XBE into memory. Sections which are listed in
+ * XBE_NOPRELOAD are not loaded at boot and must be loaded before use. Sections
+ * are reference counted, each successful call must be matched with a call to
+ * nxXbeUnloadSection.
+ * @param name The name of the section
+ * @return The address of the section, or NULL if it could not be loaded.
+ */
+PVOID nxXbeLoadSection (const char *name);
+
+/**
+ * Releases a reference to a section loaded with nxXbeLoadSection. The memory
+ * of the section is freed when the last reference is released.
+ * @param name The name of the section
+ * @return TRUE on success, FALSE if the section doesn't exist or isn't loaded.
+ */
+BOOL nxXbeUnloadSection (const char *name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,7 @@ extern "C"
 #include "outer.h"
 #include "nv_objects.h"
 #include "nv_regs.h"
+#include "pbkit_blob.h"
 #include "pbkit_dma.h"
 #include "pbkit_draw.h"
 #include "pbkit_framebuffer.h"
@@ -0,0 +1,75 @@
+// pbKit loader for precompiled pushbuffer blobs
+
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include "pbkit_blob.h"
+
+#include <string.h>
+
+#include "pbkit_pushbuffer.h"
+
+#define PACKET_COUNT(header)      (((header) >> 18) & 0x7FF)
+#define PACKET_SUBCHANNEL(header) (((header) >> 13) & 0x7)
+#define PACKET_COMMAND(header)    ((header) & ~((0x7FF << 18) | (0x7 << 13)))
+// Jumps, calls and returns would redirect the pushbuffer
+#define PACKET_INVALID_BITS       0xA0030003
+
+static const uint32_t *pb_blob_data (const void *blob, size_t size)
+{
+    const pb_blob_header_t *header = blob;
+
+    if (size < sizeof(pb_blob_header_t) || header->magic != PB_BLOB_MAGIC || header->version != PB_BLOB_VERSION) {
+        return NULL;
+    }
+    if (header->size > (size - sizeof(pb_blob_header_t)) / sizeof(uint32_t)) {
+        return NULL;
+    }
+
+    return (const uint32_t *)(header + 1);
+}
+
+bool pb_push_blob (const void *blob, size_t size)
+{
+    const uint32_t *data = pb_blob_data(blob, size);
+    if (data == NULL) {
+        return false;
+    }
+
+    const uint32_t dwords = ((const pb_blob_header_t *)blob)->size;
+    uint32_t i;
+
+    // Validate all packets first, so a broken blob doesn't leave a partial
+    // state behind
+    for (i = 0; i < dwords; i += 1 + PACKET_COUNT(data[i])) {
+        uint32_t count = PACKET_COUNT(data[i]);
+        if ((data[i] & PACKET_INVALID_BITS) || count + 1 > PB_BLOB_MAX_BLOCK || count >= dwords - i) {
+            return false;
+        }
+    }
+
+    uint32_t start = 0;
+    while (start < dwords) {
+        // Gather as many whole packets as fit into one block
+        uint32_t end = start;
+        while (end < dwords && end + 1 + PACKET_COUNT(data[end]) - start <= PB_BLOB_MAX_BLOCK) {
+            end += 1 + PACKET_COUNT(data[end]);
+        }
+
+        // The headers go through pb_push_to, which keeps track of the block
+        // in debug builds
+        uint32_t *p = pb_begin();
+        for (i = start; i < end; i += 1 + PACKET_COUNT(data[i])) {
+            uint32_t count = PACKET_COUNT(data[i]);
+            pb_push_to(PACKET_SUBCHANNEL(data[i]), p, PACKET_COMMAND(data[i]), count);
+            memcpy(p + 1, &data[i + 1], count * sizeof(uint32_t));
+            p += 1 + count;
+        }
+        pb_end(p);
+
+        start = end;
+    }
+
+    return true;
+}
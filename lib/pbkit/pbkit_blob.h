@@ -0,0 +1,43 @@
+// pbKit loader for precompiled pushbuffer blobs
+
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef PBKIT_BLOB_H
+#define PBKIT_BLOB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Blobs are written by "vp20compiler -bin" and "fp20compiler -bin". They
+// consist of this header, followed by size DWORDs of method packets for
+// SUBCH_3D, exactly as they appear in the pushbuffer.
+#define PB_BLOB_MAGIC   0x4250584E // "NXPB"
+#define PB_BLOB_VERSION 1
+
+typedef struct pb_blob_header_t_
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+} pb_blob_header_t;
+
+// The largest block of DWORDs pushed between pb_begin and pb_end
+#define PB_BLOB_MAX_BLOCK 128
+
+// Pushes the methods of a blob in as few blocks of up to PB_BLOB_MAX_BLOCK
+// DWORDs as possible. Returns false without pushing anything if the blob is
+// malformed.
+bool pb_push_blob (const void *blob, size_t size);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // PBKIT_BLOB_H
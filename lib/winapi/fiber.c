@@ -3,9 +3,12 @@
 // SPDX-FileCopyrightText: 2019-2022 Stefan Schmidt
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <threads.h>
 #include <windows.h>
+#include <xboxkrnl/xboxkrnl.h>
 
 // Each thread gets a node to keep track of its FLS data.
 // Threads must register themselves, so their FLS nodes can be put into a list
@@ -16,8 +19,34 @@ typedef struct fls_node_t_
     PVOID slots[FLS_MAXIMUM_AVAILABLE];
 } fls_node_t;
 
+// A fiber created with CreateFiber lives at the top of its own stack and
+// brings its own FLS node, a thread converted into a fiber keeps using the FLS
+// node of the thread.
+typedef struct fiber_t_
+{
+    PVOID stackPointer;
+    PVOID fiberData;
+    LPFIBER_START_ROUTINE startRoutine;
+    PVOID stackBase;
+    PVOID stackLimit;
+    fls_node_t *flsNode;
+    BOOL isThreadFiber;
+    // Only present for fibers created with CreateFiber
+    fls_node_t ownFlsNode;
+} fiber_t;
+
+void __cdecl fiber_switch (PVOID *oldStackPointer, PVOID newStackPointer);
+
+// The kernel keeps the saved FPU state of a thread (an FX_SAVE_AREA) right
+// below the stack base, so every fiber stack reserves room for it
+#define NPX_FRAME_LENGTH 0x210
+#define NPX_STATE_LOADED 0
+
 static CRITICAL_SECTION fls_lock;
 static thread_local fls_node_t fls_node;
+static thread_local fiber_t *current_fiber;
+static thread_local PVOID thread_stack_base;
+static thread_local PVOID thread_stack_limit;
 static LIST_ENTRY fls_nodes_list;
 static uint32_t fls_bitmap[FLS_MAXIMUM_AVAILABLE / 32];
 static PFLS_CALLBACK_FUNCTION fls_dtors[FLS_MAXIMUM_AVAILABLE];
@@ -31,20 +60,58 @@ static __cdecl VOID fls_init (VOID)
 #pragma comment(linker, "/include:___fls_init_p")
 __attribute__((section(".CRT$XXT"))) void(__cdecl *const __fls_init_p)(void) = fls_init;
 
-VOID fls_register_thread (VOID)
+// Points the stack bounds of the thread at the stack that is about to run.
+// The exception dispatcher checks registration records against them, and
+// they keep the stack overflow checks in __chkstk and the frame walk of the
+// profiler working.
+static VOID fiber_set_stack (PVOID stackBase, PVOID stackLimit)
+{
+    PKTHREAD thread = KeGetCurrentThread();
+    ULONG_PTR tibStackBase;
+
+    // Keep the kernel from switching threads, which saves the FPU state
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+
+    // If the FPU state isn't loaded right now, it is restored from below the
+    // stack base the next time the FPU is used, so it has to move along
+    if (thread->NpxState != NPX_STATE_LOADED) {
+        memcpy((PCHAR)stackBase - NPX_FRAME_LENGTH, (PCHAR)thread->StackBase - NPX_FRAME_LENGTH, NPX_FRAME_LENGTH);
+    }
+
+    // The TIB holds a copy of the bounds, its base is below the FPU state
+    __asm__ __volatile__("movl %%fs:4, %0" : "=r"(tibStackBase));
+    tibStackBase = (ULONG_PTR)stackBase - ((ULONG_PTR)thread->StackBase - tibStackBase);
+    __asm__ __volatile__("movl %0, %%fs:4\n"
+                         "movl %1, %%fs:8\n"
+                         :
+                         : "r"(tibStackBase), "r"(stackLimit)
+                         : "memory");
+
+    thread->StackBase = stackBase;
+    thread->StackLimit = stackLimit;
+
+    KfLowerIrql(oldIrql);
+}
+
+static fls_node_t *fls_current_node (VOID)
+{
+    return current_fiber ? current_fiber->flsNode : &fls_node;
+}
+
+static VOID fls_register_node (fls_node_t *node)
 {
     EnterCriticalSection(&fls_lock);
-    InsertTailList(&fls_nodes_list, &fls_node.listEntry);
+    InsertTailList(&fls_nodes_list, &node->listEntry);
     LeaveCriticalSection(&fls_lock);
 }
 
-VOID fls_unregister_thread (VOID)
+static VOID fls_unregister_node (fls_node_t *node)
 {
     EnterCriticalSection(&fls_lock);
 
-    RemoveEntryList(&fls_node.listEntry);
+    RemoveEntryList(&node->listEntry);
 
-    // If this thread used FLS, we need to run destructors to clean up
+    // If this node was used, we need to run destructors to clean up
     for (DWORD dwFlsIndex = 0; dwFlsIndex < FLS_MAXIMUM_AVAILABLE; dwFlsIndex++) {
         // If all 32 slots are empty, we skip checking the remaining 31 slots
         if (fls_bitmap[dwFlsIndex / 32] == 0) {
@@ -54,8 +121,8 @@ VOID fls_unregister_thread (VOID)
 
         if (fls_bitmap[dwFlsIndex / 32] & (1 << (dwFlsIndex % 32))) {
             // This slot is allocated, if we have data, we must run a destructor
-            if (fls_dtors[dwFlsIndex] != NULL && fls_node.slots[dwFlsIndex] != NULL) {
-                fls_dtors[dwFlsIndex](fls_node.slots[dwFlsIndex]);
+            if (fls_dtors[dwFlsIndex] != NULL && node->slots[dwFlsIndex] != NULL) {
+                fls_dtors[dwFlsIndex](node->slots[dwFlsIndex]);
             }
         }
     }
@@ -63,6 +130,27 @@ VOID fls_unregister_thread (VOID)
     LeaveCriticalSection(&fls_lock);
 }
 
+VOID fls_register_thread (VOID)
+{
+    fls_register_node(&fls_node);
+}
+
+VOID fls_unregister_thread (VOID)
+{
+    // A thread may exit while running a fiber, clean up that fiber's FLS data
+    // as well
+    if (current_fiber && !current_fiber->isThreadFiber) {
+        fls_unregister_node(current_fiber->flsNode);
+    }
+
+    fls_unregister_node(&fls_node);
+
+    if (current_fiber) {
+        // The kernel needs the real stack when tearing down the thread
+        fiber_set_stack(thread_stack_base, thread_stack_limit);
+    }
+}
+
 DWORD FlsAlloc (PFLS_CALLBACK_FUNCTION lpCallback)
 {
     DWORD retval = FLS_OUT_OF_INDEXES;
@@ -127,7 +215,7 @@ PVOID FlsGetValue (DWORD dwFlsIndex)
     assert(dwFlsIndex < FLS_MAXIMUM_AVAILABLE);
 
     if (dwFlsIndex < FLS_MAXIMUM_AVAILABLE) {
-        return fls_node.slots[dwFlsIndex];
+        return fls_current_node()->slots[dwFlsIndex];
     }
 
     SetLastError(ERROR_INVALID_PARAMETER);
@@ -139,10 +227,170 @@ BOOL FlsSetValue (DWORD dwFlsIndex, PVOID lpFlsData)
     assert(dwFlsIndex < FLS_MAXIMUM_AVAILABLE);
 
     if (dwFlsIndex < FLS_MAXIMUM_AVAILABLE) {
-        fls_node.slots[dwFlsIndex] = lpFlsData;
+        fls_current_node()->slots[dwFlsIndex] = lpFlsData;
         return TRUE;
     }
 
     SetLastError(ERROR_INVALID_PARAMETER);
     return FALSE;
 }
+
+static __cdecl VOID fiber_startup (VOID)
+{
+    fiber_t *fiber = current_fiber;
+
+    fiber->startRoutine(fiber->fiberData);
+
+    // Returning from a fiber routine terminates the thread, just like on Windows
+    ExitThread(0);
+}
+
+LPVOID CreateFiber (SIZE_T dwStackSize, LPFIBER_START_ROUTINE lpStartAddress, LPVOID lpParameter)
+{
+    return CreateFiberEx(dwStackSize, 0, 0, lpStartAddress, lpParameter);
+}
+
+LPVOID CreateFiberEx (SIZE_T dwStackCommitSize, SIZE_T dwStackReserveSize, DWORD dwFlags, LPFIBER_START_ROUTINE lpStartAddress, LPVOID lpParameter)
+{
+    // Stacks are always committed memory on the Xbox, so commit and reserve
+    // size are treated the same. The floating point control words are always
+    // switched, which makes FIBER_FLAG_FLOAT_SWITCH a no-op.
+    SIZE_T stackSize = dwStackCommitSize > dwStackReserveSize ? dwStackCommitSize : dwStackReserveSize;
+    if (stackSize == 0) {
+        stackSize = CURRENT_XBE_HEADER->SizeOfStack;
+    }
+    stackSize = ROUND_TO_PAGES(stackSize);
+
+    PVOID stackBase = MmCreateKernelStack(stackSize, FALSE);
+    if (stackBase == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    fiber_t *fiber = (fiber_t *)(((ULONG_PTR)stackBase - NPX_FRAME_LENGTH - sizeof(fiber_t)) & ~15);
+    RtlZeroMemory(fiber, sizeof(fiber_t));
+    fiber->fiberData = lpParameter;
+    fiber->startRoutine = lpStartAddress;
+    fiber->stackBase = stackBase;
+    fiber->stackLimit = (PCHAR)stackBase - stackSize;
+    fiber->flsNode = &fiber->ownFlsNode;
+    fiber->isThreadFiber = FALSE;
+    fls_register_node(fiber->flsNode);
+
+    // New fibers inherit the floating point configuration of their creator
+    WORD fpuControl;
+    DWORD mxcsr;
+    __asm__ __volatile__("fnstcw %0;"
+                         "stmxcsr %1;"
+                         : "=m"(fpuControl), "=m"(mxcsr));
+
+    // Build an initial frame which fiber_switch "returns" into
+    ULONG_PTR *sp = (ULONG_PTR *)fiber;
+    *--sp = 0;                        // return address of fiber_startup
+    *--sp = (ULONG_PTR)fiber_startup; // return address of fiber_switch
+    *--sp = 0;                        // ebp
+    *--sp = 0;                        // ebx
+    *--sp = 0;                        // esi
+    *--sp = 0;                        // edi
+    *--sp = 0xFFFFFFFF;               // empty SEH chain
+    *--sp = fpuControl;
+    *--sp = mxcsr;
+    fiber->stackPointer = sp;
+
+    return fiber;
+}
+
+VOID DeleteFiber (LPVOID lpFiber)
+{
+    fiber_t *fiber = lpFiber;
+
+    // Deleting the running fiber terminates the thread, just like on Windows
+    if (fiber == current_fiber) {
+        ExitThread(0);
+    }
+
+    if (fiber->isThreadFiber) {
+        ExFreePool(fiber);
+        return;
+    }
+
+    fls_unregister_node(fiber->flsNode);
+    MmDeleteKernelStack(fiber->stackBase, fiber->stackLimit);
+}
+
+LPVOID ConvertThreadToFiber (LPVOID lpParameter)
+{
+    return ConvertThreadToFiberEx(lpParameter, 0);
+}
+
+LPVOID ConvertThreadToFiberEx (LPVOID lpParameter, DWORD dwFlags)
+{
+    if (current_fiber) {
+        SetLastError(ERROR_ALREADY_FIBER);
+        return NULL;
+    }
+
+    fiber_t *fiber = ExAllocatePoolWithTag(offsetof(fiber_t, ownFlsNode), 'rbiF');
+    if (fiber == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    PKTHREAD thread = KeGetCurrentThread();
+    fiber->stackPointer = NULL;
+    fiber->fiberData = lpParameter;
+    fiber->startRoutine = NULL;
+    fiber->stackBase = thread->StackBase;
+    fiber->stackLimit = thread->StackLimit;
+    fiber->flsNode = &fls_node;
+    fiber->isThreadFiber = TRUE;
+
+    thread_stack_base = thread->StackBase;
+    thread_stack_limit = thread->StackLimit;
+    current_fiber = fiber;
+    return fiber;
+}
+
+BOOL ConvertFiberToThread (VOID)
+{
+    if (current_fiber == NULL || !current_fiber->isThreadFiber) {
+        SetLastError(ERROR_ALREADY_THREAD);
+        return FALSE;
+    }
+
+    ExFreePool(current_fiber);
+    current_fiber = NULL;
+    return TRUE;
+}
+
+VOID SwitchToFiber (LPVOID lpFiber)
+{
+    fiber_t *fiber = lpFiber;
+    fiber_t *previous = current_fiber;
+
+    assert(previous != NULL);
+    if (fiber == previous) {
+        return;
+    }
+
+    current_fiber = fiber;
+    fiber_set_stack(fiber->stackBase, fiber->stackLimit);
+
+    fiber_switch(&previous->stackPointer, fiber->stackPointer);
+}
+
+LPVOID GetCurrentFiber (VOID)
+{
+    return current_fiber;
+}
+
+LPVOID GetFiberData (VOID)
+{
+    assert(current_fiber != NULL);
+    return current_fiber->fiberData;
+}
+
+BOOL IsThreadAFiber (VOID)
+{
+    return current_fiber != NULL;
+}
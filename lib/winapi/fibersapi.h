@@ -16,6 +16,17 @@ BOOL FlsFree (DWORD dwFlsIndex);
 PVOID FlsGetValue (DWORD dwFlsIndex);
 BOOL FlsSetValue (DWORD dwFlsIndex, PVOID lpFlsData);
 
+LPVOID CreateFiber (SIZE_T dwStackSize, LPFIBER_START_ROUTINE lpStartAddress, LPVOID lpParameter);
+LPVOID CreateFiberEx (SIZE_T dwStackCommitSize, SIZE_T dwStackReserveSize, DWORD dwFlags, LPFIBER_START_ROUTINE lpStartAddress, LPVOID lpParameter);
+VOID DeleteFiber (LPVOID lpFiber);
+LPVOID ConvertThreadToFiber (LPVOID lpParameter);
+LPVOID ConvertThreadToFiberEx (LPVOID lpParameter, DWORD dwFlags);
+BOOL ConvertFiberToThread (VOID);
+VOID SwitchToFiber (LPVOID lpFiber);
+LPVOID GetCurrentFiber (VOID);
+LPVOID GetFiberData (VOID);
+BOOL IsThreadAFiber (VOID);
+
 #ifdef __cplusplus
 }
 #endif
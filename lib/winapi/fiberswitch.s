@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+.include "prelude.s.inc"
+safeseh_prelude
+
+/*
+    void __cdecl fiber_switch(PVOID *oldStackPointer, PVOID newStackPointer)
+
+    Saves the callee-saved registers, the SEH chain head from the TIB and the
+    x87/SSE control words on the current stack, stores the resulting stack
+    pointer in *oldStackPointer and restores the same state from the stack
+    newStackPointer points to. The layout (from low to high addresses) is:
+        MXCSR, x87 control word, ExceptionList, edi, esi, ebx, ebp, return address
+    CreateFiber builds an initial frame with the same layout.
+*/
+.text
+.balign 4
+.globl _fiber_switch
+_fiber_switch:
+    movl 4(%esp), %eax
+    movl 8(%esp), %edx
+
+    pushl %ebp
+    pushl %ebx
+    pushl %esi
+    pushl %edi
+    pushl %fs:0
+    subl $8, %esp
+    fnstcw 4(%esp)
+    stmxcsr (%esp)
+
+    movl %esp, (%eax)
+    movl %edx, %esp
+
+    ldmxcsr (%esp)
+    fldcw 4(%esp)
+    addl $8, %esp
+    popl %fs:0
+    popl %edi
+    popl %esi
+    popl %ebx
+    popl %ebp
+    ret
@@ -39,6 +39,7 @@ DWORD GetFileSize (HANDLE hFile, LPDWORD lpFileSizeHigh);
 BOOL GetFileSizeEx (HANDLE hFile, PLARGE_INTEGER lpFileSize);
 
 HANDLE FindFirstFileA (LPCSTR lpFileName, LPWIN32_FIND_DATAA lpFindFileData);
+HANDLE FindFirstFileExA (LPCSTR lpFileName, FINDEX_INFO_LEVELS fInfoLevelId, LPVOID lpFindFileData, FINDEX_SEARCH_OPS fSearchOp, LPVOID lpSearchFilter, DWORD dwAdditionalFlags);
 BOOL FindNextFileA (HANDLE hFindFile, LPWIN32_FIND_DATAA lpFindFileData);
 BOOL FindClose (HANDLE hFindFile);
 
@@ -47,6 +48,10 @@ BOOL RemoveDirectoryA (LPCSTR lpPathName);
 BOOL CreateDirectoryA (LPCSTR lpPathName, LPSECURITY_ATTRIBUTES lpSecurityAttributes);
 BOOL MoveFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName);
 BOOL CopyFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, BOOL bFailIfExists);
+BOOL CopyFileExA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags);
+// CopyFileChunkedA is an nxdk extension, it behaves like CopyFileExA but allows
+// choosing the size of the chunks that are read and written at once
+BOOL CopyFileChunkedA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags, DWORD dwChunkSize);
 
 BOOL GetDiskFreeSpaceExA (LPCSTR lpDirectoryName, PULARGE_INTEGER lpFreeBytesAvailableToCaller, PULARGE_INTEGER lpTotalNumberOfBytes, PULARGE_INTEGER lpTotalNumberOfFreeBytes);
 BOOL GetDiskFreeSpaceA (LPCSTR lpRootPathName, LPDWORD lpSectorsPerCluster, LPDWORD lpBytesPerSector, LPDWORD lpNumberOfFreeClusters, LPDWORD lpTotalNumberOfClusters);
@@ -59,12 +64,14 @@ DWORD GetLogicalDriveStringsA (DWORD nBufferLength, LPSTR lpBuffer);
 #define SetFileAttributes      SetFileAttributesA
 #define CreateFile             CreateFileA
 #define FindFirstFile          FindFirstFileA
+#define FindFirstFileEx        FindFirstFileExA
 #define FindNextFile           FindNextFileA
 #define DeleteFile(...)        DeleteFileA(__VA_ARGS__)
 #define RemoveDirectory(...)   RemoveDirectoryA(__VA_ARGS__)
 #define CreateDirectory(...)   CreateDirectoryA(__VA_ARGS__)
 #define MoveFile(...)          MoveFileA(__VA_ARGS__)
 #define CopyFile(...)          CopyFileA(__VA_ARGS__)
+#define CopyFileEx(...)        CopyFileExA(__VA_ARGS__)
 #define GetDiskFreeSpaceEx     GetDiskFreeSpaceExA
 #define GetDiskFreeSpace       GetDiskFreeSpaceA
 #define GetLogicalDriveStrings GetLogicalDriveStringsA
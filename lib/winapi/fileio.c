@@ -123,7 +123,12 @@ BOOL ReadFile (HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead, LPDWOR
         // InternalHigh contains the actual number of bytes transferred for the I/O request
         lpOverlapped->InternalHigh = 0;
 
-        status = NtReadFile(hFile, lpOverlapped->hEvent, NULL, NULL, (PIO_STATUS_BLOCK)&lpOverlapped->Internal,
+        // Like on Windows, setting the lowest bit of hEvent keeps the request
+        // from being queued to a completion port associated with the file
+        HANDLE event = (HANDLE)((ULONG_PTR)lpOverlapped->hEvent & ~1);
+        PVOID apcContext = ((ULONG_PTR)lpOverlapped->hEvent & 1) ? NULL : lpOverlapped;
+
+        status = NtReadFile(hFile, event, NULL, apcContext, (PIO_STATUS_BLOCK)&lpOverlapped->Internal,
                             lpBuffer, nNumberOfBytesToRead, &overlappedOffset);
 
         // The read can finish immediately. Handle this case
@@ -189,7 +194,10 @@ BOOL WriteFile (HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite, LPD
         // InternalHigh contains the actual number of bytes transferred for the I/O request
         lpOverlapped->InternalHigh = 0;
 
-        status = NtWriteFile(hFile, lpOverlapped->hEvent, NULL, NULL, (PIO_STATUS_BLOCK)&lpOverlapped->Internal,
+        HANDLE event = (HANDLE)((ULONG_PTR)lpOverlapped->hEvent & ~1);
+        PVOID apcContext = ((ULONG_PTR)lpOverlapped->hEvent & 1) ? NULL : lpOverlapped;
+
+        status = NtWriteFile(hFile, event, NULL, apcContext, (PIO_STATUS_BLOCK)&lpOverlapped->Internal,
                              (PVOID)lpBuffer, nNumberOfBytesToWrite, &overlappedOffset);
 
         // The write can finish immediately. Handle this case
@@ -336,29 +336,107 @@ BOOL MoveFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName)
     }
 }
 
+// CopyFileExA keeps COPYFILE_CHUNK_COUNT chunks in flight, so reading the
+// next chunks from the source overlaps with writing the previous ones
+#define COPYFILE_CHUNK_SIZE  (128 * 1024)
+#define COPYFILE_CHUNK_COUNT 4
+
+typedef enum copy_state_
+{
+    COPY_IDLE,
+    COPY_READING,
+    COPY_WRITING,
+} copy_state;
+
+typedef struct copy_chunk_
+{
+    copy_state state;
+    HANDLE event;
+    IO_STATUS_BLOCK ioStatusBlock;
+    LARGE_INTEGER offset;
+    ULONG length;
+    PVOID buffer;
+} copy_chunk;
+
+static NTSTATUS copy_issue_read (HANDLE sourceHandle, copy_chunk *chunk, LARGE_INTEGER *readOffset, LONGLONG fileSize, ULONG chunkSize)
+{
+    if (readOffset->QuadPart >= fileSize) {
+        chunk->state = COPY_IDLE;
+        return STATUS_SUCCESS;
+    }
+
+    chunk->offset = *readOffset;
+    chunk->state = COPY_READING;
+    readOffset->QuadPart += chunkSize;
+
+    NTSTATUS status = NtReadFile(sourceHandle, chunk->event, NULL, NULL, &chunk->ioStatusBlock, chunk->buffer, chunkSize, &chunk->offset);
+    if (!NT_SUCCESS(status)) {
+        chunk->state = COPY_IDLE;
+    }
+    return status;
+}
+
+static NTSTATUS copy_wait (copy_chunk *chunk)
+{
+    NTSTATUS status = NtWaitForSingleObjectEx(chunk->event, UserMode, FALSE, NULL);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+    return chunk->ioStatusBlock.Status;
+}
+
 BOOL CopyFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, BOOL bFailIfExists)
+{
+    return CopyFileExA(lpExistingFileName, lpNewFileName, NULL, NULL, NULL, bFailIfExists ? COPY_FILE_FAIL_IF_EXISTS : 0);
+}
+
+BOOL CopyFileExA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags)
+{
+    return CopyFileChunkedA(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags, COPYFILE_CHUNK_SIZE);
+}
+
+BOOL CopyFileChunkedA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags, DWORD dwChunkSize)
 {
     NTSTATUS status;
     HANDLE sourceHandle;
     HANDLE targetHandle = INVALID_HANDLE_VALUE;
+    ANSI_STRING sourcePath;
     ANSI_STRING targetPath;
     OBJECT_ATTRIBUTES objectAttributes;
     IO_STATUS_BLOCK ioStatusBlock;
     FILE_BASIC_INFORMATION fileBasicInformation;
     FILE_NETWORK_OPEN_INFORMATION networkOpenInformation;
-    LPVOID readBuffer = NULL;
-    SIZE_T readBufferRegionSize = 64 * 1024;
-    DWORD bytesRead;
-
-    sourceHandle = CreateFile(
-        lpExistingFileName,
-        FILE_GENERIC_READ,
+    FILE_END_OF_FILE_INFORMATION endOfFileInformation;
+    copy_chunk chunks[COPYFILE_CHUNK_COUNT];
+    LPVOID buffer = NULL;
+    SIZE_T bufferRegionSize;
+    ULONG chunkSize;
+    LARGE_INTEGER readOffset;
+    LARGE_INTEGER bytesTransferred;
+    LONGLONG fileSize;
+    int busyChunks = 0;
+    DWORD error = ERROR_SUCCESS;
+    BOOL deleteTarget = TRUE;
+
+    if (dwChunkSize == 0) {
+        dwChunkSize = COPYFILE_CHUNK_SIZE;
+    }
+    chunkSize = ROUND_TO_PAGES(dwChunkSize);
+
+    // The source and target are opened for asynchronous I/O, so several
+    // reads and writes can be queued at once
+    RtlInitAnsiString(&sourcePath, lpExistingFileName);
+    InitializeObjectAttributes(&objectAttributes, &sourcePath, OBJ_CASE_INSENSITIVE, ObDosDevicesDirectory(), NULL);
+
+    status = NtOpenFile(
+        &sourceHandle,
+        FILE_GENERIC_READ | ((dwCopyFlags & COPY_FILE_OPEN_SOURCE_FOR_WRITE) ? FILE_GENERIC_WRITE : 0),
+        &objectAttributes,
+        &ioStatusBlock,
         FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-        NULL);
-    if (sourceHandle == INVALID_HANDLE_VALUE) {
+        FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY);
+    if (!NT_SUCCESS(status)) {
+        SetLastError(RtlNtStatusToDosError(status));
         return FALSE;
     }
 
@@ -373,6 +451,7 @@ BOOL CopyFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, BOOL bFailIfExi
         SetLastError(RtlNtStatusToDosError(status));
         return FALSE;
     }
+    fileSize = networkOpenInformation.EndOfFile.QuadPart;
 
     RtlInitAnsiString(&targetPath, lpNewFileName);
     InitializeObjectAttributes(&objectAttributes, &targetPath, OBJ_CASE_INSENSITIVE, ObDosDevicesDirectory(), NULL);
@@ -385,57 +464,172 @@ BOOL CopyFileA (LPCSTR lpExistingFileName, LPCSTR lpNewFileName, BOOL bFailIfExi
         &networkOpenInformation.AllocationSize,
         networkOpenInformation.FileAttributes,
         0,
-        bFailIfExists ? FILE_CREATE : FILE_SUPERSEDE,
-        FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY);
+        (dwCopyFlags & COPY_FILE_FAIL_IF_EXISTS) ? FILE_CREATE : FILE_SUPERSEDE,
+        FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY);
     if (!NT_SUCCESS(status)) {
         NtClose(sourceHandle);
         SetLastError(RtlNtStatusToDosError(status));
         return FALSE;
     }
 
-    status = NtAllocateVirtualMemory(&readBuffer,
+    // Set the final size up front, so the writes don't have to extend the
+    // file one after another
+    endOfFileInformation.EndOfFile.QuadPart = fileSize;
+    status = NtSetInformationFile(targetHandle, &ioStatusBlock, &endOfFileInformation, sizeof(endOfFileInformation), FileEndOfFileInformation);
+    if (!NT_SUCCESS(status)) {
+        DeleteHandle(targetHandle);
+        NtClose(sourceHandle);
+        NtClose(targetHandle);
+        SetLastError(RtlNtStatusToDosError(status));
+        return FALSE;
+    }
+
+    bufferRegionSize = chunkSize * COPYFILE_CHUNK_COUNT;
+    status = NtAllocateVirtualMemory(&buffer,
                                      0,
-                                     &readBufferRegionSize,
+                                     &bufferRegionSize,
                                      MEM_RESERVE | MEM_COMMIT,
                                      PAGE_READWRITE);
     if (!NT_SUCCESS(status)) {
+        DeleteHandle(targetHandle);
         NtClose(sourceHandle);
         NtClose(targetHandle);
         SetLastError(RtlNtStatusToDosError(status));
         return FALSE;
     }
 
-    while (TRUE) {
-        const BYTE *bufferPos = readBuffer;
-        if (!ReadFile(sourceHandle, readBuffer, readBufferRegionSize, &bytesRead, NULL)) {
-            NtFreeVirtualMemory(&readBuffer, &readBufferRegionSize, MEM_RELEASE);
-            DeleteHandle(targetHandle);
-            NtClose(sourceHandle);
-            NtClose(targetHandle);
-            return FALSE;
+    for (int i = 0; i < COPYFILE_CHUNK_COUNT; i++) {
+        chunks[i].state = COPY_IDLE;
+        chunks[i].buffer = (PCHAR)buffer + i * chunkSize;
+        status = NtCreateEvent(&chunks[i].event, NULL, NotificationEvent, FALSE);
+        if (!NT_SUCCESS(status)) {
+            chunks[i].event = NULL;
+            error = RtlNtStatusToDosError(status);
         }
+    }
 
-        if (!bytesRead) {
+    bytesTransferred.QuadPart = 0;
+    if (error == ERROR_SUCCESS && lpProgressRoutine) {
+        LARGE_INTEGER totalSize = networkOpenInformation.EndOfFile;
+        DWORD result = lpProgressRoutine(totalSize, bytesTransferred, totalSize, bytesTransferred, 1, CALLBACK_STREAM_SWITCH, sourceHandle, targetHandle, lpData);
+        if (result == PROGRESS_CANCEL || result == PROGRESS_STOP) {
+            error = ERROR_REQUEST_ABORTED;
+            deleteTarget = (result == PROGRESS_CANCEL);
+        } else if (result == PROGRESS_QUIET) {
+            lpProgressRoutine = NULL;
+        }
+    }
+
+    // Fill the pipeline with reads
+    readOffset.QuadPart = 0;
+    for (int i = 0; i < COPYFILE_CHUNK_COUNT && error == ERROR_SUCCESS; i++) {
+        status = copy_issue_read(sourceHandle, &chunks[i], &readOffset, fileSize, chunkSize);
+        if (!NT_SUCCESS(status)) {
+            error = RtlNtStatusToDosError(status);
+        } else if (chunks[i].state != COPY_IDLE) {
+            busyChunks++;
+        }
+    }
+
+    // Chunks are processed in order: Once a chunk was read it gets written,
+    // once it was written it's reused to read the next chunk. Chunks with
+    // nothing left to read stay idle, the copy is done once all of them are.
+    for (int head = 0; error == ERROR_SUCCESS && busyChunks > 0; head = (head + 1) % COPYFILE_CHUNK_COUNT) {
+        copy_chunk *chunk = &chunks[head];
+
+        if (chunk->state == COPY_IDLE) {
+            continue;
+        }
+
+        status = copy_wait(chunk);
+        if (status == STATUS_END_OF_FILE && chunk->state == COPY_READING) {
+            chunk->ioStatusBlock.Information = 0;
+        } else if (!NT_SUCCESS(status)) {
+            chunk->state = COPY_IDLE;
+            error = RtlNtStatusToDosError(status);
+            break;
+        }
+
+        if (chunk->state == COPY_READING) {
+            chunk->length = chunk->ioStatusBlock.Information;
+            if (chunk->length == 0) {
+                // The file got shorter while copying it
+                chunk->state = COPY_IDLE;
+                busyChunks--;
+                continue;
+            }
+
+            chunk->state = COPY_WRITING;
+            status = NtWriteFile(targetHandle, chunk->event, NULL, NULL, &chunk->ioStatusBlock, chunk->buffer, chunk->length, &chunk->offset);
+            if (!NT_SUCCESS(status)) {
+                chunk->state = COPY_IDLE;
+                error = RtlNtStatusToDosError(status);
+            }
+            continue;
+        }
+
+        if (chunk->ioStatusBlock.Information != chunk->length) {
+            chunk->state = COPY_IDLE;
+            error = ERROR_WRITE_FAULT;
             break;
         }
+        bytesTransferred.QuadPart += chunk->length;
 
-        while (bytesRead > 0) {
-            DWORD bytesWritten = 0;
-            if (!WriteFile(targetHandle, bufferPos, bytesRead, &bytesWritten, NULL)) {
-                NtFreeVirtualMemory(&readBuffer, &readBufferRegionSize, MEM_RELEASE);
-                DeleteHandle(targetHandle);
-                NtClose(sourceHandle);
-                NtClose(targetHandle);
-                return FALSE;
+        if (pbCancel && *pbCancel) {
+            chunk->state = COPY_IDLE;
+            error = ERROR_REQUEST_ABORTED;
+            break;
+        }
+
+        if (lpProgressRoutine) {
+            LARGE_INTEGER totalSize = networkOpenInformation.EndOfFile;
+            DWORD result = lpProgressRoutine(totalSize, bytesTransferred, totalSize, bytesTransferred, 1, CALLBACK_CHUNK_FINISHED, sourceHandle, targetHandle, lpData);
+            if (result == PROGRESS_CANCEL || result == PROGRESS_STOP) {
+                chunk->state = COPY_IDLE;
+                error = ERROR_REQUEST_ABORTED;
+                deleteTarget = (result == PROGRESS_CANCEL);
+                break;
+            } else if (result == PROGRESS_QUIET) {
+                lpProgressRoutine = NULL;
             }
-            bytesRead -= bytesWritten;
-            bufferPos += bytesWritten;
+        }
+
+        status = copy_issue_read(sourceHandle, chunk, &readOffset, fileSize, chunkSize);
+        if (!NT_SUCCESS(status)) {
+            error = RtlNtStatusToDosError(status);
+        } else if (chunk->state == COPY_IDLE) {
+            busyChunks--;
+        }
+    }
+
+    // Requests may still be in flight when the copy failed
+    for (int i = 0; i < COPYFILE_CHUNK_COUNT; i++) {
+        if (chunks[i].state != COPY_IDLE) {
+            copy_wait(&chunks[i]);
+        }
+        if (chunks[i].event) {
+            NtClose(chunks[i].event);
         }
     }
 
-    status = NtFreeVirtualMemory(&readBuffer, &readBufferRegionSize, MEM_RELEASE);
+    status = NtFreeVirtualMemory(&buffer, &bufferRegionSize, MEM_RELEASE);
     assert(NT_SUCCESS(status));
 
+    if (error == ERROR_SUCCESS && bytesTransferred.QuadPart != fileSize) {
+        // The source changed size while copying it, the target is incomplete
+        error = ERROR_HANDLE_EOF;
+    }
+
+    if (error != ERROR_SUCCESS) {
+        if (deleteTarget) {
+            DeleteHandle(targetHandle);
+        }
+        NtClose(sourceHandle);
+        NtClose(targetHandle);
+        SetLastError(error);
+        return FALSE;
+    }
+
     RtlZeroMemory(&fileBasicInformation, sizeof(fileBasicInformation));
     fileBasicInformation.LastWriteTime = networkOpenInformation.LastWriteTime;
     fileBasicInformation.FileAttributes = networkOpenInformation.FileAttributes;
@@ -10,12 +10,19 @@
 #include <winerror.h>
 #include <xboxkrnl/xboxkrnl.h>
 
-struct FileInfo
+// Directory records are fetched into a buffer that's part of the find handle,
+// so FindNextFileA only needs to call into the kernel after all records
+// returned by the file system driver have been consumed.
+#define FIND_BUFFER_SIZE 4096
+
+typedef struct find_handle_t_
 {
-    FILE_DIRECTORY_INFORMATION dirInfo;
-    // Reserve path buffer minus the null-terminator and the first byte provided by dirInfo
-    char filename[MAX_PATH - 2];
-};
+    HANDLE dirHandle;
+    BOOL directoriesOnly;
+    // Next record to return from the buffer, NULL if it needs to be refilled
+    FILE_DIRECTORY_INFORMATION *next;
+    ULONGLONG buffer[];
+} find_handle_t;
 
 static void dirtofind (FILE_DIRECTORY_INFORMATION *dirInfo, LPWIN32_FIND_DATAA lpFindFileData)
 {
@@ -33,17 +40,74 @@ static void dirtofind (FILE_DIRECTORY_INFORMATION *dirInfo, LPWIN32_FIND_DATAA l
     lpFindFileData->cAlternateFileName[0] = '\0';
 }
 
+static NTSTATUS find_fetch (find_handle_t *find, POBJECT_STRING mask, BOOLEAN restartScan)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK ioStatusBlock;
+
+    find->next = NULL;
+    status = NtQueryDirectoryFile(find->dirHandle, NULL, NULL, NULL, &ioStatusBlock, find->buffer, FIND_BUFFER_SIZE, FileDirectoryInformation, mask, restartScan);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+    if (ioStatusBlock.Information == 0) {
+        return STATUS_NO_MORE_FILES;
+    }
+
+    find->next = (FILE_DIRECTORY_INFORMATION *)find->buffer;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS find_next (find_handle_t *find, LPWIN32_FIND_DATAA lpFindFileData)
+{
+    NTSTATUS status;
+
+    while (true) {
+        if (find->next == NULL) {
+            status = find_fetch(find, NULL, FALSE);
+            if (!NT_SUCCESS(status)) {
+                return status;
+            }
+        }
+
+        FILE_DIRECTORY_INFORMATION *dirInfo = find->next;
+        if (dirInfo->NextEntryOffset != 0) {
+            find->next = (FILE_DIRECTORY_INFORMATION *)((PCHAR)dirInfo + dirInfo->NextEntryOffset);
+        } else {
+            find->next = NULL;
+        }
+
+        if (find->directoriesOnly && !(dirInfo->FileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            continue;
+        }
+
+        dirtofind(dirInfo, lpFindFileData);
+        return STATUS_SUCCESS;
+    }
+}
+
 HANDLE FindFirstFileA (LPCSTR lpFileName, LPWIN32_FIND_DATAA lpFindFileData)
+{
+    return FindFirstFileExA(lpFileName, FindExInfoStandard, lpFindFileData, FindExSearchNameMatch, NULL, 0);
+}
+
+HANDLE FindFirstFileExA (LPCSTR lpFileName, FINDEX_INFO_LEVELS fInfoLevelId, LPVOID lpFindFileData, FINDEX_SEARCH_OPS fSearchOp, LPVOID lpSearchFilter, DWORD dwAdditionalFlags)
 {
     NTSTATUS status;
     ANSI_STRING dirPath;
     ANSI_STRING mask;
     IO_STATUS_BLOCK ioStatusBlock;
     OBJECT_ATTRIBUTES attributes;
-    struct FileInfo fileInformation;
     HANDLE handle;
     size_t maskOffset;
 
+    // There are no short names, so FindExInfoBasic only differs in not
+    // having to fill cAlternateFileName, which is always empty
+    if (fInfoLevelId >= FindExInfoMaxInfoLevel || fSearchOp >= FindExSearchLimitToDevices || lpSearchFilter != NULL) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return INVALID_HANDLE_VALUE;
+    }
+
     assert(strlen(lpFileName) < MAX_PATH);
 
     RtlInitAnsiString(&dirPath, lpFileName);
@@ -80,28 +144,38 @@ HANDLE FindFirstFileA (LPCSTR lpFileName, LPWIN32_FIND_DATAA lpFindFileData)
         return INVALID_HANDLE_VALUE;
     }
 
-    memset(&fileInformation, 0, sizeof(fileInformation));
-    status = NtQueryDirectoryFile(handle, NULL, NULL, NULL, &ioStatusBlock, &fileInformation, sizeof(fileInformation), FileDirectoryInformation, &mask, TRUE);
+    // FIND_FIRST_EX_LARGE_FETCH is accepted, but FATX hands out few records
+    // per call anyway, so there's no point in a larger buffer
+    find_handle_t *find = ExAllocatePoolWithTag(sizeof(find_handle_t) + FIND_BUFFER_SIZE, 'dniF');
+    if (find == NULL) {
+        NtClose(handle);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    find->dirHandle = handle;
+    find->directoriesOnly = fSearchOp == FindExSearchLimitToDirectories;
+
+    status = find_fetch(find, &mask, TRUE);
+    if (NT_SUCCESS(status)) {
+        status = find_next(find, lpFindFileData);
+    }
 
     if (!NT_SUCCESS(status)) {
         NtClose(handle);
+        ExFreePool(find);
         SetLastError(RtlNtStatusToDosError(status));
         return INVALID_HANDLE_VALUE;
     }
 
-    dirtofind(&fileInformation.dirInfo, lpFindFileData);
-
-    return handle;
+    return find;
 }
 
 BOOL FindNextFileA (HANDLE hFindFile, LPWIN32_FIND_DATAA lpFindFileData)
 {
     NTSTATUS status;
-    IO_STATUS_BLOCK ioStatusBlock;
-    struct FileInfo fileInformation;
 
-    memset(&fileInformation, 0, sizeof(fileInformation));
-    status = NtQueryDirectoryFile(hFindFile, NULL, NULL, NULL, &ioStatusBlock, &fileInformation, sizeof(fileInformation), FileDirectoryInformation, NULL, FALSE);
+    status = find_next(hFindFile, lpFindFileData);
     if (status == STATUS_NO_MORE_FILES) {
         SetLastError(ERROR_NO_MORE_FILES);
         return FALSE;
@@ -110,14 +184,15 @@ BOOL FindNextFileA (HANDLE hFindFile, LPWIN32_FIND_DATAA lpFindFileData)
         return FALSE;
     }
 
-    dirtofind(&fileInformation.dirInfo, lpFindFileData);
-
     return TRUE;
 }
 
 BOOL FindClose (HANDLE hFindFile)
 {
-    NTSTATUS status = NtClose(hFindFile);
+    find_handle_t *find = hFindFile;
+    NTSTATUS status = NtClose(find->dirHandle);
+
+    ExFreePool(find);
 
     if (NT_SUCCESS(status)) {
         return TRUE;
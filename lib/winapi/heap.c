@@ -0,0 +1,587 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include <assert.h>
+#include <errhandlingapi.h>
+#include <heapapi.h>
+#include <string.h>
+#include <synchapi.h>
+#include <winbase.h>
+#include <winerror.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+// Heaps are made of segments: Regions of virtual memory that are reserved in
+// units of the 64 KiB allocation granularity, so each segment starts at an
+// aligned address and keeps its header there. The segment a block belongs to
+// is found by masking the address of the block.
+// Small blocks are carved from slabs, single-segment regions which only hold
+// blocks of one size class. Pages of a slab are committed as they are used.
+// Blocks larger than the largest size class get a segment of their own.
+#define HEAP_SEGMENT_SIZE (64 * 1024)
+#define HEAP_CLASS_COUNT  24
+#define HEAP_LARGE_CLASS  HEAP_CLASS_COUNT
+#define HEAP_MAX_SMALL    2048
+#define HEAP_MAGIC        'paeH'
+
+// Four classes per power of two, which limits the internal fragmentation to
+// 25% while keeping the number of partially used slabs low
+static const ULONG heap_class_sizes[HEAP_CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+};
+
+struct heap_;
+
+typedef struct heap_segment_
+{
+    struct heap_ *heap;
+    LIST_ENTRY heapLink;
+    LIST_ENTRY classLink;
+    ULONG sizeClass;
+    // Size of the blocks of a slab, or the requested size of a large block
+    SIZE_T blockSize;
+    ULONG used;
+    ULONG capacity;
+    PVOID freeList;
+    PCHAR bumpPointer;
+    PCHAR committedEnd;
+    SIZE_T reservedSize;
+} heap_segment_t;
+
+#define HEAP_SEGMENT_HEADER_SIZE ((sizeof(heap_segment_t) + 15) & ~15)
+
+typedef struct heap_
+{
+    DWORD magic;
+    DWORD flags;
+    CRITICAL_SECTION lock;
+    SIZE_T maximumSize;
+    SIZE_T allocatedBytes;
+    SIZE_T committedBytes;
+    SIZE_T reservedBytes;
+    LIST_ENTRY segments;
+    // Slabs which have free blocks left, at most one of them is empty
+    LIST_ENTRY partialSlabs[HEAP_CLASS_COUNT];
+} heap_t;
+
+static INIT_ONCE heap_process_init_once = INIT_ONCE_STATIC_INIT;
+static heap_t *heap_process_heap;
+
+static ULONG heap_size_class (SIZE_T size)
+{
+    if (size <= 128) {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+
+    ULONG power = 31 - __builtin_clz(size - 1);
+    return 8 + (power - 7) * 4 + ((size - 1 - (1 << power)) >> (power - 2));
+}
+
+static heap_t *heap_from_handle (HANDLE hHeap)
+{
+    heap_t *heap = (heap_t *)hHeap;
+
+    if (heap == NULL || heap->magic != HEAP_MAGIC) {
+        return NULL;
+    }
+    return heap;
+}
+
+static VOID heap_lock (heap_t *heap, DWORD flags)
+{
+    if (!(flags & HEAP_NO_SERIALIZE)) {
+        EnterCriticalSection(&heap->lock);
+    }
+}
+
+static VOID heap_unlock (heap_t *heap, DWORD flags)
+{
+    if (!(flags & HEAP_NO_SERIALIZE)) {
+        LeaveCriticalSection(&heap->lock);
+    }
+}
+
+static BOOL heap_commit (heap_t *heap, PVOID address, SIZE_T size)
+{
+    NTSTATUS status;
+
+    if (heap->maximumSize != 0 && heap->committedBytes + size > heap->maximumSize) {
+        return FALSE;
+    }
+
+    status = NtAllocateVirtualMemory(&address, 0, &size, MEM_COMMIT, PAGE_READWRITE);
+    if (!NT_SUCCESS(status)) {
+        return FALSE;
+    }
+
+    heap->committedBytes += size;
+    return TRUE;
+}
+
+static VOID heap_decommit (heap_t *heap, PVOID address, SIZE_T size)
+{
+    NTSTATUS status;
+
+    status = NtFreeVirtualMemory(&address, &size, MEM_DECOMMIT);
+    assert(NT_SUCCESS(status));
+    heap->committedBytes -= size;
+}
+
+static heap_segment_t *heap_create_segment (heap_t *heap, SIZE_T reserveSize, SIZE_T commitSize)
+{
+    NTSTATUS status;
+    PVOID base = NULL;
+    heap_segment_t *segment;
+
+    reserveSize = (reserveSize + HEAP_SEGMENT_SIZE - 1) & ~(HEAP_SEGMENT_SIZE - 1);
+    status = NtAllocateVirtualMemory(&base, 0, &reserveSize, MEM_RESERVE, PAGE_READWRITE);
+    if (!NT_SUCCESS(status)) {
+        return NULL;
+    }
+    assert(((ULONG_PTR)base & (HEAP_SEGMENT_SIZE - 1)) == 0);
+
+    if (!heap_commit(heap, base, commitSize)) {
+        SIZE_T freeSize = 0;
+        status = NtFreeVirtualMemory(&base, &freeSize, MEM_RELEASE);
+        assert(NT_SUCCESS(status));
+        return NULL;
+    }
+
+    segment = base;
+    segment->heap = heap;
+    segment->committedEnd = (PCHAR)base + commitSize;
+    segment->reservedSize = reserveSize;
+    InsertTailList(&heap->segments, &segment->heapLink);
+    heap->reservedBytes += reserveSize;
+
+    return segment;
+}
+
+static VOID heap_release_segment (heap_t *heap, heap_segment_t *segment)
+{
+    NTSTATUS status;
+    PVOID base = segment;
+    SIZE_T size = 0;
+
+    RemoveEntryList(&segment->heapLink);
+    heap->committedBytes -= segment->committedEnd - (PCHAR)segment;
+    heap->reservedBytes -= segment->reservedSize;
+
+    status = NtFreeVirtualMemory(&base, &size, MEM_RELEASE);
+    assert(NT_SUCCESS(status));
+}
+
+static heap_segment_t *heap_segment_from_block (heap_t *heap, LPCVOID block)
+{
+    heap_segment_t *segment = (heap_segment_t *)((ULONG_PTR)block & ~(HEAP_SEGMENT_SIZE - 1));
+    PCHAR firstBlock = (PCHAR)segment + HEAP_SEGMENT_HEADER_SIZE;
+
+    if (segment->heap != heap || (PCHAR)block < firstBlock) {
+        return NULL;
+    }
+
+    if (segment->sizeClass == HEAP_LARGE_CLASS) {
+        return (PCHAR)block == firstBlock ? segment : NULL;
+    }
+
+    if ((PCHAR)block >= segment->bumpPointer || ((PCHAR)block - firstBlock) % segment->blockSize != 0) {
+        return NULL;
+    }
+    return segment;
+}
+
+static PVOID heap_alloc_large (heap_t *heap, SIZE_T size)
+{
+    heap_segment_t *segment;
+
+    if (size > (SIZE_T)-1 - 2 * HEAP_SEGMENT_SIZE) {
+        return NULL;
+    }
+
+    segment = heap_create_segment(heap, HEAP_SEGMENT_HEADER_SIZE + size, ROUND_TO_PAGES(HEAP_SEGMENT_HEADER_SIZE + size));
+    if (segment == NULL) {
+        return NULL;
+    }
+
+    segment->sizeClass = HEAP_LARGE_CLASS;
+    segment->blockSize = size;
+    segment->used = 1;
+    segment->capacity = 1;
+    segment->freeList = NULL;
+    segment->bumpPointer = segment->committedEnd;
+
+    heap->allocatedBytes += size;
+    return (PCHAR)segment + HEAP_SEGMENT_HEADER_SIZE;
+}
+
+static PVOID heap_alloc_small (heap_t *heap, SIZE_T size)
+{
+    ULONG sizeClass = heap_size_class(size);
+    PLIST_ENTRY partialSlabs = &heap->partialSlabs[sizeClass];
+    heap_segment_t *slab;
+    PVOID block;
+
+    if (IsListEmpty(partialSlabs)) {
+        slab = heap_create_segment(heap, HEAP_SEGMENT_SIZE, PAGE_SIZE);
+        if (slab == NULL) {
+            return NULL;
+        }
+
+        slab->sizeClass = sizeClass;
+        slab->blockSize = heap_class_sizes[sizeClass];
+        slab->used = 0;
+        slab->capacity = (HEAP_SEGMENT_SIZE - HEAP_SEGMENT_HEADER_SIZE) / slab->blockSize;
+        slab->freeList = NULL;
+        slab->bumpPointer = (PCHAR)slab + HEAP_SEGMENT_HEADER_SIZE;
+        InsertHeadList(partialSlabs, &slab->classLink);
+    } else {
+        slab = CONTAINING_RECORD(partialSlabs->Flink, heap_segment_t, classLink);
+    }
+
+    if (slab->freeList != NULL) {
+        block = slab->freeList;
+        slab->freeList = *(PVOID *)block;
+    } else {
+        PCHAR end = slab->bumpPointer + slab->blockSize;
+        if (end > slab->committedEnd) {
+            SIZE_T commitSize = ROUND_TO_PAGES(end - slab->committedEnd);
+            if (!heap_commit(heap, slab->committedEnd, commitSize)) {
+                return NULL;
+            }
+            slab->committedEnd += commitSize;
+        }
+        block = slab->bumpPointer;
+        slab->bumpPointer = end;
+    }
+
+    slab->used++;
+    if (slab->used == slab->capacity) {
+        RemoveEntryList(&slab->classLink);
+    }
+
+    heap->allocatedBytes += slab->blockSize;
+    return block;
+}
+
+static PVOID heap_alloc_locked (heap_t *heap, SIZE_T size)
+{
+    if (size > HEAP_MAX_SMALL) {
+        return heap_alloc_large(heap, size);
+    }
+    return heap_alloc_small(heap, size);
+}
+
+static VOID heap_free_locked (heap_t *heap, heap_segment_t *segment, PVOID block)
+{
+    heap->allocatedBytes -= segment->blockSize;
+
+    if (segment->sizeClass == HEAP_LARGE_CLASS) {
+        heap_release_segment(heap, segment);
+        return;
+    }
+
+    PLIST_ENTRY partialSlabs = &heap->partialSlabs[segment->sizeClass];
+    if (segment->used == segment->capacity) {
+        InsertHeadList(partialSlabs, &segment->classLink);
+    }
+
+    *(PVOID *)block = segment->freeList;
+    segment->freeList = block;
+    segment->used--;
+
+    // Keep a single empty slab per class around, so allocating and freeing a
+    // block in a loop doesn't map and unmap a slab each time
+    if (segment->used == 0 && partialSlabs->Flink != partialSlabs->Blink) {
+        RemoveEntryList(&segment->classLink);
+        heap_release_segment(heap, segment);
+    }
+}
+
+// Tries to resize a large block without moving it, returns FALSE if the
+// reserved region of the segment is too small
+static BOOL heap_resize_large (heap_t *heap, heap_segment_t *segment, SIZE_T size)
+{
+    if (size > segment->reservedSize - HEAP_SEGMENT_HEADER_SIZE) {
+        return FALSE;
+    }
+
+    PCHAR committedEnd = (PCHAR)segment + ROUND_TO_PAGES(HEAP_SEGMENT_HEADER_SIZE + size);
+    if (committedEnd > segment->committedEnd) {
+        if (!heap_commit(heap, segment->committedEnd, committedEnd - segment->committedEnd)) {
+            return FALSE;
+        }
+    } else if (committedEnd < segment->committedEnd) {
+        heap_decommit(heap, committedEnd, segment->committedEnd - committedEnd);
+    }
+    segment->committedEnd = committedEnd;
+    segment->bumpPointer = committedEnd;
+
+    heap->allocatedBytes += size - segment->blockSize;
+    segment->blockSize = size;
+    return TRUE;
+}
+
+static VOID heap_alloc_failed (DWORD flags)
+{
+    if (flags & HEAP_GENERATE_EXCEPTIONS) {
+        RaiseException(STATUS_NO_MEMORY, 0, 0, NULL);
+    }
+    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+}
+
+HANDLE HeapCreate (DWORD flOptions, SIZE_T dwInitialSize, SIZE_T dwMaximumSize)
+{
+    heap_t *heap;
+
+    heap = ExAllocatePoolWithTag(sizeof(heap_t), HEAP_MAGIC);
+    if (heap == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    heap->magic = HEAP_MAGIC;
+    heap->flags = flOptions & (HEAP_NO_SERIALIZE | HEAP_GENERATE_EXCEPTIONS);
+    // Memory is committed on demand, so the initial size only matters as the
+    // lower bound of the maximum size of fixed-size heaps
+    if (dwMaximumSize != 0) {
+        heap->maximumSize = ROUND_TO_PAGES(dwMaximumSize > dwInitialSize ? dwMaximumSize : dwInitialSize);
+    } else {
+        heap->maximumSize = 0;
+    }
+    heap->allocatedBytes = 0;
+    heap->committedBytes = 0;
+    heap->reservedBytes = 0;
+    InitializeListHead(&heap->segments);
+    for (int i = 0; i < HEAP_CLASS_COUNT; i++) {
+        InitializeListHead(&heap->partialSlabs[i]);
+    }
+    InitializeCriticalSection(&heap->lock);
+
+    return heap;
+}
+
+BOOL HeapDestroy (HANDLE hHeap)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+
+    if (heap == NULL || heap == heap_process_heap) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    while (!IsListEmpty(&heap->segments)) {
+        heap_release_segment(heap, CONTAINING_RECORD(heap->segments.Flink, heap_segment_t, heapLink));
+    }
+
+    DeleteCriticalSection(&heap->lock);
+    heap->magic = 0;
+    ExFreePool(heap);
+
+    return TRUE;
+}
+
+static BOOL WINAPI heap_process_init (PINIT_ONCE InitOnce, PVOID Parameter, PVOID *Context)
+{
+    heap_process_heap = HeapCreate(0, 0, 0);
+    return heap_process_heap != NULL;
+}
+
+HANDLE GetProcessHeap (VOID)
+{
+    if (!InitOnceExecuteOnce(&heap_process_init_once, heap_process_init, NULL, NULL)) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    return heap_process_heap;
+}
+
+LPVOID HeapAlloc (HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+    PVOID block;
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return NULL;
+    }
+    dwFlags |= heap->flags;
+
+    heap_lock(heap, dwFlags);
+    block = heap_alloc_locked(heap, dwBytes);
+    heap_unlock(heap, dwFlags);
+
+    if (block == NULL) {
+        heap_alloc_failed(dwFlags);
+        return NULL;
+    }
+
+    if (dwFlags & HEAP_ZERO_MEMORY) {
+        RtlZeroMemory(block, dwBytes);
+    }
+    return block;
+}
+
+LPVOID HeapReAlloc (HANDLE hHeap, DWORD dwFlags, LPVOID lpMem, SIZE_T dwBytes)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+    heap_segment_t *segment;
+    SIZE_T oldSize;
+    PVOID block;
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return NULL;
+    }
+    dwFlags |= heap->flags;
+
+    heap_lock(heap, dwFlags);
+
+    segment = lpMem ? heap_segment_from_block(heap, lpMem) : NULL;
+    if (segment == NULL) {
+        heap_unlock(heap, dwFlags);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+    oldSize = segment->blockSize;
+
+    if (segment->sizeClass == HEAP_LARGE_CLASS) {
+        // Large blocks only move when they have to, or to release the memory
+        // when they shrink into a slab
+        if ((dwBytes > HEAP_MAX_SMALL || (dwFlags & HEAP_REALLOC_IN_PLACE_ONLY)) && heap_resize_large(heap, segment, dwBytes)) {
+            heap_unlock(heap, dwFlags);
+            if ((dwFlags & HEAP_ZERO_MEMORY) && dwBytes > oldSize) {
+                RtlZeroMemory((PCHAR)lpMem + oldSize, dwBytes - oldSize);
+            }
+            return lpMem;
+        }
+    } else if (dwBytes <= oldSize && (heap_size_class(dwBytes) == segment->sizeClass || (dwFlags & HEAP_REALLOC_IN_PLACE_ONLY))) {
+        heap_unlock(heap, dwFlags);
+        return lpMem;
+    }
+
+    if (dwFlags & HEAP_REALLOC_IN_PLACE_ONLY) {
+        heap_unlock(heap, dwFlags);
+        heap_alloc_failed(dwFlags);
+        return NULL;
+    }
+
+    block = heap_alloc_locked(heap, dwBytes);
+    if (block == NULL) {
+        heap_unlock(heap, dwFlags);
+        heap_alloc_failed(dwFlags);
+        return NULL;
+    }
+
+    memcpy(block, lpMem, dwBytes < oldSize ? dwBytes : oldSize);
+    heap_free_locked(heap, segment, lpMem);
+    heap_unlock(heap, dwFlags);
+
+    if ((dwFlags & HEAP_ZERO_MEMORY) && dwBytes > oldSize) {
+        RtlZeroMemory((PCHAR)block + oldSize, dwBytes - oldSize);
+    }
+    return block;
+}
+
+BOOL HeapFree (HANDLE hHeap, DWORD dwFlags, LPVOID lpMem)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+    heap_segment_t *segment;
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    if (lpMem == NULL) {
+        return TRUE;
+    }
+    dwFlags |= heap->flags;
+
+    heap_lock(heap, dwFlags);
+
+    segment = heap_segment_from_block(heap, lpMem);
+    if (segment == NULL) {
+        heap_unlock(heap, dwFlags);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    heap_free_locked(heap, segment, lpMem);
+    heap_unlock(heap, dwFlags);
+
+    return TRUE;
+}
+
+// Blocks from slabs report the size of their class, which may be larger than
+// the size that was requested
+SIZE_T HeapSize (HANDLE hHeap, DWORD dwFlags, LPCVOID lpMem)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+    heap_segment_t *segment;
+    SIZE_T size;
+
+    if (heap == NULL || lpMem == NULL) {
+        return (SIZE_T)-1;
+    }
+    dwFlags |= heap->flags;
+
+    heap_lock(heap, dwFlags);
+    segment = heap_segment_from_block(heap, lpMem);
+    size = segment ? segment->blockSize : (SIZE_T)-1;
+    heap_unlock(heap, dwFlags);
+
+    return size;
+}
+
+BOOL HeapLock (HANDLE hHeap)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    EnterCriticalSection(&heap->lock);
+    return TRUE;
+}
+
+BOOL HeapUnlock (HANDLE hHeap)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    LeaveCriticalSection(&heap->lock);
+    return TRUE;
+}
+
+BOOL HeapSummary (HANDLE hHeap, DWORD dwFlags, LPHEAP_SUMMARY lpSummary)
+{
+    heap_t *heap = heap_from_handle(hHeap);
+
+    if (heap == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    if (lpSummary == NULL || lpSummary->cb != sizeof(HEAP_SUMMARY)) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    dwFlags |= heap->flags;
+
+    heap_lock(heap, dwFlags);
+    lpSummary->cbAllocated = heap->allocatedBytes;
+    lpSummary->cbCommitted = heap->committedBytes;
+    lpSummary->cbReserved = heap->reservedBytes;
+    lpSummary->cbMaxReserve = heap->maximumSize ? heap->maximumSize : heap->reservedBytes;
+    heap_unlock(heap, dwFlags);
+
+    return TRUE;
+}
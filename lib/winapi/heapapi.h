@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef __HEAPAPI_H__
+#define __HEAPAPI_H__
+
+#include <windef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEAP_NO_SERIALIZE          0x00000001
+#define HEAP_GROWABLE              0x00000002
+#define HEAP_GENERATE_EXCEPTIONS   0x00000004
+#define HEAP_ZERO_MEMORY           0x00000008
+#define HEAP_REALLOC_IN_PLACE_ONLY 0x00000010
+
+typedef struct _HEAP_SUMMARY
+{
+    DWORD cb;
+    SIZE_T cbAllocated;
+    SIZE_T cbCommitted;
+    SIZE_T cbReserved;
+    SIZE_T cbMaxReserve;
+} HEAP_SUMMARY, *PHEAP_SUMMARY, *LPHEAP_SUMMARY;
+
+HANDLE HeapCreate (DWORD flOptions, SIZE_T dwInitialSize, SIZE_T dwMaximumSize);
+BOOL HeapDestroy (HANDLE hHeap);
+HANDLE GetProcessHeap (VOID);
+LPVOID HeapAlloc (HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes);
+LPVOID HeapReAlloc (HANDLE hHeap, DWORD dwFlags, LPVOID lpMem, SIZE_T dwBytes);
+BOOL HeapFree (HANDLE hHeap, DWORD dwFlags, LPVOID lpMem);
+SIZE_T HeapSize (HANDLE hHeap, DWORD dwFlags, LPCVOID lpMem);
+BOOL HeapLock (HANDLE hHeap);
+BOOL HeapUnlock (HANDLE hHeap);
+BOOL HeapSummary (HANDLE hHeap, DWORD dwFlags, LPHEAP_SUMMARY lpSummary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 
 // SPDX-FileCopyrightText: 2023 Ryan Wendland
 
+#include <ioapiset.h>
 #include <synchapi.h>
 #include <winbase.h>
 #include <winerror.h>
@@ -24,7 +25,7 @@ BOOL GetOverlappedResult (HANDLE hFile, LPOVERLAPPED lpOverlapped, LPDWORD lpNum
     if (lpOverlapped->hEvent == NULL) {
         waitHandle = hFile;
     } else {
-        waitHandle = lpOverlapped->hEvent;
+        waitHandle = (HANDLE)((ULONG_PTR)lpOverlapped->hEvent & ~1);
     }
 
     if (status == STATUS_PENDING) {
@@ -45,3 +46,141 @@ BOOL GetOverlappedResult (HANDLE hFile, LPOVERLAPPED lpOverlapped, LPDWORD lpNum
     }
     return TRUE;
 }
+
+HANDLE CreateIoCompletionPort (HANDLE FileHandle, HANDLE ExistingCompletionPort, ULONG_PTR CompletionKey, DWORD NumberOfConcurrentThreads)
+{
+    NTSTATUS status;
+    HANDLE port = ExistingCompletionPort;
+
+    if (FileHandle == INVALID_HANDLE_VALUE && ExistingCompletionPort != NULL) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    if (port == NULL) {
+        status = NtCreateIoCompletion(&port, GENERIC_ALL, NULL, NumberOfConcurrentThreads);
+        if (!NT_SUCCESS(status)) {
+            SetLastError(RtlNtStatusToDosError(status));
+            return NULL;
+        }
+    }
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        IO_STATUS_BLOCK ioStatusBlock;
+        FILE_COMPLETION_INFORMATION completionInfo;
+        completionInfo.Port = port;
+        completionInfo.Key = (PVOID)CompletionKey;
+
+        status = NtSetInformationFile(FileHandle, &ioStatusBlock, &completionInfo, sizeof(completionInfo), FileCompletionInformation);
+        if (!NT_SUCCESS(status)) {
+            if (ExistingCompletionPort == NULL) {
+                NtClose(port);
+            }
+            SetLastError(RtlNtStatusToDosError(status));
+            return NULL;
+        }
+    }
+
+    return port;
+}
+
+BOOL GetQueuedCompletionStatus (HANDLE CompletionPort, LPDWORD lpNumberOfBytesTransferred, PULONG_PTR lpCompletionKey, LPOVERLAPPED *lpOverlapped, DWORD dwMilliseconds)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK ioStatusBlock;
+    PVOID keyContext;
+    PVOID apcContext;
+    LARGE_INTEGER timeout;
+    LARGE_INTEGER *timeoutPtr = NULL;
+
+    if (dwMilliseconds != INFINITE) {
+        timeout.QuadPart = ((LONGLONG)dwMilliseconds) * -10000;
+        timeoutPtr = &timeout;
+    }
+
+    status = NtRemoveIoCompletion(CompletionPort, &keyContext, &apcContext, &ioStatusBlock, timeoutPtr);
+    if (status == STATUS_TIMEOUT) {
+        *lpOverlapped = NULL;
+        SetLastError(WAIT_TIMEOUT);
+        return FALSE;
+    }
+    if (!NT_SUCCESS(status)) {
+        *lpOverlapped = NULL;
+        SetLastError(RtlNtStatusToDosError(status));
+        return FALSE;
+    }
+
+    *lpCompletionKey = (ULONG_PTR)keyContext;
+    *lpOverlapped = apcContext;
+    *lpNumberOfBytesTransferred = (DWORD)ioStatusBlock.Information;
+
+    // A packet for a failed request was dequeued
+    if (!NT_SUCCESS(ioStatusBlock.Status)) {
+        SetLastError(RtlNtStatusToDosError(ioStatusBlock.Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL GetQueuedCompletionStatusEx (HANDLE CompletionPort, LPOVERLAPPED_ENTRY lpCompletionPortEntries, ULONG ulCount, PULONG ulNumEntriesRemoved, DWORD dwMilliseconds, BOOL fAlertable)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK ioStatusBlock;
+    PVOID keyContext;
+    PVOID apcContext;
+    LARGE_INTEGER timeout;
+    LARGE_INTEGER *timeoutPtr = NULL;
+    ULONG removed = 0;
+
+    // The kernel doesn't offer alertable or batched removal of completion
+    // packets, so fAlertable is ignored and the batch is collected by
+    // draining the port without waiting after the first packet arrived
+    if (dwMilliseconds != INFINITE) {
+        timeout.QuadPart = ((LONGLONG)dwMilliseconds) * -10000;
+        timeoutPtr = &timeout;
+    }
+
+    while (removed < ulCount) {
+        status = NtRemoveIoCompletion(CompletionPort, &keyContext, &apcContext, &ioStatusBlock, timeoutPtr);
+        if (status == STATUS_TIMEOUT) {
+            break;
+        }
+        if (!NT_SUCCESS(status)) {
+            if (removed > 0) {
+                break;
+            }
+            *ulNumEntriesRemoved = 0;
+            SetLastError(RtlNtStatusToDosError(status));
+            return FALSE;
+        }
+
+        lpCompletionPortEntries[removed].lpCompletionKey = (ULONG_PTR)keyContext;
+        lpCompletionPortEntries[removed].lpOverlapped = apcContext;
+        lpCompletionPortEntries[removed].Internal = (ULONG_PTR)ioStatusBlock.Status;
+        lpCompletionPortEntries[removed].dwNumberOfBytesTransferred = (DWORD)ioStatusBlock.Information;
+        removed++;
+
+        timeout.QuadPart = 0;
+        timeoutPtr = &timeout;
+    }
+
+    *ulNumEntriesRemoved = removed;
+    if (removed == 0) {
+        SetLastError(WAIT_TIMEOUT);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL PostQueuedCompletionStatus (HANDLE CompletionPort, DWORD dwNumberOfBytesTransferred, ULONG_PTR dwCompletionKey, LPOVERLAPPED lpOverlapped)
+{
+    NTSTATUS status;
+
+    status = NtSetIoCompletion(CompletionPort, (PVOID)dwCompletionKey, lpOverlapped, STATUS_SUCCESS, dwNumberOfBytesTransferred);
+    if (!NT_SUCCESS(status)) {
+        SetLastError(RtlNtStatusToDosError(status));
+        return FALSE;
+    }
+    return TRUE;
+}
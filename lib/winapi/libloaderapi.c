@@ -4,6 +4,7 @@
 // SPDX-FileCopyrightText: 2021 Stefan Schmidt
 
 #include <libloaderapi.h>
+#include <synchapi.h>
 #include <winbase.h>
 #include <windef.h>
 #include <winerror.h>
@@ -13,6 +14,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Needs the Windows types from above
+#include <libloaderapi_internal_.h>
+
 HMODULE LoadLibraryExA (LPCSTR lpLibFileName, HANDLE hFile, DWORD dwFlags)
 {
     assert(hFile == NULL);
@@ -36,45 +40,47 @@ BOOL FreeLibrary (HMODULE hLibModule)
     return TRUE;
 }
 
-static PIMAGE_EXPORT_DIRECTORY find_edataxb (void)
+static PIMAGE_EXPORT_DIRECTORY edataxb;
+static INIT_ONCE edataxb_init_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL WINAPI find_edataxb (PINIT_ONCE InitOnce, PVOID Parameter, PVOID *Context)
 {
     DWORD num_sections = CURRENT_XBE_HEADER->NumberOfSections;
     PXBE_SECTION_HEADER section_header_addr = CURRENT_XBE_HEADER->PointerToSectionTable;
 
     for (DWORD i = 0; i < num_sections; i++) {
         if (memcmp(section_header_addr[i].SectionName, ".edataxb", 8) == 0) {
-            return (PIMAGE_EXPORT_DIRECTORY)section_header_addr[i].VirtualAddress;
+            edataxb = (PIMAGE_EXPORT_DIRECTORY)section_header_addr[i].VirtualAddress;
+            break;
         }
     }
 
-    return NULL;
+    return TRUE;
 }
 
 FARPROC GetProcAddress (HMODULE hModule, LPCSTR lpProcName)
 {
     if (hModule == NULL) {
         // When no dll handle is given, the symbol gets looked up in the main module
-
-        PIMAGE_EXPORT_DIRECTORY exportdir = find_edataxb();
-        if (!exportdir) {
-            SetLastError(ERROR_PROC_NOT_FOUND);
-            return NULL;
-        }
-
-        for (DWORD i = 0; i < exportdir->NumberOfNames; i++) {
-            const char **nametable = (const char **)(exportdir->AddressOfNames + XBE_DEFAULT_BASE);
-            const char *name_addr = (const char *)(nametable[i] + XBE_DEFAULT_BASE);
-
-            if (strcmp(lpProcName, name_addr) == 0) {
-                // Found a matching name and its index. This index is not valid for the address table, that index needs to be looked up in the ordinal table!
-                WORD *ordtable = (WORD *)(exportdir->AddressOfNameOrdinals + XBE_DEFAULT_BASE);
-                BYTE **proctable = (BYTE **)(exportdir->AddressOfFunctions + XBE_DEFAULT_BASE);
-                return (FARPROC)proctable[ordtable[i]] + XBE_DEFAULT_BASE;
+        FARPROC proc = NULL;
+
+        InitOnceExecuteOnce(&edataxb_init_once, find_edataxb, NULL, NULL);
+        if (edataxb) {
+            // Ordinals are passed in the low word, with the high word being zero
+            if (((ULONG_PTR)lpProcName >> 16) == 0) {
+                DWORD ordinal = (ULONG_PTR)lpProcName;
+                if (ordinal >= edataxb->Base) {
+                    proc = (FARPROC)export_address((const char *)XBE_DEFAULT_BASE, edataxb, ordinal - edataxb->Base);
+                }
+            } else {
+                proc = (FARPROC)find_export_by_name((const char *)XBE_DEFAULT_BASE, edataxb, lpProcName);
             }
         }
 
-        SetLastError(ERROR_PROC_NOT_FOUND);
-        return NULL;
+        if (!proc) {
+            SetLastError(ERROR_PROC_NOT_FOUND);
+        }
+        return proc;
     }
 
     // FIXME: If the module handle is invalid, fail with ERROR_MOD_NOT_FOUND
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef __LIBLOADERAPI_INTERNAL__H__
+#define __LIBLOADERAPI_INTERNAL__H__
+
+// Export table lookups of GetProcAddress. They are also built into the host
+// benchmark in tools/bench, so they only rely on the includer to provide
+// DWORD, WORD and PIMAGE_EXPORT_DIRECTORY, and take the image base that the
+// table's addresses are relative to (XBE_DEFAULT_BASE on the Xbox).
+
+#include <string.h>
+
+static inline const void *export_address (const char *base, PIMAGE_EXPORT_DIRECTORY exportdir, DWORD index)
+{
+    const DWORD *proctable = (const DWORD *)(base + exportdir->AddressOfFunctions);
+
+    // Unused ordinals have no address
+    if (index >= exportdir->NumberOfFunctions || proctable[index] == 0) {
+        return NULL;
+    }
+    return base + proctable[index];
+}
+
+// The linker sorts the name table, so names are looked up with a binary search
+static inline const void *find_export_by_name (const char *base, PIMAGE_EXPORT_DIRECTORY exportdir, const char *lpProcName)
+{
+    const DWORD *nametable = (const DWORD *)(base + exportdir->AddressOfNames);
+    DWORD low = 0;
+    DWORD high = exportdir->NumberOfNames;
+
+    while (low < high) {
+        DWORD mid = low + (high - low) / 2;
+        const char *name_addr = base + nametable[mid];
+        int result = strcmp(lpProcName, name_addr);
+
+        if (result == 0) {
+            // Found a matching name and its index. This index is not valid for the address table, that index needs to be looked up in the ordinal table!
+            const WORD *ordtable = (const WORD *)(base + exportdir->AddressOfNameOrdinals);
+            return export_address(base, exportdir, ordtable[mid]);
+        } else if (result < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+#endif
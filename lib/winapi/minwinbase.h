@@ -13,7 +13,7 @@ typedef struct _FILETIME
 {
     DWORD dwLowDateTime;
     DWORD dwHighDateTime;
-} FILETIME, *LPFILETIME;
+} FILETIME, *PFILETIME, *LPFILETIME;
 
 typedef struct _OVERLAPPED
 {
@@ -24,6 +24,14 @@ typedef struct _OVERLAPPED
     HANDLE hEvent;
 } OVERLAPPED, *LPOVERLAPPED;
 
+typedef struct _OVERLAPPED_ENTRY
+{
+    ULONG_PTR lpCompletionKey;
+    LPOVERLAPPED lpOverlapped;
+    ULONG_PTR Internal;
+    DWORD dwNumberOfBytesTransferred;
+} OVERLAPPED_ENTRY, *LPOVERLAPPED_ENTRY;
+
 typedef struct _SYSTEMTIME
 {
     WORD wYear;
@@ -46,113 +46,262 @@ VOID LeaveCriticalSection (LPCRITICAL_SECTION lpCriticalSection)
     RtlLeaveCriticalSection(lpCriticalSection);
 }
 
-#define SRW_GLOBAL_LOCK_MASK  ((uintptr_t)0x40000000)
-#define SRW_READER_LOCK_MASK  ((uintptr_t)0x80000000)
-#define SRW_READER_COUNT_MASK ~(SRW_GLOBAL_LOCK_MASK | SRW_READER_LOCK_MASK)
+// Threads which have to block on an SRW lock wait on a KEVENT in a wait block
+// on their own stack. The wait blocks are kept in a small hash table keyed by
+// the address of the lock, similar to keyed events on Windows, so the lock
+// itself stays a single pointer-sized word. Condition variables use the same
+// queue.
+// The table is only accessed at DISPATCH_LEVEL, which on the single-core Xbox
+// also serializes these accesses against all other threads.
+typedef struct _WAIT_BLOCK
+{
+    struct _WAIT_BLOCK *next;
+    PVOID key;
+    BOOL exclusive;
+    KEVENT event;
+} WAIT_BLOCK;
+
+#define WAIT_BUCKETS 32
 
-static bool TryAcquireLockMask (uintptr_t *lock, uintptr_t mask)
+typedef struct _WAIT_BUCKET
 {
-    uintptr_t unlocked_val = *lock & ~mask;
-    return __sync_bool_compare_and_swap(lock, unlocked_val, unlocked_val | mask);
+    WAIT_BLOCK *head;
+    WAIT_BLOCK *tail;
+} WAIT_BUCKET;
+
+static WAIT_BUCKET WaitBuckets[WAIT_BUCKETS];
+
+#define WAIT_ANY       0
+#define WAIT_SHARED    1
+#define WAIT_EXCLUSIVE 2
+
+static WAIT_BUCKET *GetWaitBucket (PVOID key)
+{
+    return &WaitBuckets[((ULONG_PTR)key >> 4) % WAIT_BUCKETS];
 }
 
-static void ReleaseLockMask (uintptr_t *lock, uintptr_t mask)
+static VOID WaitQueueInsert (WAIT_BLOCK *block)
 {
-    __sync_fetch_and_and(lock, ~mask);
+    WAIT_BUCKET *bucket = GetWaitBucket(block->key);
+
+    block->next = NULL;
+    if (bucket->tail) {
+        bucket->tail->next = block;
+    } else {
+        bucket->head = block;
+    }
+    bucket->tail = block;
 }
 
-void AcquireSRWLockExclusive (PSRWLOCK SRWLock)
+// Removes the oldest wait block for the key which matches the filter
+static WAIT_BLOCK *WaitQueueRemove (PVOID key, int filter)
 {
-    // Grab the global lock (second-highest bit)
-    while (!TryAcquireLockMask(&SRWLock->Ptr, SRW_GLOBAL_LOCK_MASK)) {
-        SwitchToThread();
+    WAIT_BUCKET *bucket = GetWaitBucket(key);
+    WAIT_BLOCK *prev = NULL;
+
+    for (WAIT_BLOCK *block = bucket->head; block != NULL; prev = block, block = block->next) {
+        if (block->key != key) {
+            continue;
+        }
+        if ((filter == WAIT_SHARED && block->exclusive) || (filter == WAIT_EXCLUSIVE && !block->exclusive)) {
+            continue;
+        }
+
+        if (prev) {
+            prev->next = block->next;
+        } else {
+            bucket->head = block->next;
+        }
+        if (bucket->tail == block) {
+            bucket->tail = prev;
+        }
+        return block;
     }
+
+    return NULL;
 }
 
-void AcquireSRWLockShared (PSRWLOCK SRWLock)
+static BOOL WaitQueueContains (PVOID key)
 {
-    // Grab the reader lock
-    while (!TryAcquireLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK)) {
-        SwitchToThread();
+    for (WAIT_BLOCK *block = GetWaitBucket(key)->head; block != NULL; block = block->next) {
+        if (block->key == key) {
+            return TRUE;
+        }
     }
+    return FALSE;
+}
 
-    // Increase reader count by one
-    uintptr_t prev_val = __atomic_fetch_add(&SRWLock->Ptr, 1, __ATOMIC_ACQ_REL);
-    if ((prev_val & SRW_READER_COUNT_MASK) == 0) {
-        // If we're the first reader, grab the global lock, too
-        AcquireSRWLockExclusive(SRWLock);
+// Removes a specific wait block, returns FALSE if it was already dequeued
+static BOOL WaitQueueUnlink (WAIT_BLOCK *block)
+{
+    WAIT_BUCKET *bucket = GetWaitBucket(block->key);
+    WAIT_BLOCK *prev = NULL;
+
+    for (WAIT_BLOCK *cur = bucket->head; cur != NULL; prev = cur, cur = cur->next) {
+        if (cur != block) {
+            continue;
+        }
+
+        if (prev) {
+            prev->next = cur->next;
+        } else {
+            bucket->head = cur->next;
+        }
+        if (bucket->tail == cur) {
+            bucket->tail = prev;
+        }
+        return TRUE;
     }
 
-    // Release the reader lock
-    ReleaseLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK);
+    return FALSE;
 }
 
-void InitializeSRWLock (PSRWLOCK SRWLock)
+// Must be called at DISPATCH_LEVEL, returns after the IRQL was lowered again
+static VOID WaitBlockSleep (WAIT_BLOCK *block, KIRQL oldIrql)
 {
-    __atomic_store_n(&SRWLock->Ptr, 0, __ATOMIC_RELEASE);
+    KeInitializeEvent(&block->event, SynchronizationEvent, FALSE);
+    WaitQueueInsert(block);
+    KfLowerIrql(oldIrql);
+    KeWaitForSingleObject(&block->event, UserRequest, KernelMode, FALSE, NULL);
 }
 
-void ReleaseSRWLockExclusive (PSRWLOCK SRWLock)
+#define SRW_EXCLUSIVE  ((ULONG_PTR)0x1)
+#define SRW_WAITERS    ((ULONG_PTR)0x2)
+#define SRW_SHARED_ONE ((ULONG_PTR)0x4)
+
+// Hands the (free) lock over to the waiters, preferring writers: Either the
+// oldest waiting writer or, if there is none, all waiting readers get it.
+// Must be called at DISPATCH_LEVEL.
+static VOID SRWLockWakeWaiters (PSRWLOCK SRWLock)
 {
-    // Release the global lock (second-highest bit)
-    ReleaseLockMask(&SRWLock->Ptr, SRW_GLOBAL_LOCK_MASK);
+    ULONG_PTR state = 0;
+    WAIT_BLOCK *block;
+
+    block = WaitQueueRemove(SRWLock, WAIT_EXCLUSIVE);
+    if (block) {
+        state = SRW_EXCLUSIVE;
+        KeSetEvent(&block->event, EVENT_INCREMENT, FALSE);
+    } else {
+        while ((block = WaitQueueRemove(SRWLock, WAIT_SHARED)) != NULL) {
+            state += SRW_SHARED_ONE;
+            KeSetEvent(&block->event, EVENT_INCREMENT, FALSE);
+        }
+    }
+
+    if (WaitQueueContains(SRWLock)) {
+        state |= SRW_WAITERS;
+    }
+    __atomic_store_n(&SRWLock->Ptr, state, __ATOMIC_RELEASE);
 }
 
-void ReleaseSRWLockShared (PSRWLOCK SRWLock)
+static VOID AcquireSRWLockSlow (PSRWLOCK SRWLock, BOOL exclusive)
 {
-    // Grab the reader lock
-    while (!TryAcquireLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK)) {
-        SwitchToThread();
-    }
+    WAIT_BLOCK block;
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    ULONG_PTR state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE);
 
-    // Decrease reader count by one
-    uintptr_t prev_val = __atomic_fetch_sub(&SRWLock->Ptr, 1, __ATOMIC_ACQ_REL);
-    assert((prev_val & SRW_READER_COUNT_MASK) != 0);
-    if ((prev_val & SRW_READER_COUNT_MASK) == 1) {
-        // If we're the last reader, release the global lock
-        ReleaseSRWLockExclusive(SRWLock);
+    if (exclusive && (state & ~SRW_WAITERS) == 0) {
+        __atomic_store_n(&SRWLock->Ptr, state | SRW_EXCLUSIVE, __ATOMIC_RELEASE);
+        KfLowerIrql(oldIrql);
+        return;
     }
+    // New readers queue up behind waiting writers
+    if (!exclusive && (state & (SRW_EXCLUSIVE | SRW_WAITERS)) == 0) {
+        __atomic_store_n(&SRWLock->Ptr, state + SRW_SHARED_ONE, __ATOMIC_RELEASE);
+        KfLowerIrql(oldIrql);
+        return;
+    }
+
+    __atomic_store_n(&SRWLock->Ptr, state | SRW_WAITERS, __ATOMIC_RELEASE);
+    block.key = SRWLock;
+    block.exclusive = exclusive;
+    WaitBlockSleep(&block, oldIrql);
 
-    // Release the reader lock
-    ReleaseLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK);
+    // The lock was handed over to us by the releasing thread
 }
 
-BOOLEAN TryAcquireSRWLockExclusive (PSRWLOCK SRWLock)
+void AcquireSRWLockExclusive (PSRWLOCK SRWLock)
 {
-    // Try once to grab the global lock, return whether we succeeded
-    return TryAcquireLockMask(&SRWLock->Ptr, SRW_GLOBAL_LOCK_MASK);
+    if (__sync_bool_compare_and_swap(&SRWLock->Ptr, 0, SRW_EXCLUSIVE)) {
+        return;
+    }
+    AcquireSRWLockSlow(SRWLock, TRUE);
 }
 
-BOOLEAN TryAcquireSRWLockShared (PSRWLOCK SRWLock)
+void AcquireSRWLockShared (PSRWLOCK SRWLock)
 {
-    bool success;
+    ULONG_PTR state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE);
+
+    while ((state & (SRW_EXCLUSIVE | SRW_WAITERS)) == 0) {
+        if (__atomic_compare_exchange_n(&SRWLock->Ptr, &state, state + SRW_SHARED_ONE, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+    AcquireSRWLockSlow(SRWLock, FALSE);
+}
+
+void InitializeSRWLock (PSRWLOCK SRWLock)
+{
+    __atomic_store_n(&SRWLock->Ptr, 0, __ATOMIC_RELEASE);
+}
 
-    // Grab the reader lock
-    while (!TryAcquireLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK)) {
-        SwitchToThread();
+void ReleaseSRWLockExclusive (PSRWLOCK SRWLock)
+{
+    if (__sync_bool_compare_and_swap(&SRWLock->Ptr, SRW_EXCLUSIVE, 0)) {
+        return;
     }
 
-    // Increase reader count by one
-    uintptr_t prev_val = __atomic_fetch_add(&SRWLock->Ptr, 1, __ATOMIC_ACQ_REL);
-    if ((prev_val & SRW_READER_COUNT_MASK) == 0) {
-        // If we're the first reader, try grab the global lock
-        success = TryAcquireSRWLockExclusive(SRWLock);
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    ULONG_PTR state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE);
+    assert(state & SRW_EXCLUSIVE);
+    if (state & SRW_WAITERS) {
+        SRWLockWakeWaiters(SRWLock);
     } else {
-        success = TRUE;
+        __atomic_store_n(&SRWLock->Ptr, state & ~SRW_EXCLUSIVE, __ATOMIC_RELEASE);
     }
+    KfLowerIrql(oldIrql);
+}
 
-    if (!success) {
-        // If we didn't succeed, we decrement the reader count again
-        __atomic_fetch_sub(&SRWLock->Ptr, 1, __ATOMIC_ACQ_REL);
+void ReleaseSRWLockShared (PSRWLOCK SRWLock)
+{
+    ULONG_PTR state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE);
+
+    while ((state & SRW_WAITERS) == 0) {
+        assert(state >= SRW_SHARED_ONE);
+        if (__atomic_compare_exchange_n(&SRWLock->Ptr, &state, state - SRW_SHARED_ONE, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
     }
 
-    // Release the reader lock
-    ReleaseLockMask(&SRWLock->Ptr, SRW_READER_LOCK_MASK);
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE) - SRW_SHARED_ONE;
+    if (state == SRW_WAITERS) {
+        // We were the last reader and somebody is waiting
+        SRWLockWakeWaiters(SRWLock);
+    } else {
+        __atomic_store_n(&SRWLock->Ptr, state, __ATOMIC_RELEASE);
+    }
+    KfLowerIrql(oldIrql);
+}
 
-    return success;
+BOOLEAN TryAcquireSRWLockExclusive (PSRWLOCK SRWLock)
+{
+    return __sync_bool_compare_and_swap(&SRWLock->Ptr, 0, SRW_EXCLUSIVE);
+}
+
+BOOLEAN TryAcquireSRWLockShared (PSRWLOCK SRWLock)
+{
+    ULONG_PTR state = __atomic_load_n(&SRWLock->Ptr, __ATOMIC_ACQUIRE);
+
+    while ((state & (SRW_EXCLUSIVE | SRW_WAITERS)) == 0) {
+        if (__atomic_compare_exchange_n(&SRWLock->Ptr, &state, state + SRW_SHARED_ONE, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
-#define INITONCE_MASK              (((uintptr_t)1 << INIT_ONCE_CTX_RESERVED_BITS) - 1)
+#define INITONCE_MASK              (((ULONG_PTR)1 << INIT_ONCE_CTX_RESERVED_BITS) - 1)
 #define INITONCE_UNINITIALIZED     0
 #define INITONCE_IN_PROGRESS       1
 #define INITONCE_ASYNC_IN_PROGRESS 2
@@ -284,148 +433,122 @@ BOOL InitOnceComplete (LPINIT_ONCE lpInitOnce, DWORD dwFlags, LPVOID lpContext)
     }
 }
 
-static BOOL WINAPI condvar_init (PINIT_ONCE InitOnce, PVOID Parameter, PVOID *Context)
-{
-    PCONDITION_VARIABLE ConditionVariable = Parameter;
-    NTSTATUS status;
-    assert(ConditionVariable->waitCount == 0);
-    assert(ConditionVariable->eventHandles[0] == INVALID_HANDLE_VALUE);
-    assert(ConditionVariable->eventHandles[1] == INVALID_HANDLE_VALUE);
-    status = NtCreateEvent(&ConditionVariable->eventHandles[0], NULL, SynchronizationEvent, FALSE);
-    assert(NT_SUCCESS(status));
-    status = NtCreateEvent(&ConditionVariable->eventHandles[1], NULL, NotificationEvent, FALSE);
-    assert(NT_SUCCESS(status));
-    return true;
-}
-
-VOID InitializeConditionVariable (PCONDITION_VARIABLE ConditionVariable)
+// Condition variables share the wait queue with SRW locks, keyed by the
+// address of the condition variable. Ptr counts the queued waiters, so waking
+// a condition variable nobody waits on doesn't need to raise the IRQL.
+static VOID ConditionVariableEnqueue (PCONDITION_VARIABLE ConditionVariable, WAIT_BLOCK *block)
 {
-    ConditionVariable->initOnce.Ptr = 0;
-    __atomic_store_n(&ConditionVariable->waitCount, 0, __ATOMIC_RELEASE);
-    ConditionVariable->eventHandles[0] = INVALID_HANDLE_VALUE;
-    ConditionVariable->eventHandles[1] = INVALID_HANDLE_VALUE;
-
-    BOOL success = InitOnceExecuteOnce(&ConditionVariable->initOnce, condvar_init, ConditionVariable, NULL);
-    assert(success);
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    block->key = ConditionVariable;
+    block->exclusive = FALSE;
+    KeInitializeEvent(&block->event, SynchronizationEvent, FALSE);
+    WaitQueueInsert(block);
+    __atomic_store_n(&ConditionVariable->Ptr, ConditionVariable->Ptr + 1, __ATOMIC_RELEASE);
+    KfLowerIrql(oldIrql);
 }
 
-BOOL SleepConditionVariableCS (PCONDITION_VARIABLE ConditionVariable, PCRITICAL_SECTION CriticalSection, DWORD dwMilliseconds)
+static BOOL ConditionVariableWait (PCONDITION_VARIABLE ConditionVariable, WAIT_BLOCK *block, DWORD dwMilliseconds)
 {
-    BOOL success = InitOnceExecuteOnce(&ConditionVariable->initOnce, condvar_init, ConditionVariable, NULL);
-    assert(success);
-
-    NTSTATUS status;
     LARGE_INTEGER waitTime;
     LARGE_INTEGER *waitTimePtr = NULL;
 
     if (dwMilliseconds != INFINITE) {
-        waitTime.QuadPart = dwMilliseconds * 1000;
+        waitTime.QuadPart = ((LONGLONG)dwMilliseconds) * -10000;
         waitTimePtr = &waitTime;
     }
 
-    LeaveCriticalSection(CriticalSection);
-    __atomic_add_fetch(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-    status = NtWaitForMultipleObjectsEx(2, ConditionVariable->eventHandles, WaitAny, UserMode, FALSE, waitTimePtr);
-    if (status == WAIT_FAILED || status == STATUS_TIMEOUT) {
-        __atomic_sub_fetch(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-        EnterCriticalSection(CriticalSection);
-        return FALSE;
+    NTSTATUS status = KeWaitForSingleObject(&block->event, UserRequest, KernelMode, FALSE, waitTimePtr);
+    if (status != STATUS_TIMEOUT) {
+        return TRUE;
     }
 
-    int oldCount = __atomic_fetch_sub(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-    if (oldCount == 1) {
-        // Last waiter needs to manually reset the broadcast-object
-        status = NtClearEvent(ConditionVariable->eventHandles[1]);
-        if (!NT_SUCCESS(status)) {
-            EnterCriticalSection(CriticalSection);
-            return FALSE;
-        }
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    if (!WaitQueueUnlink(block)) {
+        // A wakeup raced with the timeout, it has been consumed by this thread
+        KfLowerIrql(oldIrql);
+        return TRUE;
     }
+    __atomic_store_n(&ConditionVariable->Ptr, ConditionVariable->Ptr - 1, __ATOMIC_RELEASE);
+    KfLowerIrql(oldIrql);
 
-    EnterCriticalSection(CriticalSection);
-    return TRUE;
+    SetLastError(ERROR_TIMEOUT);
+    return FALSE;
 }
 
-BOOL SleepConditionVariableSRW (PCONDITION_VARIABLE ConditionVariable, PSRWLOCK SRWLock, DWORD dwMilliseconds, ULONG Flags)
+VOID InitializeConditionVariable (PCONDITION_VARIABLE ConditionVariable)
 {
-    BOOL success = InitOnceExecuteOnce(&ConditionVariable->initOnce, condvar_init, ConditionVariable, NULL);
-    assert(success);
+    __atomic_store_n(&ConditionVariable->Ptr, 0, __ATOMIC_RELEASE);
+}
 
-    NTSTATUS status;
-    LARGE_INTEGER waitTime;
-    LARGE_INTEGER *waitTimePtr = NULL;
+BOOL SleepConditionVariableCS (PCONDITION_VARIABLE ConditionVariable, PCRITICAL_SECTION CriticalSection, DWORD dwMilliseconds)
+{
+    WAIT_BLOCK block;
+    BOOL success;
 
-    if (dwMilliseconds != INFINITE) {
-        waitTime.QuadPart = dwMilliseconds * 1000;
-        waitTimePtr = &waitTime;
-    }
+    // Queue up before releasing the lock, so a wakeup can't get lost
+    ConditionVariableEnqueue(ConditionVariable, &block);
+    LeaveCriticalSection(CriticalSection);
+    success = ConditionVariableWait(ConditionVariable, &block, dwMilliseconds);
+    EnterCriticalSection(CriticalSection);
+    return success;
+}
 
+BOOL SleepConditionVariableSRW (PCONDITION_VARIABLE ConditionVariable, PSRWLOCK SRWLock, DWORD dwMilliseconds, ULONG Flags)
+{
+    WAIT_BLOCK block;
+    BOOL success;
+
+    ConditionVariableEnqueue(ConditionVariable, &block);
     if (Flags == CONDITION_VARIABLE_LOCKMODE_SHARED) {
         ReleaseSRWLockShared(SRWLock);
     } else {
         ReleaseSRWLockExclusive(SRWLock);
     }
-    __atomic_add_fetch(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-    status = NtWaitForMultipleObjectsEx(2, ConditionVariable->eventHandles, WaitAny, UserMode, FALSE, waitTimePtr);
-    if (status == WAIT_FAILED || status == STATUS_TIMEOUT) {
-        __atomic_sub_fetch(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-        if (Flags == CONDITION_VARIABLE_LOCKMODE_SHARED) {
-            AcquireSRWLockShared(SRWLock);
-        } else {
-            AcquireSRWLockExclusive(SRWLock);
-        }
-        return FALSE;
-    }
 
-    int oldCount = __atomic_fetch_sub(&ConditionVariable->waitCount, 1, __ATOMIC_ACQ_REL);
-    if (oldCount == 1) {
-        // Last waiter needs to manually reset the broadcast-object
-        status = NtClearEvent(ConditionVariable->eventHandles[1]);
-        if (!NT_SUCCESS(status)) {
-            if (Flags == CONDITION_VARIABLE_LOCKMODE_SHARED) {
-                AcquireSRWLockShared(SRWLock);
-            } else {
-                AcquireSRWLockExclusive(SRWLock);
-            }
-            return FALSE;
-        }
-    }
+    success = ConditionVariableWait(ConditionVariable, &block, dwMilliseconds);
 
     if (Flags == CONDITION_VARIABLE_LOCKMODE_SHARED) {
         AcquireSRWLockShared(SRWLock);
     } else {
         AcquireSRWLockExclusive(SRWLock);
     }
-    return TRUE;
+    return success;
 }
 
 VOID WakeConditionVariable (PCONDITION_VARIABLE ConditionVariable)
 {
-    BOOL success = InitOnceExecuteOnce(&ConditionVariable->initOnce, condvar_init, ConditionVariable, NULL);
-    assert(success);
+    if (__atomic_load_n(&ConditionVariable->Ptr, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
 
-    NTSTATUS status;
-    status = NtSetEvent(ConditionVariable->eventHandles[0], NULL);
-    assert(NT_SUCCESS(status));
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    WAIT_BLOCK *block = WaitQueueRemove(ConditionVariable, WAIT_ANY);
+    if (block) {
+        __atomic_store_n(&ConditionVariable->Ptr, ConditionVariable->Ptr - 1, __ATOMIC_RELEASE);
+        KeSetEvent(&block->event, EVENT_INCREMENT, FALSE);
+    }
+    KfLowerIrql(oldIrql);
 }
 
 VOID WakeAllConditionVariable (PCONDITION_VARIABLE ConditionVariable)
 {
-    BOOL success = InitOnceExecuteOnce(&ConditionVariable->initOnce, condvar_init, ConditionVariable, NULL);
-    assert(success);
+    if (__atomic_load_n(&ConditionVariable->Ptr, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
 
-    NTSTATUS status;
-    status = NtSetEvent(ConditionVariable->eventHandles[1], NULL);
-    assert(NT_SUCCESS(status));
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    WAIT_BLOCK *block;
+    while ((block = WaitQueueRemove(ConditionVariable, WAIT_ANY)) != NULL) {
+        KeSetEvent(&block->event, EVENT_INCREMENT, FALSE);
+    }
+    __atomic_store_n(&ConditionVariable->Ptr, 0, __ATOMIC_RELEASE);
+    KfLowerIrql(oldIrql);
 }
 
 VOID UninitializeConditionVariable (PCONDITION_VARIABLE ConditionVariable)
 {
-    ConditionVariable->initOnce.Ptr = (PVOID)INITONCE_DONE;
-    NtClose(ConditionVariable->eventHandles[0]);
-    NtClose(ConditionVariable->eventHandles[1]);
-    ConditionVariable->eventHandles[0] = INVALID_HANDLE_VALUE;
-    ConditionVariable->eventHandles[1] = INVALID_HANDLE_VALUE;
+    // Nothing to free, but there must not be any waiters left
+    assert(ConditionVariable->Ptr == 0);
 }
 
 VOID Sleep (DWORD dwMilliseconds)
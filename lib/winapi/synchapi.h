@@ -31,7 +31,8 @@ BOOL SleepConditionVariableCS (PCONDITION_VARIABLE ConditionVariable, PCRITICAL_
 BOOL SleepConditionVariableSRW (PCONDITION_VARIABLE ConditionVariable, PSRWLOCK SRWLock, DWORD dwMilliseconds, ULONG Flags);
 VOID WakeConditionVariable (PCONDITION_VARIABLE ConditionVariable);
 VOID WakeAllConditionVariable (PCONDITION_VARIABLE ConditionVariable);
-// UninitializeConditionVariable is an nxdk extension to free associated system resources
+// UninitializeConditionVariable is an nxdk extension. Condition variables don't hold any
+// system resources, it only exists for compatibility.
 VOID UninitializeConditionVariable (PCONDITION_VARIABLE ConditionVariable);
 
 void AcquireSRWLockExclusive (PSRWLOCK SRWLock);
@@ -0,0 +1,629 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include <assert.h>
+#include <processthreadsapi.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <synchapi.h>
+#include <threadpoolapi.h>
+#include <winbase.h>
+#include <winerror.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+// The pool is built around a kernel queue with a concurrency limit of one:
+// The kernel only lets a second worker pick up callbacks while the active one
+// is blocked (e.g. on I/O), so compute-bound callbacks never compete for the
+// single CPU, but blocking callbacks still overlap with others. Each worker
+// keeps one spare thread around for that purpose, up to TP_MAX_THREADS.
+#define TP_MAX_THREADS 8
+// Pool threads get smaller stacks than the default of the XBE
+#define TP_STACK_SIZE (64 * 1024)
+// Spare workers exit after being idle for this long, one always stays around
+#define TP_IDLE_TIMEOUT_MS 10000
+// The kernel can wait for up to 64 objects at once, one of these is used to
+// notify the wait thread about changes. Additional waits are delayed until
+// a slot becomes available.
+#define TP_MAX_WAITS 63
+
+typedef enum tp_object_type_
+{
+    TP_OBJECT_SIMPLE,
+    TP_OBJECT_WORK,
+    TP_OBJECT_TIMER,
+    TP_OBJECT_WAIT,
+} tp_object_type;
+
+// Common representation of work, timer and wait objects. All members below
+// pendingCount are protected by raising the IRQL to DISPATCH_LEVEL, which
+// allows the timer DPCs to submit callbacks directly.
+typedef struct tp_object_t_
+{
+    LIST_ENTRY queueEntry;
+    tp_object_type type;
+    TP_CALLBACK_PRIORITY priority;
+    PVOID callback;
+    PVOID context;
+
+    ULONG pendingCount;
+    ULONG runningCount;
+    // Prevents freeing while the wait thread uses the object
+    ULONG references;
+    BOOL queued;
+    BOOL closed;
+    // Signaled while there are no pending or running callbacks
+    KEVENT idleEvent;
+
+    union
+    {
+        struct
+        {
+            KTIMER timer;
+            KDPC dpc;
+            BOOL set;
+            BOOL periodic;
+        } timer;
+        struct
+        {
+            LIST_ENTRY listEntry;
+            HANDLE handle;
+            LONGLONG deadline;
+            BOOL registered;
+            TP_WAIT_RESULT result;
+        } wait;
+    };
+} tp_object_t;
+
+struct _TP_CALLBACK_INSTANCE
+{
+    HANDLE eventOnReturn;
+};
+
+static INIT_ONCE tp_init_once = INIT_ONCE_STATIC_INIT;
+static INIT_ONCE tp_wait_init_once = INIT_ONCE_STATIC_INIT;
+static KQUEUE tp_queue;
+static LONG tp_thread_count;
+static LONG tp_idle_count;
+static LIST_ENTRY tp_wait_list;
+static HANDLE tp_wait_event;
+
+static const LONG tp_priority_increment[TP_CALLBACK_PRIORITY_COUNT] = {
+    [TP_CALLBACK_PRIORITY_HIGH] = 1,
+    [TP_CALLBACK_PRIORITY_NORMAL] = 0,
+    [TP_CALLBACK_PRIORITY_LOW] = -1,
+};
+
+static DWORD WINAPI tp_worker (LPVOID lpParameter);
+
+// The caller must have accounted for the new thread in tp_thread_count
+static BOOL tp_create_worker (VOID)
+{
+    HANDLE thread = CreateThread(NULL, TP_STACK_SIZE, tp_worker, NULL, 0, NULL);
+    if (thread == NULL) {
+        InterlockedDecrement(&tp_thread_count);
+        return FALSE;
+    }
+
+    NtClose(thread);
+    return TRUE;
+}
+
+// Makes sure there's a worker which can take over when the current one blocks
+static BOOL tp_ensure_spare_worker (VOID)
+{
+    if (tp_idle_count > 0) {
+        return TRUE;
+    }
+
+    while (true) {
+        LONG count = tp_thread_count;
+        if (count >= TP_MAX_THREADS) {
+            return FALSE;
+        }
+        if (InterlockedCompareExchange(&tp_thread_count, count + 1, count) == count) {
+            break;
+        }
+    }
+
+    return tp_create_worker();
+}
+
+static BOOL WINAPI tp_init (PINIT_ONCE InitOnce, PVOID Parameter, PVOID *Context)
+{
+    KeInitializeQueue(&tp_queue, 1);
+    InitializeListHead(&tp_wait_list);
+
+    // Start with a single worker, more are added on demand
+    tp_thread_count = 1;
+    return tp_create_worker();
+}
+
+// Must be called at DISPATCH_LEVEL
+static VOID tp_submit_locked (tp_object_t *object)
+{
+    object->pendingCount++;
+    KeResetEvent(&object->idleEvent);
+
+    if (!object->queued) {
+        object->queued = TRUE;
+        if (object->priority == TP_CALLBACK_PRIORITY_HIGH) {
+            KeInsertHeadQueue(&tp_queue, &object->queueEntry);
+        } else {
+            KeInsertQueue(&tp_queue, &object->queueEntry);
+        }
+    }
+}
+
+// Must be called at DISPATCH_LEVEL, returns whether the object can be freed
+static bool tp_object_unused (tp_object_t *object)
+{
+    if (!object->closed || object->queued || object->references > 0) {
+        return false;
+    }
+    if (object->pendingCount > 0 || object->runningCount > 0) {
+        return false;
+    }
+    if (object->type == TP_OBJECT_TIMER && object->timer.set) {
+        return false;
+    }
+    if (object->type == TP_OBJECT_WAIT && object->wait.registered) {
+        return false;
+    }
+    return true;
+}
+
+// Must be called at DISPATCH_LEVEL
+static VOID tp_object_idle_check (tp_object_t *object)
+{
+    if (object->pendingCount == 0 && object->runningCount == 0) {
+        KeSetEvent(&object->idleEvent, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+static VOID tp_run_callback (tp_object_t *object, PTP_CALLBACK_INSTANCE instance, TP_WAIT_RESULT waitResult)
+{
+    switch (object->type) {
+        case TP_OBJECT_SIMPLE:
+            ((PTP_SIMPLE_CALLBACK)object->callback)(instance, object->context);
+            break;
+        case TP_OBJECT_WORK:
+            ((PTP_WORK_CALLBACK)object->callback)(instance, object->context, (PTP_WORK)object);
+            break;
+        case TP_OBJECT_TIMER:
+            ((PTP_TIMER_CALLBACK)object->callback)(instance, object->context, (PTP_TIMER)object);
+            break;
+        case TP_OBJECT_WAIT:
+            ((PTP_WAIT_CALLBACK)object->callback)(instance, object->context, (PTP_WAIT)object, waitResult);
+            break;
+    }
+}
+
+static DWORD WINAPI tp_worker (LPVOID lpParameter)
+{
+    TP_CALLBACK_PRIORITY currentPriority = TP_CALLBACK_PRIORITY_NORMAL;
+    LARGE_INTEGER idleTimeout;
+    idleTimeout.QuadPart = -10000LL * TP_IDLE_TIMEOUT_MS;
+
+    while (true) {
+        InterlockedIncrement(&tp_idle_count);
+        PLIST_ENTRY entry = KeRemoveQueue(&tp_queue, UserMode, &idleTimeout);
+        InterlockedDecrement(&tp_idle_count);
+
+        if ((ULONG_PTR)entry == STATUS_TIMEOUT) {
+            LONG count = tp_thread_count;
+            // The last worker stays, callbacks submitted from DPCs rely on it
+            if (count > 1 && InterlockedCompareExchange(&tp_thread_count, count - 1, count) == count) {
+                return 0;
+            }
+            continue;
+        }
+
+        tp_object_t *object = CONTAINING_RECORD(entry, tp_object_t, queueEntry);
+        TP_WAIT_RESULT waitResult = 0;
+        bool release;
+
+        KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+        object->queued = FALSE;
+        if (object->pendingCount == 0) {
+            // All pending callbacks were cancelled while the object was queued
+            release = tp_object_unused(object);
+            KfLowerIrql(oldIrql);
+            if (release) {
+                ExFreePool(object);
+            }
+            continue;
+        }
+
+        object->pendingCount--;
+        object->runningCount++;
+        if (object->pendingCount > 0) {
+            // Let other workers pick up the remaining callbacks
+            object->queued = TRUE;
+            KeInsertQueue(&tp_queue, &object->queueEntry);
+        }
+        if (object->type == TP_OBJECT_WAIT) {
+            waitResult = object->wait.result;
+        }
+        KfLowerIrql(oldIrql);
+
+        tp_ensure_spare_worker();
+
+        if (object->priority != currentPriority) {
+            KeSetBasePriorityThread(KeGetCurrentThread(), tp_priority_increment[object->priority]);
+            currentPriority = object->priority;
+        }
+
+        TP_CALLBACK_INSTANCE instance = {NULL};
+        tp_run_callback(object, &instance, waitResult);
+        if (instance.eventOnReturn != NULL) {
+            NtSetEvent(instance.eventOnReturn, NULL);
+        }
+
+        oldIrql = KeRaiseIrqlToDpcLevel();
+        object->runningCount--;
+        tp_object_idle_check(object);
+        release = tp_object_unused(object);
+        KfLowerIrql(oldIrql);
+
+        if (release) {
+            ExFreePool(object);
+        }
+    }
+}
+
+static tp_object_t *tp_object_create (tp_object_type type, PVOID callback, PVOID context, PTP_CALLBACK_ENVIRON pcbe)
+{
+    if (!InitOnceExecuteOnce(&tp_init_once, tp_init, NULL, NULL)) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    TP_CALLBACK_PRIORITY priority = pcbe ? pcbe->CallbackPriority : TP_CALLBACK_PRIORITY_NORMAL;
+    if (priority >= TP_CALLBACK_PRIORITY_COUNT) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    tp_object_t *object = ExAllocatePoolWithTag(sizeof(tp_object_t), 'loPT');
+    if (object == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    RtlZeroMemory(object, sizeof(tp_object_t));
+    object->type = type;
+    object->priority = priority;
+    object->callback = callback;
+    object->context = context;
+    KeInitializeEvent(&object->idleEvent, NotificationEvent, TRUE);
+
+    return object;
+}
+
+static VOID tp_object_wait (tp_object_t *object, BOOL fCancelPendingCallbacks)
+{
+    if (fCancelPendingCallbacks) {
+        KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+        // A queued object stays queued, the worker dequeuing it will skip it
+        object->pendingCount = 0;
+        tp_object_idle_check(object);
+        KfLowerIrql(oldIrql);
+    }
+
+    KeWaitForSingleObject(&object->idleEvent, UserRequest, KernelMode, FALSE, NULL);
+}
+
+static VOID tp_object_close (tp_object_t *object)
+{
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    object->closed = TRUE;
+    bool release = tp_object_unused(object);
+    KfLowerIrql(oldIrql);
+
+    // Otherwise, the object gets freed once its last callback returned
+    if (release) {
+        ExFreePool(object);
+    }
+}
+
+BOOL TrySubmitThreadpoolCallback (PTP_SIMPLE_CALLBACK pfns, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+    tp_object_t *object = tp_object_create(TP_OBJECT_SIMPLE, pfns, pv, pcbe);
+    if (object == NULL) {
+        return FALSE;
+    }
+
+    // The object is freed automatically after the callback ran
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    object->closed = TRUE;
+    tp_submit_locked(object);
+    KfLowerIrql(oldIrql);
+
+    return TRUE;
+}
+
+PTP_WORK CreateThreadpoolWork (PTP_WORK_CALLBACK pfnwk, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+    return (PTP_WORK)tp_object_create(TP_OBJECT_WORK, pfnwk, pv, pcbe);
+}
+
+VOID SubmitThreadpoolWork (PTP_WORK pwk)
+{
+    tp_object_t *object = (tp_object_t *)pwk;
+
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    tp_submit_locked(object);
+    KfLowerIrql(oldIrql);
+}
+
+VOID WaitForThreadpoolWorkCallbacks (PTP_WORK pwk, BOOL fCancelPendingCallbacks)
+{
+    tp_object_wait((tp_object_t *)pwk, fCancelPendingCallbacks);
+}
+
+VOID CloseThreadpoolWork (PTP_WORK pwk)
+{
+    tp_object_close((tp_object_t *)pwk);
+}
+
+static VOID NTAPI tp_timer_dpc (PKDPC Dpc, PVOID DeferredContext, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+    tp_object_t *object = DeferredContext;
+
+    // DPCs already run at DISPATCH_LEVEL
+    if (!object->timer.periodic) {
+        object->timer.set = FALSE;
+    }
+    tp_submit_locked(object);
+}
+
+PTP_TIMER CreateThreadpoolTimer (PTP_TIMER_CALLBACK pfnti, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+    tp_object_t *object = tp_object_create(TP_OBJECT_TIMER, pfnti, pv, pcbe);
+    if (object == NULL) {
+        return NULL;
+    }
+
+    KeInitializeTimerEx(&object->timer.timer, NotificationTimer);
+    KeInitializeDpc(&object->timer.dpc, tp_timer_dpc, object);
+
+    return (PTP_TIMER)object;
+}
+
+VOID SetThreadpoolTimer (PTP_TIMER pti, PFILETIME pftDueTime, DWORD msPeriod, DWORD msWindowLength)
+{
+    tp_object_t *object = (tp_object_t *)pti;
+    // msWindowLength is ignored, timers always expire as exactly as possible
+
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    KeCancelTimer(&object->timer.timer);
+    KeRemoveQueueDpc(&object->timer.dpc);
+
+    if (pftDueTime == NULL) {
+        object->timer.set = FALSE;
+    } else {
+        // Negative values are relative, positive ones absolute - the kernel
+        // uses the same convention
+        LARGE_INTEGER dueTime;
+        dueTime.LowPart = pftDueTime->dwLowDateTime;
+        dueTime.HighPart = pftDueTime->dwHighDateTime;
+
+        object->timer.set = TRUE;
+        object->timer.periodic = msPeriod != 0;
+        KeSetTimerEx(&object->timer.timer, dueTime, msPeriod, &object->timer.dpc);
+    }
+    KfLowerIrql(oldIrql);
+}
+
+BOOL IsThreadpoolTimerSet (PTP_TIMER pti)
+{
+    return ((tp_object_t *)pti)->timer.set;
+}
+
+VOID WaitForThreadpoolTimerCallbacks (PTP_TIMER pti, BOOL fCancelPendingCallbacks)
+{
+    tp_object_wait((tp_object_t *)pti, fCancelPendingCallbacks);
+}
+
+VOID CloseThreadpoolTimer (PTP_TIMER pti)
+{
+    SetThreadpoolTimer(pti, NULL, 0, 0);
+    tp_object_close((tp_object_t *)pti);
+}
+
+// Must be called at DISPATCH_LEVEL
+static VOID tp_wait_unregister_locked (tp_object_t *object)
+{
+    if (object->wait.registered) {
+        RemoveEntryList(&object->wait.listEntry);
+        object->wait.registered = FALSE;
+    }
+}
+
+static DWORD WINAPI tp_wait_thread (LPVOID lpParameter)
+{
+    HANDLE handles[TP_MAX_WAITS + 1];
+    tp_object_t *objects[TP_MAX_WAITS];
+
+    while (true) {
+        LARGE_INTEGER now;
+        LARGE_INTEGER timeout;
+        PLARGE_INTEGER timeoutPtr = NULL;
+        ULONG count = 0;
+
+        KeQuerySystemTime(&now);
+
+        // Collect the waits, dispatch those that already timed out
+        KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+        PLIST_ENTRY entry = tp_wait_list.Flink;
+        while (entry != &tp_wait_list) {
+            tp_object_t *object = CONTAINING_RECORD(entry, tp_object_t, wait.listEntry);
+            entry = entry->Flink;
+
+            if (object->wait.deadline <= now.QuadPart) {
+                tp_wait_unregister_locked(object);
+                object->wait.result = WAIT_TIMEOUT;
+                tp_submit_locked(object);
+                continue;
+            }
+
+            if (count == TP_MAX_WAITS) {
+                continue;
+            }
+
+            object->references++;
+            handles[count] = object->wait.handle;
+            objects[count] = object;
+            count++;
+
+            if (timeoutPtr == NULL || object->wait.deadline < timeout.QuadPart) {
+                // Positive values are absolute timeouts
+                timeout.QuadPart = object->wait.deadline;
+                timeoutPtr = &timeout;
+            }
+        }
+        KfLowerIrql(oldIrql);
+
+        handles[count] = tp_wait_event;
+        NTSTATUS status = NtWaitForMultipleObjectsEx(count + 1, handles, WaitAny, UserMode, FALSE, timeoutPtr);
+
+        ULONG signaled = count;
+        ULONGLONG invalid = 0;
+        if (status < STATUS_WAIT_0 + count) {
+            signaled = status - STATUS_WAIT_0;
+        } else if (status >= STATUS_ABANDONED_WAIT_0 && status < STATUS_ABANDONED_WAIT_0 + count) {
+            signaled = status - STATUS_ABANDONED_WAIT_0;
+        } else if (!NT_SUCCESS(status)) {
+            // Find handles which became invalid, they would fail the wait
+            // over and over again
+            LARGE_INTEGER zero = {.QuadPart = 0};
+            for (ULONG i = 0; i < count; i++) {
+                if (!NT_SUCCESS(NtWaitForSingleObjectEx(handles[i], UserMode, FALSE, &zero))) {
+                    invalid |= 1ULL << i;
+                }
+            }
+        }
+
+        oldIrql = KeRaiseIrqlToDpcLevel();
+        for (ULONG i = 0; i < count; i++) {
+            tp_object_t *object = objects[i];
+            object->references--;
+
+            // Ignore waits which were changed in the meantime
+            if (!object->wait.registered || object->wait.handle != handles[i]) {
+                continue;
+            }
+
+            if (i == signaled) {
+                tp_wait_unregister_locked(object);
+                object->wait.result = WAIT_OBJECT_0;
+                tp_submit_locked(object);
+            } else if (invalid & (1ULL << i)) {
+                tp_wait_unregister_locked(object);
+            }
+        }
+        KfLowerIrql(oldIrql);
+
+        // Free objects which were closed while they were being waited on
+        for (ULONG i = 0; i < count; i++) {
+            oldIrql = KeRaiseIrqlToDpcLevel();
+            bool release = tp_object_unused(objects[i]);
+            KfLowerIrql(oldIrql);
+            if (release) {
+                ExFreePool(objects[i]);
+            }
+        }
+    }
+}
+
+static BOOL WINAPI tp_wait_init (PINIT_ONCE InitOnce, PVOID Parameter, PVOID *Context)
+{
+    NTSTATUS status;
+    HANDLE thread;
+
+    status = NtCreateEvent(&tp_wait_event, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(status)) {
+        return FALSE;
+    }
+
+    thread = CreateThread(NULL, TP_STACK_SIZE, tp_wait_thread, NULL, 0, NULL);
+    if (thread == NULL) {
+        NtClose(tp_wait_event);
+        return FALSE;
+    }
+    SetThreadPriority(thread, THREAD_PRIORITY_ABOVE_NORMAL);
+    NtClose(thread);
+
+    return TRUE;
+}
+
+PTP_WAIT CreateThreadpoolWait (PTP_WAIT_CALLBACK pfnwa, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+    tp_object_t *object = tp_object_create(TP_OBJECT_WAIT, pfnwa, pv, pcbe);
+    if (object == NULL) {
+        return NULL;
+    }
+
+    if (!InitOnceExecuteOnce(&tp_wait_init_once, tp_wait_init, NULL, NULL)) {
+        ExFreePool(object);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    return (PTP_WAIT)object;
+}
+
+VOID SetThreadpoolWait (PTP_WAIT pwa, HANDLE h, PFILETIME pftTimeout)
+{
+    tp_object_t *object = (tp_object_t *)pwa;
+    LONGLONG deadline = INT64_MAX;
+
+    if (pftTimeout != NULL) {
+        LARGE_INTEGER timeout;
+        timeout.LowPart = pftTimeout->dwLowDateTime;
+        timeout.HighPart = pftTimeout->dwHighDateTime;
+
+        if (timeout.QuadPart < 0) {
+            LARGE_INTEGER now;
+            KeQuerySystemTime(&now);
+            deadline = now.QuadPart - timeout.QuadPart;
+        } else {
+            deadline = timeout.QuadPart;
+        }
+    }
+
+    KIRQL oldIrql = KeRaiseIrqlToDpcLevel();
+    tp_wait_unregister_locked(object);
+    if (h != NULL) {
+        object->wait.handle = h;
+        object->wait.deadline = deadline;
+        object->wait.registered = TRUE;
+        InsertTailList(&tp_wait_list, &object->wait.listEntry);
+    }
+    KfLowerIrql(oldIrql);
+
+    // Have the wait thread pick up the change
+    NtSetEvent(tp_wait_event, NULL);
+}
+
+VOID WaitForThreadpoolWaitCallbacks (PTP_WAIT pwa, BOOL fCancelPendingCallbacks)
+{
+    tp_object_wait((tp_object_t *)pwa, fCancelPendingCallbacks);
+}
+
+VOID CloseThreadpoolWait (PTP_WAIT pwa)
+{
+    SetThreadpoolWait(pwa, NULL, NULL);
+    tp_object_close((tp_object_t *)pwa);
+}
+
+BOOL CallbackMayRunLong (PTP_CALLBACK_INSTANCE pci)
+{
+    return tp_ensure_spare_worker();
+}
+
+VOID SetEventWhenCallbackReturns (PTP_CALLBACK_INSTANCE pci, HANDLE evt)
+{
+    pci->eventOnReturn = evt;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#ifndef __THREADPOOLAPI_H__
+#define __THREADPOOLAPI_H__
+
+#include <minwinbase.h>
+#include <winbase.h>
+#include <windef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _TP_CALLBACK_INSTANCE TP_CALLBACK_INSTANCE, *PTP_CALLBACK_INSTANCE;
+typedef struct _TP_WORK TP_WORK, *PTP_WORK;
+typedef struct _TP_TIMER TP_TIMER, *PTP_TIMER;
+typedef struct _TP_WAIT TP_WAIT, *PTP_WAIT;
+typedef DWORD TP_WAIT_RESULT;
+
+typedef enum _TP_CALLBACK_PRIORITY
+{
+    TP_CALLBACK_PRIORITY_HIGH,
+    TP_CALLBACK_PRIORITY_NORMAL,
+    TP_CALLBACK_PRIORITY_LOW,
+    TP_CALLBACK_PRIORITY_INVALID,
+    TP_CALLBACK_PRIORITY_COUNT = TP_CALLBACK_PRIORITY_INVALID
+} TP_CALLBACK_PRIORITY;
+
+// nxdk only has a single, process-wide thread pool, so the callback
+// environment only carries the priority of the callbacks
+typedef struct _TP_CALLBACK_ENVIRON
+{
+    TP_CALLBACK_PRIORITY CallbackPriority;
+} TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
+
+typedef VOID(CALLBACK *PTP_SIMPLE_CALLBACK)(PTP_CALLBACK_INSTANCE Instance, PVOID Context);
+typedef VOID(CALLBACK *PTP_WORK_CALLBACK)(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work);
+typedef VOID(CALLBACK *PTP_TIMER_CALLBACK)(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer);
+typedef VOID(CALLBACK *PTP_WAIT_CALLBACK)(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult);
+
+static inline VOID InitializeThreadpoolEnvironment (PTP_CALLBACK_ENVIRON pcbe)
+{
+    pcbe->CallbackPriority = TP_CALLBACK_PRIORITY_NORMAL;
+}
+
+static inline VOID SetThreadpoolCallbackPriority (PTP_CALLBACK_ENVIRON pcbe, TP_CALLBACK_PRIORITY Priority)
+{
+    pcbe->CallbackPriority = Priority;
+}
+
+static inline VOID DestroyThreadpoolEnvironment (PTP_CALLBACK_ENVIRON pcbe)
+{
+    (VOID)pcbe;
+}
+
+BOOL TrySubmitThreadpoolCallback (PTP_SIMPLE_CALLBACK pfns, PVOID pv, PTP_CALLBACK_ENVIRON pcbe);
+
+PTP_WORK CreateThreadpoolWork (PTP_WORK_CALLBACK pfnwk, PVOID pv, PTP_CALLBACK_ENVIRON pcbe);
+VOID SubmitThreadpoolWork (PTP_WORK pwk);
+VOID WaitForThreadpoolWorkCallbacks (PTP_WORK pwk, BOOL fCancelPendingCallbacks);
+VOID CloseThreadpoolWork (PTP_WORK pwk);
+
+PTP_TIMER CreateThreadpoolTimer (PTP_TIMER_CALLBACK pfnti, PVOID pv, PTP_CALLBACK_ENVIRON pcbe);
+VOID SetThreadpoolTimer (PTP_TIMER pti, PFILETIME pftDueTime, DWORD msPeriod, DWORD msWindowLength);
+BOOL IsThreadpoolTimerSet (PTP_TIMER pti);
+VOID WaitForThreadpoolTimerCallbacks (PTP_TIMER pti, BOOL fCancelPendingCallbacks);
+VOID CloseThreadpoolTimer (PTP_TIMER pti);
+
+PTP_WAIT CreateThreadpoolWait (PTP_WAIT_CALLBACK pfnwa, PVOID pv, PTP_CALLBACK_ENVIRON pcbe);
+VOID SetThreadpoolWait (PTP_WAIT pwa, HANDLE h, PFILETIME pftTimeout);
+VOID WaitForThreadpoolWaitCallbacks (PTP_WAIT pwa, BOOL fCancelPendingCallbacks);
+VOID CloseThreadpoolWait (PTP_WAIT pwa);
+
+BOOL CallbackMayRunLong (PTP_CALLBACK_INSTANCE pci);
+VOID SetEventWhenCallbackReturns (PTP_CALLBACK_INSTANCE pci, HANDLE evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,6 +34,9 @@ extern "C" {
 #define THREAD_PRIORITY_ERROR_RETURN  0x7FFFFFFF
 
 typedef VOID(WINAPI *PFLS_CALLBACK_FUNCTION)(PVOID);
+typedef VOID(WINAPI *PFIBER_START_ROUTINE)(LPVOID);
+typedef PFIBER_START_ROUTINE LPFIBER_START_ROUTINE;
+#define FIBER_FLAG_FLOAT_SWITCH 0x1
 #define FLS_OUT_OF_INDEXES    0xFFFFFFFF
 #define FLS_MAXIMUM_AVAILABLE 64
 #define TLS_OUT_OF_INDEXES    FLS_OUT_OF_INDEXES
@@ -52,20 +55,17 @@ typedef BOOL(CALLBACK *PINIT_ONCE_FN)(PINIT_ONCE, PVOID, PVOID *);
 
 typedef struct _CONDITION_VARIABLE
 {
-    INIT_ONCE initOnce;
-    // eventHandles[0]: Created as SynchronizationEvent to wake a single thread
-    // eventHandles[1]: Created as NotificationEvent to wake all threads at once
-    PVOID eventHandles[2];
-    int waitCount;
+    // number of threads waiting on the condition variable
+    DWORD_PTR Ptr;
 } CONDITION_VARIABLE, *PCONDITION_VARIABLE;
-#define CONDITION_VARIABLE_INIT            {INIT_ONCE_STATIC_INIT, {INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE}, 0}
+#define CONDITION_VARIABLE_INIT            {0}
 #define CONDITION_VARIABLE_LOCKMODE_SHARED 0x01
 
 typedef struct _SRWLOCK
 {
-    // highest bit: reader lock (0=free, 1=locked)
-    // second-highest bit: global lock (0=free, 1=locked)
-    // remainder: blocking readers
+    // bit 0: held exclusively
+    // bit 1: threads are waiting for the lock
+    // remainder: number of shared owners
     DWORD_PTR Ptr;
 } SRWLOCK, *PSRWLOCK;
 
@@ -123,6 +123,39 @@ typedef struct _WIN32_FIND_DATAA
     CHAR cAlternateFileName[14];
 } WIN32_FIND_DATAA, *PWIN32_FIND_DATAA, *LPWIN32_FIND_DATAA;
 
+#define COPY_FILE_FAIL_IF_EXISTS        0x00000001
+#define COPY_FILE_RESTARTABLE           0x00000002
+#define COPY_FILE_OPEN_SOURCE_FOR_WRITE 0x00000004
+
+#define CALLBACK_CHUNK_FINISHED 0x00000000
+#define CALLBACK_STREAM_SWITCH  0x00000001
+
+#define PROGRESS_CONTINUE 0
+#define PROGRESS_CANCEL   1
+#define PROGRESS_STOP     2
+#define PROGRESS_QUIET    3
+
+typedef DWORD(WINAPI *LPPROGRESS_ROUTINE)(LARGE_INTEGER TotalFileSize, LARGE_INTEGER TotalBytesTransferred, LARGE_INTEGER StreamSize, LARGE_INTEGER StreamBytesTransferred, DWORD dwStreamNumber, DWORD dwCallbackReason, HANDLE hSourceFile, HANDLE hDestinationFile, LPVOID lpData);
+
+typedef enum _FINDEX_INFO_LEVELS
+{
+    FindExInfoStandard,
+    FindExInfoBasic,
+    FindExInfoMaxInfoLevel
+} FINDEX_INFO_LEVELS;
+
+typedef enum _FINDEX_SEARCH_OPS
+{
+    FindExSearchNameMatch,
+    FindExSearchLimitToDirectories,
+    FindExSearchLimitToDevices,
+    FindExSearchMaxSearchOp
+} FINDEX_SEARCH_OPS;
+
+#define FIND_FIRST_EX_CASE_SENSITIVE       0x00000001
+#define FIND_FIRST_EX_LARGE_FETCH          0x00000002
+#define FIND_FIRST_EX_ON_DISK_ENTRIES_ONLY 0x00000004
+
 #ifndef UNICODE
 #define WIN32_FIND_DATA   WIN32_FIND_DATAA
 #define PWIN32_FIND_DATA  PWIN32_FIND_DATAA
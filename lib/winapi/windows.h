@@ -12,12 +12,15 @@
 #include <fibersapi.h>
 #include <fileapi.h>
 #include <handleapi.h>
+#include <heapapi.h>
+#include <ioapiset.h>
 #include <libloaderapi.h>
 #include <memoryapi.h>
 #include <processthreadsapi.h>
 #include <profileapi.h>
 #include <synchapi.h>
 #include <sysinfoapi.h>
+#include <threadpoolapi.h>
 #include <timezoneapi.h>
 #include <winbase.h>
 #include <winerror.h>
@@ -40,12 +40,12 @@ typedef NTSTATUS *PNTSTATUS;
 
 typedef unsigned int SIZE_T, *PSIZE_T;
 
-typedef int BOOL, *PBOOL;
+typedef int BOOL, *PBOOL, *LPBOOL;
 typedef const char *PCSZ, *PCSTR, *LPCSTR;
 
 typedef ULONGLONG QUAD;
 
-typedef ULONG ULONG_PTR;
+typedef ULONG ULONG_PTR, *PULONG_PTR;
 typedef LONG LONG_PTR;
 
 typedef ULONG_PTR DWORD_PTR;
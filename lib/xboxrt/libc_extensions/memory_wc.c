@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Copies below this size aren't worth the setup, and leave no full block
+// after aligning the destination
+#define WC_MIN_SIZE 512
+
+// Write combining memory is flushed to RAM in cache line sized bursts when
+// whole lines are written. The blocks are therefore aligned to 64 bytes at
+// the destination and stored with movntq, which also keeps the data out of
+// the caches when the destination is cacheable. The source is read through
+// prefetchnta, a few blocks ahead of the loads, so it doesn't evict the
+// working set either.
+static void copy_blocks (void *dest, const void *src, size_t blocks)
+{
+    __asm__ __volatile__("1:\n"
+                         "prefetchnta 256(%1)\n"
+                         "movq    0(%1), %%mm0\n"
+                         "movq    8(%1), %%mm1\n"
+                         "movq   16(%1), %%mm2\n"
+                         "movq   24(%1), %%mm3\n"
+                         "movq   32(%1), %%mm4\n"
+                         "movq   40(%1), %%mm5\n"
+                         "movq   48(%1), %%mm6\n"
+                         "movq   56(%1), %%mm7\n"
+                         "movntq %%mm0,  0(%0)\n"
+                         "movntq %%mm1,  8(%0)\n"
+                         "movntq %%mm2, 16(%0)\n"
+                         "movntq %%mm3, 24(%0)\n"
+                         "movntq %%mm4, 32(%0)\n"
+                         "movntq %%mm5, 40(%0)\n"
+                         "movntq %%mm6, 48(%0)\n"
+                         "movntq %%mm7, 56(%0)\n"
+                         "add $64, %1\n"
+                         "add $64, %0\n"
+                         "dec %2\n"
+                         "jnz 1b\n"
+                         "emms"
+                         : "+r"(dest), "+r"(src), "+r"(blocks)
+                         :
+                         : "mm0", "mm1", "mm2", "mm3", "mm4", "mm5", "mm6", "mm7", "memory", "cc");
+}
+
+static void fill_blocks (void *dest, uint32_t pattern, size_t blocks)
+{
+    __asm__ __volatile__("movd %2, %%mm0\n"
+                         "punpckldq %%mm0, %%mm0\n"
+                         "1:\n"
+                         "movntq %%mm0,  0(%0)\n"
+                         "movntq %%mm0,  8(%0)\n"
+                         "movntq %%mm0, 16(%0)\n"
+                         "movntq %%mm0, 24(%0)\n"
+                         "movntq %%mm0, 32(%0)\n"
+                         "movntq %%mm0, 40(%0)\n"
+                         "movntq %%mm0, 48(%0)\n"
+                         "movntq %%mm0, 56(%0)\n"
+                         "add $64, %0\n"
+                         "dec %1\n"
+                         "jnz 1b\n"
+                         "emms"
+                         : "+r"(dest), "+r"(blocks)
+                         : "r"(pattern)
+                         : "mm0", "memory", "cc");
+}
+
+void *_memcpy_wc (void *dest, const void *src, size_t n)
+{
+    if (n < WC_MIN_SIZE) {
+        return memcpy(dest, src, n);
+    }
+
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+
+    size_t head = -(uintptr_t)d & 63;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    copy_blocks(d, s, n / 64);
+    d += n & ~(size_t)63;
+    s += n & ~(size_t)63;
+    memcpy(d, s, n & 63);
+
+    // Non-temporal stores aren't ordered with later stores, so the data has
+    // to be out before the caller hands the memory to the GPU or APU
+    __asm__ __volatile__("sfence" ::: "memory");
+
+    return dest;
+}
+
+void *_memset_wc (void *dest, int c, size_t n)
+{
+    if (n < WC_MIN_SIZE) {
+        return memset(dest, c, n);
+    }
+
+    unsigned char *d = dest;
+
+    size_t head = -(uintptr_t)d & 63;
+    memset(d, c, head);
+    d += head;
+    n -= head;
+
+    fill_blocks(d, (unsigned char)c * 0x01010101u, n / 64);
+    d += n & ~(size_t)63;
+    memset(d, c, n & 63);
+
+    __asm__ __volatile__("sfence" ::: "memory");
+
+    return dest;
+}
@@ -29,6 +29,15 @@ __attribute__((deprecated)) static int stricmp (const char *s1, const char *s2)
     return _stricmp(s1, s2);
 }
 
+// nxdk extensions for copying to and filling memory mapped with
+// PAGE_WRITECOMBINE, like framebuffers, textures or audio buffers. Blocks of
+// 512 bytes and more are written with non-temporal MMX stores, followed by an
+// sfence, smaller ones are passed to memcpy and memset.
+// The MMX registers alias the FPU registers, and the kernel doesn't save them
+// for DPCs or interrupt handlers, so don't call these from there.
+void *_memcpy_wc (void *dest, const void *src, size_t n);
+void *_memset_wc (void *dest, int c, size_t n);
+
 #ifndef NLSCMP_DEFINED
 #define _NLSCMPERROR 0x7FFFFFFF
 #define _NLSCMP_DEFINED
@@ -0,0 +1,72 @@
+#include <hal/debug.h>
+#include <hal/video.h>
+#include <windows.h>
+
+/*
+ * Raises and catches structured exceptions on a fiber stack. The exception
+ * dispatcher only accepts handlers that lie within the stack bounds of the
+ * thread, so this only works if SwitchToFiber moves those bounds along.
+ */
+
+#define STATUS_SAMPLE_EXCEPTION 0xE0000001
+
+static LPVOID mainFiber;
+
+static int filter(DWORD code, DWORD expected)
+{
+    return (code == expected) ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH;
+}
+
+// A few frames deep, so the handler isn't in the frame that raises
+static void __attribute__((noinline)) raiseNested(int depth)
+{
+    if (depth == 0) {
+        RaiseException(STATUS_SAMPLE_EXCEPTION, 0, 0, NULL);
+    }
+    raiseNested(depth - 1);
+}
+
+static VOID WINAPI fiberRoutine(LPVOID lpParameter)
+{
+    int *results = (int *)lpParameter;
+
+    while (TRUE) {
+        __try {
+            raiseNested(8);
+        } __except (filter(GetExceptionCode(), STATUS_SAMPLE_EXCEPTION)) {
+            results[0]++;
+        }
+
+        __try {
+            volatile int *invalid = NULL;
+            *invalid = 1;
+        } __except (filter(GetExceptionCode(), EXCEPTION_ACCESS_VIOLATION)) {
+            results[1]++;
+        }
+
+        SwitchToFiber(mainFiber);
+    }
+}
+
+int main(void)
+{
+    int results[2] = { 0, 0 };
+
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    mainFiber = ConvertThreadToFiber(NULL);
+    LPVOID fiber = CreateFiber(64 * 1024, fiberRoutine, results);
+    if (mainFiber == NULL || fiber == NULL) {
+        debugPrint("Could not create the fibers\n");
+        while (1) Sleep(2000);
+    }
+
+    for (int i = 1; ; i++) {
+        SwitchToFiber(fiber);
+        debugPrint("Round %d: %d raised, %d access violations caught on the fiber\n",
+                   i, results[0], results[1]);
+        Sleep(1000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <hal/debug.h>
+#include <hal/video.h>
+#include <windows.h>
+
+/*
+ * Measures the cost of SwitchToFiber by switching back and forth between the
+ * main fiber and a second one, with and without FIBER_FLAG_FLOAT_SWITCH. For
+ * comparison, the same ping-pong is done between two threads with a pair of
+ * auto-reset events.
+ */
+
+#define SWITCHES 1000000
+
+static LPVOID mainFiber;
+static HANDLE pingEvent;
+static HANDLE pongEvent;
+
+static VOID WINAPI pongFiber(LPVOID lpParameter)
+{
+    while (TRUE) {
+        SwitchToFiber(mainFiber);
+    }
+}
+
+static DWORD WINAPI pongThread(LPVOID lpParameter)
+{
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        WaitForSingleObject(pingEvent, INFINITE);
+        SetEvent(pongEvent);
+    }
+    return 0;
+}
+
+static double nanosecondsPerSwitch(LARGE_INTEGER start, LARGE_INTEGER end)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1000000000.0 / (double)frequency.QuadPart / SWITCHES;
+}
+
+static void runFibers(const char *name, DWORD flags)
+{
+    LARGE_INTEGER start, end;
+
+    mainFiber = ConvertThreadToFiberEx(NULL, flags);
+    LPVOID fiber = CreateFiberEx(0, 16 * 1024, flags, pongFiber, NULL);
+    if (mainFiber == NULL || fiber == NULL) {
+        debugPrint("%-24s could not create the fibers\n", name);
+        return;
+    }
+
+    // Every round switches twice, to the fiber and back
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        SwitchToFiber(fiber);
+    }
+    QueryPerformanceCounter(&end);
+
+    DeleteFiber(fiber);
+    ConvertFiberToThread();
+
+    debugPrint("%-24s %8u ns per switch\n", name, (unsigned int)nanosecondsPerSwitch(start, end));
+}
+
+static void runThreads(void)
+{
+    LARGE_INTEGER start, end;
+
+    pingEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    pongEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    HANDLE thread = CreateThread(NULL, 0, pongThread, NULL, 0, NULL);
+
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        SetEvent(pingEvent);
+        WaitForSingleObject(pongEvent, INFINITE);
+    }
+    QueryPerformanceCounter(&end);
+
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    CloseHandle(pingEvent);
+    CloseHandle(pongEvent);
+
+    debugPrint("%-24s %8u ns per switch\n", "threads with events", (unsigned int)nanosecondsPerSwitch(start, end));
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    debugPrint("%d switches each\n\n", SWITCHES);
+    runFibers("fibers", 0);
+    runFibers("fibers with FPU state", FIBER_FLAG_FLOAT_SWITCH);
+    runThreads();
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
@@ -333,7 +333,7 @@ static void init_textures(void)
     texture.height = texture_height;
     texture.pitch = texture.width*4;
     texture.addr = MmAllocateContiguousMemoryEx(texture.pitch*texture.height, 0, MAXRAM, 0, 0x404);
-    memcpy(texture.addr, texture_rgba, sizeof(texture_rgba));
+    _memcpy_wc(texture.addr, texture_rgba, sizeof(texture_rgba));
 }
 
 /* Set an attribute pointer */
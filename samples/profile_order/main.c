@@ -0,0 +1,101 @@
+#include <hal/debug.h>
+#include <hal/video.h>
+#include <nxdk/profiler.h>
+#include <stdint.h>
+#include <windows.h>
+
+#define PROFILE_PATH "D:\\nxprof.bin"
+
+#define STATE_SIZE 1024
+
+static uint32_t state[STATE_SIZE];
+
+// The workload runs through eight stages, each of which is followed by a
+// large function that only runs if the stage fails, like error handling or
+// loading code in a game. The cold functions hold 6 KiB of padding, so every
+// stage ends up on a page of its own until the functions are ordered.
+// Everything is kept global and out of line, so the functions show up in the
+// map and the profile under their own names.
+
+#define HOT_STAGE(n, shift)                                                   \
+    __attribute__((noinline)) uint32_t stage##n(void)                         \
+    {                                                                         \
+        uint32_t sum = 0;                                                     \
+        for (int i = 1; i < STATE_SIZE; i++) {                                \
+            state[i] ^= (state[i - 1] << shift) | (state[i - 1] >> (32 - shift)); \
+            sum += state[i];                                                  \
+        }                                                                     \
+        return sum;                                                           \
+    }
+
+#define COLD_HANDLER(n)                                                       \
+    __attribute__((noinline)) void stage##n##_failed(void)                    \
+    {                                                                         \
+        __asm__ __volatile__(".fill 6144, 1, 0x90");                          \
+        debugPrint("Stage %d failed: %08x %08x\n", n, state[0], state[1]);    \
+        Sleep(5000);                                                          \
+    }
+
+HOT_STAGE(0, 3)
+COLD_HANDLER(0)
+HOT_STAGE(1, 5)
+COLD_HANDLER(1)
+HOT_STAGE(2, 7)
+COLD_HANDLER(2)
+HOT_STAGE(3, 11)
+COLD_HANDLER(3)
+HOT_STAGE(4, 13)
+COLD_HANDLER(4)
+HOT_STAGE(5, 17)
+COLD_HANDLER(5)
+HOT_STAGE(6, 19)
+COLD_HANDLER(6)
+HOT_STAGE(7, 23)
+COLD_HANDLER(7)
+
+__attribute__((noinline)) void step(void)
+{
+    state[0] += 0x9E3779B9;
+
+    // A stage fails if all its sums cancel out, which doesn't happen
+    if (stage0() == 0) stage0_failed();
+    if (stage1() == 0) stage1_failed();
+    if (stage2() == 0) stage2_failed();
+    if (stage3() == 0) stage3_failed();
+    if (stage4() == 0) stage4_failed();
+    if (stage5() == 0) stage5_failed();
+    if (stage6() == 0) stage6_failed();
+    if (stage7() == 0) stage7_failed();
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    if (!nxProfilerStart(1000, 10000)) {
+        debugPrint("Could not start the profiler\n");
+        while (1) Sleep(2000);
+    }
+
+    unsigned int iterations = 0;
+    DWORD start = GetTickCount();
+    while (GetTickCount() - start < 5000) {
+        step();
+        iterations++;
+    }
+
+    nxProfilerStop();
+    debugPrint("%u iterations, state %08x\n", iterations, state[STATE_SIZE - 1]);
+
+    if (nxProfilerSave(PROFILE_PATH)) {
+        debugPrint("Samples written to %s\n", PROFILE_PATH);
+    } else {
+        debugPrint("Could not write %s\n", PROFILE_PATH);
+    }
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <windows.h>
+#include <hal/debug.h>
+#include <hal/video.h>
+
+/*
+ * Measures how long it takes to hand work from one thread to another through
+ * a condition variable.
+ *
+ * The ping-pong test passes a token back and forth between two threads, and
+ * is compared with the same test using two auto-reset events, which is as
+ * fast as a handoff through the kernel can get.
+ *
+ * The queue test has one producer and several consumers. It reports the time
+ * from queueing an item to a consumer taking it, and how often a consumer
+ * woke up without finding anything to take.
+ */
+
+#define PING_PONG_ROUNDS 20000
+#define QUEUE_ITEMS      20000
+#define QUEUE_SIZE       16
+#define CONSUMERS        4
+
+static SRWLOCK lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE turnChanged;
+static volatile int turn;
+
+static HANDLE pingEvent;
+static HANDLE pongEvent;
+
+static DWORD WINAPI conditionPong(LPVOID lpParameter)
+{
+    for (int i = 0; i < PING_PONG_ROUNDS; i++) {
+        AcquireSRWLockExclusive(&lock);
+        while (turn != 1) {
+            SleepConditionVariableSRW(&turnChanged, &lock, INFINITE, 0);
+        }
+        turn = 0;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&turnChanged);
+    }
+    return 0;
+}
+
+static void conditionPing(void)
+{
+    for (int i = 0; i < PING_PONG_ROUNDS; i++) {
+        AcquireSRWLockExclusive(&lock);
+        turn = 1;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&turnChanged);
+
+        AcquireSRWLockExclusive(&lock);
+        while (turn != 0) {
+            SleepConditionVariableSRW(&turnChanged, &lock, INFINITE, 0);
+        }
+        ReleaseSRWLockExclusive(&lock);
+    }
+}
+
+static DWORD WINAPI eventPong(LPVOID lpParameter)
+{
+    for (int i = 0; i < PING_PONG_ROUNDS; i++) {
+        WaitForSingleObject(pingEvent, INFINITE);
+        SetEvent(pongEvent);
+    }
+    return 0;
+}
+
+static void eventPing(void)
+{
+    for (int i = 0; i < PING_PONG_ROUNDS; i++) {
+        SetEvent(pingEvent);
+        WaitForSingleObject(pongEvent, INFINITE);
+    }
+}
+
+static double elapsedMicroseconds(LARGE_INTEGER start, LARGE_INTEGER end)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1000000.0 / (double)frequency.QuadPart;
+}
+
+static void runPingPong(const char *name, LPTHREAD_START_ROUTINE pong, void (*ping)(void))
+{
+    LARGE_INTEGER start, end;
+
+    HANDLE thread = CreateThread(NULL, 0, pong, NULL, 0, NULL);
+    QueryPerformanceCounter(&start);
+    ping();
+    QueryPerformanceCounter(&end);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+
+    // Every round consists of two handoffs
+    double us = elapsedMicroseconds(start, end) / (PING_PONG_ROUNDS * 2);
+    debugPrint("%-20s %6u.%02u us per handoff\n", name, (unsigned int)us, (unsigned int)(us * 100) % 100);
+}
+
+static CONDITION_VARIABLE notEmpty;
+static CONDITION_VARIABLE notFull;
+static LONGLONG queue[QUEUE_SIZE];
+static int queueHead;
+static int queueCount;
+static BOOL producerDone;
+
+static LONGLONG totalLatency;
+static DWORD consumed;
+static DWORD emptyWakeups;
+
+static DWORD WINAPI consumerThread(LPVOID lpParameter)
+{
+    AcquireSRWLockExclusive(&lock);
+    while (TRUE) {
+        BOOL waited = FALSE;
+        while (queueCount == 0 && !producerDone) {
+            if (waited) {
+                emptyWakeups++;
+            }
+            SleepConditionVariableSRW(&notEmpty, &lock, INFINITE, 0);
+            waited = TRUE;
+        }
+        if (queueCount == 0) {
+            break;
+        }
+
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        totalLatency += now.QuadPart - queue[queueHead];
+        queueHead = (queueHead + 1) % QUEUE_SIZE;
+        queueCount--;
+        consumed++;
+
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&notFull);
+        AcquireSRWLockExclusive(&lock);
+    }
+    ReleaseSRWLockExclusive(&lock);
+    return 0;
+}
+
+static void runQueue(void)
+{
+    HANDLE threads[CONSUMERS];
+
+    for (int i = 0; i < CONSUMERS; i++) {
+        threads[i] = CreateThread(NULL, 0, consumerThread, NULL, 0, NULL);
+    }
+
+    for (int i = 0; i < QUEUE_ITEMS; i++) {
+        AcquireSRWLockExclusive(&lock);
+        while (queueCount == QUEUE_SIZE) {
+            SleepConditionVariableSRW(&notFull, &lock, INFINITE, 0);
+        }
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        queue[(queueHead + queueCount) % QUEUE_SIZE] = now.QuadPart;
+        queueCount++;
+        ReleaseSRWLockExclusive(&lock);
+        WakeConditionVariable(&notEmpty);
+    }
+
+    AcquireSRWLockExclusive(&lock);
+    producerDone = TRUE;
+    ReleaseSRWLockExclusive(&lock);
+    WakeAllConditionVariable(&notEmpty);
+
+    WaitForMultipleObjects(CONSUMERS, threads, TRUE, INFINITE);
+    for (int i = 0; i < CONSUMERS; i++) {
+        CloseHandle(threads[i]);
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    double us = (double)totalLatency * 1000000.0 / (double)frequency.QuadPart / consumed;
+    debugPrint("%lu items, %d consumers\n", consumed, CONSUMERS);
+    debugPrint("%6u.%02u us from queueing to taking an item\n", (unsigned int)us, (unsigned int)(us * 100) % 100);
+    debugPrint("%lu wakeups found the queue empty\n", emptyWakeups);
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    InitializeConditionVariable(&turnChanged);
+    InitializeConditionVariable(&notEmpty);
+    InitializeConditionVariable(&notFull);
+    pingEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    pongEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    debugPrint("Ping-pong, %d rounds\n", PING_PONG_ROUNDS);
+    runPingPong("condition variable", conditionPong, conditionPing);
+    runPingPong("auto-reset events", eventPong, eventPing);
+    debugPrint("\n");
+
+    runQueue();
+
+    CloseHandle(pingEvent);
+    CloseHandle(pongEvent);
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <nxdk/mount.h>
+#include <hal/debug.h>
+#include <hal/video.h>
+
+/*
+ * Copies files of sizes around the chunk boundaries of CopyFileA and checks
+ * that the copies match, then measures the throughput of CopyFileA against a
+ * plain ReadFile/WriteFile loop. The test files are created in E:\copytest
+ * and removed again afterwards.
+ */
+
+// Same as the default chunk size and count in CopyFileA
+#define CHUNK_SIZE  (128 * 1024)
+#define CHUNK_COUNT 4
+
+#define BENCH_SIZE (32 * 1024 * 1024)
+
+#define TEST_DIR "E:\\copytest"
+#define SOURCE   TEST_DIR "\\source.bin"
+#define TARGET   TEST_DIR "\\target.bin"
+
+static const DWORD testSizes[] = {
+    0,
+    1,
+    CHUNK_SIZE - 1,
+    CHUNK_SIZE,
+    CHUNK_SIZE + 1,
+    CHUNK_SIZE * CHUNK_COUNT,
+    CHUNK_SIZE * CHUNK_COUNT + 1,
+    CHUNK_SIZE * CHUNK_COUNT * 3 + 4321,
+};
+
+static unsigned char bufferA[CHUNK_SIZE];
+static unsigned char bufferB[CHUNK_SIZE];
+
+// Every byte depends on its offset, so chunks written to the wrong place
+// don't compare equal either
+static void fillPattern(unsigned char *buffer, DWORD offset, DWORD length)
+{
+    for (DWORD i = 0; i < length; i++) {
+        DWORD position = offset + i;
+        buffer[i] = (unsigned char)((position >> 16) ^ (position >> 8) ^ position ^ 0x5A);
+    }
+}
+
+static BOOL createSource(DWORD size)
+{
+    HANDLE file = CreateFileA(SOURCE, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    BOOL success = TRUE;
+    for (DWORD offset = 0; offset < size && success; offset += CHUNK_SIZE) {
+        DWORD length = (size - offset < CHUNK_SIZE) ? size - offset : CHUNK_SIZE;
+        DWORD written;
+        fillPattern(bufferA, offset, length);
+        success = WriteFile(file, bufferA, length, &written, NULL) && written == length;
+    }
+
+    CloseHandle(file);
+    return success;
+}
+
+static BOOL compareFiles(DWORD size)
+{
+    HANDLE source = CreateFileA(SOURCE, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    HANDLE target = CreateFileA(TARGET, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    BOOL equal = source != INVALID_HANDLE_VALUE && target != INVALID_HANDLE_VALUE;
+
+    if (equal) {
+        equal = GetFileSize(target, NULL) == size;
+    }
+
+    for (DWORD offset = 0; offset < size && equal; offset += CHUNK_SIZE) {
+        DWORD length = (size - offset < CHUNK_SIZE) ? size - offset : CHUNK_SIZE;
+        DWORD readA, readB;
+        equal = ReadFile(source, bufferA, length, &readA, NULL) && readA == length &&
+                ReadFile(target, bufferB, length, &readB, NULL) && readB == length &&
+                memcmp(bufferA, bufferB, length) == 0;
+    }
+
+    if (source != INVALID_HANDLE_VALUE) {
+        CloseHandle(source);
+    }
+    if (target != INVALID_HANDLE_VALUE) {
+        CloseHandle(target);
+    }
+    return equal;
+}
+
+// What CopyFileA used to do: read a chunk, then write it, one after another
+static BOOL copySynchronous(void)
+{
+    HANDLE source = CreateFileA(SOURCE, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (source == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+    HANDLE target = CreateFileA(TARGET, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (target == INVALID_HANDLE_VALUE) {
+        CloseHandle(source);
+        return FALSE;
+    }
+
+    BOOL success = TRUE;
+    DWORD read;
+    while (success && ReadFile(source, bufferA, CHUNK_SIZE, &read, NULL) && read > 0) {
+        DWORD written;
+        success = WriteFile(target, bufferA, read, &written, NULL) && written == read;
+    }
+
+    CloseHandle(source);
+    CloseHandle(target);
+    return success;
+}
+
+static double elapsedMilliseconds(LARGE_INTEGER start, LARGE_INTEGER end)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+static void runBenchmark(const char *name, BOOL (*copy)(void))
+{
+    LARGE_INTEGER start, end;
+
+    DeleteFileA(TARGET);
+    QueryPerformanceCounter(&start);
+    BOOL success = copy();
+    QueryPerformanceCounter(&end);
+
+    if (!success) {
+        debugPrint("%-12s failed, error %lu\n", name, GetLastError());
+        return;
+    }
+
+    double ms = elapsedMilliseconds(start, end);
+    debugPrint("%-12s %6u ms, %5u KiB/s\n", name, (unsigned int)ms, (unsigned int)(BENCH_SIZE / 1024 * 1000.0 / ms));
+}
+
+static BOOL copyChunked(void)
+{
+    return CopyFileA(SOURCE, TARGET, FALSE);
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    if (!nxMountDrive('E', "\\Device\\Harddisk0\\Partition1\\")) {
+        debugPrint("Failed to mount E: drive!\n");
+        Sleep(5000);
+        return 1;
+    }
+
+    CreateDirectoryA(TEST_DIR, NULL);
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(testSizes) / sizeof(testSizes[0]); i++) {
+        DWORD size = testSizes[i];
+
+        DeleteFileA(TARGET);
+        BOOL success = createSource(size);
+        if (success) {
+            success = CopyFileA(SOURCE, TARGET, FALSE) && compareFiles(size);
+        }
+
+        debugPrint("%8lu bytes: %s\n", size, success ? "ok" : "FAILED");
+        failures += success ? 0 : 1;
+    }
+    debugPrint("%d of %u copies failed\n\n", failures, (unsigned int)(sizeof(testSizes) / sizeof(testSizes[0])));
+
+    debugPrint("Copying %u MiB\n", BENCH_SIZE / (1024 * 1024));
+    if (createSource(BENCH_SIZE)) {
+        // Alternate the two a few times, so neither one always gets the
+        // warm cache
+        for (int i = 0; i < 3; i++) {
+            runBenchmark("synchronous", copySynchronous);
+            runBenchmark("CopyFileA", copyChunked);
+        }
+    } else {
+        debugPrint("Failed to create the source file\n");
+    }
+
+    DeleteFileA(SOURCE);
+    DeleteFileA(TARGET);
+    RemoveDirectoryA(TEST_DIR);
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
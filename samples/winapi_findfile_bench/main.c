@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <nxdk/mount.h>
+#include <hal/debug.h>
+#include <hal/video.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+/*
+ * Lists a directory with a few thousand files, once with FindFirstFile and
+ * FindNextFile and once the way they used to work, with a buffer that fits a
+ * single record per NtQueryDirectoryFile call. It also counts how many records
+ * the file system returns per call for a buffer of the size FindFirstFile
+ * uses. The files are created in E:\findbench and removed again afterwards.
+ */
+
+#define FILE_COUNT 2000
+#define ROUNDS     5
+
+#define TEST_DIR "E:\\findbench"
+
+// Same as the buffer size in lib/winapi/findfile.c
+#define FIND_BUFFER_SIZE 4096
+
+struct SingleFileInfo
+{
+    FILE_DIRECTORY_INFORMATION dirInfo;
+    char filename[MAX_PATH - 2];
+};
+
+static ULONGLONG batchBuffer[FIND_BUFFER_SIZE / sizeof(ULONGLONG)];
+
+static HANDLE openDirectory(void)
+{
+    ANSI_STRING dirPath;
+    OBJECT_ATTRIBUTES attributes;
+    IO_STATUS_BLOCK ioStatusBlock;
+    HANDLE handle;
+
+    RtlInitAnsiString(&dirPath, TEST_DIR "\\");
+    InitializeObjectAttributes(&attributes, &dirPath, OBJ_CASE_INSENSITIVE, ObDosDevicesDirectory(), NULL);
+    NTSTATUS status = NtOpenFile(&handle, FILE_LIST_DIRECTORY | SYNCHRONIZE, &attributes, &ioStatusBlock, FILE_SHARE_READ, FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    return NT_SUCCESS(status) ? handle : NULL;
+}
+
+static DWORD listFindFile(DWORD *calls)
+{
+    WIN32_FIND_DATAA findData;
+    DWORD entries = 0;
+
+    HANDLE find = FindFirstFileA(TEST_DIR "\\*", &findData);
+    if (find == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    do {
+        entries++;
+    } while (FindNextFileA(find, &findData));
+    FindClose(find);
+
+    return entries;
+}
+
+static DWORD listSingleEntry(DWORD *calls)
+{
+    struct SingleFileInfo fileInformation;
+    IO_STATUS_BLOCK ioStatusBlock;
+    DWORD entries = 0;
+
+    HANDLE handle = openDirectory();
+    if (handle == NULL) {
+        return 0;
+    }
+    while (TRUE) {
+        NTSTATUS status = NtQueryDirectoryFile(handle, NULL, NULL, NULL, &ioStatusBlock, &fileInformation, sizeof(fileInformation), FileDirectoryInformation, NULL, FALSE);
+        (*calls)++;
+        if (!NT_SUCCESS(status)) {
+            break;
+        }
+        entries++;
+    }
+    NtClose(handle);
+    return entries;
+}
+
+static DWORD listBatched(DWORD *calls)
+{
+    IO_STATUS_BLOCK ioStatusBlock;
+    DWORD entries = 0;
+
+    HANDLE handle = openDirectory();
+    if (handle == NULL) {
+        return 0;
+    }
+    while (TRUE) {
+        NTSTATUS status = NtQueryDirectoryFile(handle, NULL, NULL, NULL, &ioStatusBlock, batchBuffer, sizeof(batchBuffer), FileDirectoryInformation, NULL, FALSE);
+        (*calls)++;
+        if (!NT_SUCCESS(status) || ioStatusBlock.Information == 0) {
+            break;
+        }
+
+        FILE_DIRECTORY_INFORMATION *record = (FILE_DIRECTORY_INFORMATION *)batchBuffer;
+        while (TRUE) {
+            entries++;
+            if (record->NextEntryOffset == 0) {
+                break;
+            }
+            record = (FILE_DIRECTORY_INFORMATION *)((char *)record + record->NextEntryOffset);
+        }
+    }
+    NtClose(handle);
+    return entries;
+}
+
+static void runBenchmark(const char *name, DWORD (*list)(DWORD *))
+{
+    LARGE_INTEGER start, end, frequency;
+    DWORD entries = 0;
+    DWORD calls = 0;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < ROUNDS; i++) {
+        // The library doesn't tell how often it queried the file system,
+        // so FindNextFile leaves this at zero
+        calls = 0;
+        entries = list(&calls);
+    }
+    QueryPerformanceCounter(&end);
+
+    double us = (double)(end.QuadPart - start.QuadPart) * 1000000.0 / (double)frequency.QuadPart / ROUNDS;
+    debugPrint("%-16s %5lu entries %8u us", name, entries, (unsigned int)us);
+    if (calls) {
+        debugPrint(" %5lu calls", calls);
+    }
+    debugPrint("\n");
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    if (!nxMountDrive('E', "\\Device\\Harddisk0\\Partition1\\")) {
+        debugPrint("Failed to mount E: drive!\n");
+        Sleep(5000);
+        return 1;
+    }
+
+    char path[MAX_PATH];
+    CreateDirectoryA(TEST_DIR, NULL);
+    debugPrint("Creating %d files\n", FILE_COUNT);
+    for (int i = 0; i < FILE_COUNT; i++) {
+        snprintf(path, sizeof(path), TEST_DIR "\\file%04d.dat", i);
+        HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            debugPrint("Failed to create %s\n", path);
+            break;
+        }
+        CloseHandle(file);
+    }
+
+    debugPrint("Listing, average of %d rounds\n\n", ROUNDS);
+    for (int round = 0; round < 2; round++) {
+        runBenchmark("FindNextFile", listFindFile);
+        runBenchmark("single record", listSingleEntry);
+        runBenchmark("4 KiB buffer", listBatched);
+    }
+
+    for (int i = 0; i < FILE_COUNT; i++) {
+        snprintf(path, sizeof(path), TEST_DIR "\\file%04d.dat", i);
+        DeleteFileA(path);
+    }
+    RemoveDirectoryA(TEST_DIR);
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
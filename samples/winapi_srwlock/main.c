@@ -0,0 +1,206 @@
+#include <stdbool.h>
+#include <windows.h>
+#include <hal/debug.h>
+#include <hal/video.h>
+
+/*
+ * Measures SRW locks under contention. Readers and writers take the lock in
+ * a loop and give up the CPU while holding it, like they would when waiting
+ * for I/O, so the other threads find it taken. An idle priority thread counts
+ * how much CPU time the waiting threads leave over.
+ *
+ * The SRW locks of the library are compared with the spinning implementation
+ * they replaced, which is copied below.
+ */
+
+#define READERS      3
+#define WRITERS      2
+#define RUN_TIME_MS  3000
+
+#define SPIN_GLOBAL_LOCK_MASK  ((DWORD_PTR)0x40000000)
+#define SPIN_READER_LOCK_MASK  ((DWORD_PTR)0x80000000)
+#define SPIN_READER_COUNT_MASK ~(SPIN_GLOBAL_LOCK_MASK | SPIN_READER_LOCK_MASK)
+
+static bool spinTryAcquireMask(DWORD_PTR *lock, DWORD_PTR mask)
+{
+    DWORD_PTR unlocked_val = *lock & ~mask;
+    return __sync_bool_compare_and_swap(lock, unlocked_val, unlocked_val | mask);
+}
+
+static void spinReleaseMask(DWORD_PTR *lock, DWORD_PTR mask)
+{
+    __sync_fetch_and_and(lock, ~mask);
+}
+
+static void spinAcquireExclusive(PSRWLOCK lock)
+{
+    while (!spinTryAcquireMask(&lock->Ptr, SPIN_GLOBAL_LOCK_MASK)) {
+        SwitchToThread();
+    }
+}
+
+static void spinReleaseExclusive(PSRWLOCK lock)
+{
+    spinReleaseMask(&lock->Ptr, SPIN_GLOBAL_LOCK_MASK);
+}
+
+static void spinAcquireShared(PSRWLOCK lock)
+{
+    while (!spinTryAcquireMask(&lock->Ptr, SPIN_READER_LOCK_MASK)) {
+        SwitchToThread();
+    }
+    DWORD_PTR prev_val = __atomic_fetch_add(&lock->Ptr, 1, __ATOMIC_ACQ_REL);
+    if ((prev_val & SPIN_READER_COUNT_MASK) == 0) {
+        spinAcquireExclusive(lock);
+    }
+    spinReleaseMask(&lock->Ptr, SPIN_READER_LOCK_MASK);
+}
+
+static void spinReleaseShared(PSRWLOCK lock)
+{
+    while (!spinTryAcquireMask(&lock->Ptr, SPIN_READER_LOCK_MASK)) {
+        SwitchToThread();
+    }
+    DWORD_PTR prev_val = __atomic_fetch_sub(&lock->Ptr, 1, __ATOMIC_ACQ_REL);
+    if ((prev_val & SPIN_READER_COUNT_MASK) == 1) {
+        spinReleaseExclusive(lock);
+    }
+    spinReleaseMask(&lock->Ptr, SPIN_READER_LOCK_MASK);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*acquireShared)(PSRWLOCK);
+    void (*releaseShared)(PSRWLOCK);
+    void (*acquireExclusive)(PSRWLOCK);
+    void (*releaseExclusive)(PSRWLOCK);
+} LockOps;
+
+static const LockOps implementations[] = {
+    { "spinning", spinAcquireShared, spinReleaseShared, spinAcquireExclusive, spinReleaseExclusive },
+    { "library", AcquireSRWLockShared, ReleaseSRWLockShared, AcquireSRWLockExclusive, ReleaseSRWLockExclusive },
+};
+
+static const LockOps *ops;
+static SRWLOCK lock;
+static volatile BOOL stop;
+static volatile DWORD sharedData[64];
+
+static volatile DWORD readCount;
+static volatile DWORD writeCount;
+static volatile DWORD idleCount;
+static LONGLONG maxWriterWait;
+
+static void work(void)
+{
+    for (int i = 0; i < 200; i++) {
+        sharedData[i & 63] += i;
+    }
+}
+
+static DWORD WINAPI readerThread(LPVOID lpParameter)
+{
+    while (!stop) {
+        ops->acquireShared(&lock);
+        work();
+        SwitchToThread();
+        ops->releaseShared(&lock);
+        readCount++;
+        work();
+    }
+    return 0;
+}
+
+static DWORD WINAPI writerThread(LPVOID lpParameter)
+{
+    while (!stop) {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        ops->acquireExclusive(&lock);
+        QueryPerformanceCounter(&end);
+
+        work();
+        SwitchToThread();
+        ops->releaseExclusive(&lock);
+
+        // Only writers update this, and they do it while holding the lock
+        if (end.QuadPart - start.QuadPart > maxWriterWait) {
+            maxWriterWait = end.QuadPart - start.QuadPart;
+        }
+        writeCount++;
+
+        // Writers come in less often than readers
+        Sleep(1);
+    }
+    return 0;
+}
+
+static DWORD WINAPI idleThread(LPVOID lpParameter)
+{
+    while (!stop) {
+        idleCount++;
+    }
+    return 0;
+}
+
+static void runBenchmark(const LockOps *implementation)
+{
+    HANDLE threads[READERS + WRITERS + 1];
+    int count = 0;
+
+    ops = implementation;
+    InitializeSRWLock(&lock);
+    stop = FALSE;
+    readCount = 0;
+    writeCount = 0;
+    idleCount = 0;
+    maxWriterWait = 0;
+
+    for (int i = 0; i < READERS; i++) {
+        threads[count++] = CreateThread(NULL, 0, readerThread, NULL, 0, NULL);
+    }
+    for (int i = 0; i < WRITERS; i++) {
+        threads[count++] = CreateThread(NULL, 0, writerThread, NULL, 0, NULL);
+    }
+    threads[count] = CreateThread(NULL, 0, idleThread, NULL, CREATE_SUSPENDED, NULL);
+    SetThreadPriority(threads[count], THREAD_PRIORITY_IDLE);
+    ResumeThread(threads[count]);
+    count++;
+
+    Sleep(RUN_TIME_MS);
+    stop = TRUE;
+    WaitForMultipleObjects(count, threads, TRUE, INFINITE);
+    for (int i = 0; i < count; i++) {
+        CloseHandle(threads[i]);
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    debugPrint("%-9s %8lu %8lu %8lu ms %10lu\n",
+               implementation->name,
+               readCount * 1000 / RUN_TIME_MS,
+               writeCount * 1000 / RUN_TIME_MS,
+               (DWORD)(maxWriterWait * 1000 / frequency.QuadPart),
+               idleCount / RUN_TIME_MS);
+}
+
+int main(void)
+{
+    XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
+
+    debugPrint("%d readers, %d writers, %d ms per run\n\n", READERS, WRITERS, RUN_TIME_MS);
+    debugPrint("%-9s %8s %8s %11s %10s\n", "lock", "reads/s", "writes/s", "max wait", "idle/ms");
+
+    for (int round = 0; round < 2; round++) {
+        for (size_t i = 0; i < sizeof(implementations) / sizeof(implementations[0]); i++) {
+            runBenchmark(&implementations[i]);
+        }
+    }
+
+    while (1) {
+        Sleep(2000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: MIT
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+// Compares the export lookup of GetProcAddress with the linear search it
+// replaced, on synthetic export tables laid out like the .edataxb section cxbe
+// produces. The lookup is built from the library's own code in
+// lib/winapi/libloaderapi_internal_.h, the linear search is kept here as the
+// baseline.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The Xbox types, which the library header expects from the includer
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+
+typedef struct _IMAGE_EXPORT_DIRECTORY
+{
+    DWORD Characteristics;
+    DWORD TimeDateStamp;
+    WORD MajorVersion;
+    WORD MinorVersion;
+    DWORD Name;
+    DWORD Base;
+    DWORD NumberOfFunctions;
+    DWORD NumberOfNames;
+    DWORD AddressOfFunctions;
+    DWORD AddressOfNames;
+    DWORD AddressOfNameOrdinals;
+} IMAGE_EXPORT_DIRECTORY, *PIMAGE_EXPORT_DIRECTORY;
+
+#include "../../lib/winapi/libloaderapi_internal_.h"
+
+typedef struct
+{
+    char *image;
+    PIMAGE_EXPORT_DIRECTORY exportdir;
+    char **names;
+} export_table;
+
+static const char *const prefixes[] = {
+    "_SDL_", "_XAudio", "_XVideo", "_pb_", "_Nt", "_Rtl", "_glue_", "_game_",
+};
+
+static int compare_names (const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Builds an export directory with the name table sorted like the linker
+// emits it. Function i has the address 0x1000 + 16 * i. The index at the end
+// keeps the names unique.
+static void build_table (export_table *table, uint32_t count)
+{
+    table->names = malloc(count * sizeof(char *));
+    for (uint32_t i = 0; i < count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%sFunction%08x_%u", prefixes[rand() % 8], (unsigned int)rand() * 2654435761u, (unsigned int)i);
+        table->names[i] = strdup(name);
+    }
+    qsort(table->names, count, sizeof(char *), compare_names);
+
+    size_t size = sizeof(IMAGE_EXPORT_DIRECTORY) + count * (4 + 4 + 2 + 64);
+    table->image = calloc(1, size);
+    table->exportdir = (PIMAGE_EXPORT_DIRECTORY)table->image;
+
+    uint32_t rva = sizeof(IMAGE_EXPORT_DIRECTORY);
+    table->exportdir->Base = 1;
+    table->exportdir->NumberOfFunctions = count;
+    table->exportdir->NumberOfNames = count;
+    table->exportdir->AddressOfFunctions = rva;
+    rva += count * 4;
+    table->exportdir->AddressOfNames = rva;
+    rva += count * 4;
+    table->exportdir->AddressOfNameOrdinals = rva;
+    rva += count * 2;
+
+    uint32_t *proctable = (uint32_t *)(table->image + table->exportdir->AddressOfFunctions);
+    uint32_t *nametable = (uint32_t *)(table->image + table->exportdir->AddressOfNames);
+    uint16_t *ordtable = (uint16_t *)(table->image + table->exportdir->AddressOfNameOrdinals);
+    for (uint32_t i = 0; i < count; i++) {
+        // Ordinals are assigned in a different order than the names
+        uint32_t ordinal = (i * 7919) % count;
+        proctable[ordinal] = 0x1000 + 16 * ordinal;
+        ordtable[i] = ordinal;
+        nametable[i] = rva;
+        strcpy(table->image + rva, table->names[i]);
+        rva += strlen(table->names[i]) + 1;
+    }
+}
+
+static void free_table (export_table *table, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        free(table->names[i]);
+    }
+    free(table->names);
+    free(table->image);
+}
+
+// The lookup GetProcAddress did before, compare every name in turn
+static const void *find_export_linear (const char *base, PIMAGE_EXPORT_DIRECTORY exportdir, const char *procName)
+{
+    for (uint32_t i = 0; i < exportdir->NumberOfNames; i++) {
+        const DWORD *nametable = (const DWORD *)(base + exportdir->AddressOfNames);
+        const char *name_addr = base + nametable[i];
+
+        if (strcmp(procName, name_addr) == 0) {
+            const WORD *ordtable = (const WORD *)(base + exportdir->AddressOfNameOrdinals);
+            return export_address(base, exportdir, ordtable[i]);
+        }
+    }
+
+    return NULL;
+}
+
+typedef const void *(*lookup_func) (const char *base, PIMAGE_EXPORT_DIRECTORY exportdir, const char *procName);
+
+static double now (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Returns the time per lookup in nanoseconds, resolving every name in a
+// shuffled order
+static double measure (const export_table *table, uint32_t count, lookup_func lookup, const uint32_t *order)
+{
+    uint32_t rounds = 1 + (4u << 20) / (count * count / 16 + count);
+    const void *volatile sink = NULL;
+
+    double start = now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < count; i++) {
+            sink = lookup(table->image, table->exportdir, table->names[order[i]]);
+        }
+    }
+    double end = now();
+
+    (void)sink;
+    return (end - start) * 1e9 / ((double)rounds * count);
+}
+
+int main (void)
+{
+    static const uint32_t counts[] = { 16, 64, 256, 1024, 4096, 16384 };
+
+    srand(1);
+    printf("%8s %14s %14s %8s\n", "exports", "linear ns", "binary ns", "speedup");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t count = counts[c];
+        export_table table;
+        build_table(&table, count);
+
+        uint32_t *order = malloc(count * sizeof(uint32_t));
+        for (uint32_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        for (uint32_t i = count - 1; i > 0; i--) {
+            uint32_t j = rand() % (i + 1);
+            uint32_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+
+        // Both lookups have to agree on every name, and on names that
+        // sort before, between and after the exported ones
+        for (uint32_t i = 0; i < count; i++) {
+            const void *expected = find_export_linear(table.image, table.exportdir, table.names[i]);
+            if (expected == NULL || find_export_by_name(table.image, table.exportdir, table.names[i]) != expected) {
+                fprintf(stderr, "lookup mismatch for %s\n", table.names[i]);
+                return 1;
+            }
+        }
+        static const char *const missing[] = { "", "_", "_SDL_Function", "_XVideoZ", "~" };
+        for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+            if (find_export_by_name(table.image, table.exportdir, missing[i]) != NULL) {
+                fprintf(stderr, "found missing export \"%s\"\n", missing[i]);
+                return 1;
+            }
+        }
+
+        double linear = measure(&table, count, find_export_linear, order);
+        double binary = measure(&table, count, find_export_by_name, order);
+        printf("%8u %14.1f %14.1f %7.1fx\n", (unsigned int)count, linear, binary, linear / binary);
+
+        free(order);
+        free_table(&table, count);
+    }
+
+    return 0;
+}
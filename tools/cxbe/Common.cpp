@@ -7,9 +7,12 @@
 #include "Cxbx.h"
 
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
+static bool g_bQuiet = false;
+
 // parse command line
 int ParseOptions(char *argv[], int argc, const Option *options, char *szErrorMessage)
 {
@@ -142,3 +145,37 @@ bool CompareString(const char *szA, const char *szB)
             return false;
     return *szA == *szB;
 }
+
+bool WriteZeros(FILE *file, unsigned int dwCount)
+{
+    static const char bzZeros[0x1000] = { 0 };
+
+    while(dwCount > 0)
+    {
+        unsigned int dwChunk = dwCount < sizeof(bzZeros) ? dwCount : sizeof(bzZeros);
+
+        if(fwrite(bzZeros, dwChunk, 1, file) != 1)
+            return false;
+
+        dwCount -= dwChunk;
+    }
+
+    return true;
+}
+
+int PrintProgress(const char *szFormat, ...)
+{
+    if(g_bQuiet)
+        return 0;
+
+    va_list args;
+    va_start(args, szFormat);
+    int ret = vprintf(szFormat, args);
+    va_end(args);
+    return ret;
+}
+
+void SetQuiet(bool bQuiet)
+{
+    g_bQuiet = bQuiet;
+}
@@ -6,9 +6,14 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdio.h>
+
 #define OPTION_LEN 266
 #define ERROR_LEN 256
 
+// stdio buffer for writing images, small sections are merged into one write
+#define STREAM_BUFFER_SIZE 0x100000
+
 struct Option
 {
     char *value;
@@ -22,4 +27,11 @@ int GenerateFilename(char *szNewPath, const char *szNewExtension, const char *sz
                      const char *szOldExtension);
 bool CompareString(const char *szA, const char *szB);
 
+// write dwCount zero bytes to the file
+bool WriteZeros(FILE *file, unsigned int dwCount);
+
+// printf for progress messages, which SetQuiet() turns off
+int PrintProgress(const char *szFormat, ...);
+void SetQuiet(bool bQuiet);
+
 #endif
@@ -6,6 +6,7 @@
 // SPDX-FileCopyrightText: 2021 Stefan Schmidt
 
 #include "Exe.h"
+#include "Common.h"
 
 #include <algorithm>
 #include <memory.h>
@@ -16,7 +17,7 @@ Exe::Exe(const char *x_szFilename)
 {
     ConstructorInit();
 
-    printf("Exe::Exe: Opening Exe file...");
+    PrintProgress("Exe::Exe: Opening Exe file...");
 
     FILE *ExeFile = fopen(x_szFilename, "rb");
 
@@ -27,11 +28,11 @@ Exe::Exe(const char *x_szFilename)
         goto cleanup;
     }
 
-    printf("OK\n");
+    PrintProgress("OK\n");
 
     // ignore dos stub (if exists)
     {
-        printf("Exe::Exe: Reading DOS stub...");
+        PrintProgress("Exe::Exe: Reading DOS stub...");
 
         if(fread(&m_DOSHeader.m_magic, sizeof(m_DOSHeader.m_magic), 1, ExeFile) != 1)
         {
@@ -41,7 +42,7 @@ Exe::Exe(const char *x_szFilename)
 
         if(m_DOSHeader.m_magic == *(uint16 *)"MZ")
         {
-            printf("Found, Ignoring...");
+            PrintProgress("Found, Ignoring...");
 
             if(fread(&m_DOSHeader.m_cblp, sizeof(m_DOSHeader) - 2, 1, ExeFile) != 1)
             {
@@ -51,17 +52,17 @@ Exe::Exe(const char *x_szFilename)
 
             fseek(ExeFile, m_DOSHeader.m_lfanew, SEEK_SET);
 
-            printf("OK\n");
+            PrintProgress("OK\n");
         }
         else
         {
-            printf("None (OK)\n");
+            PrintProgress("None (OK)\n");
         }
     }
 
     // read PE header
     {
-        printf("Exe::Exe: Reading PE header...");
+        PrintProgress("Exe::Exe: Reading PE header...");
 
         if(fread(&m_Header, sizeof(m_Header), 1, ExeFile) != 1)
         {
@@ -75,12 +76,12 @@ Exe::Exe(const char *x_szFilename)
             goto cleanup;
         }
 
-        printf("OK\n");
+        PrintProgress("OK\n");
     }
 
     // read optional header
     {
-        printf("Exe::Exe: Reading Optional Header...");
+        PrintProgress("Exe::Exe: Reading Optional Header...");
 
         if(fread(&m_OptionalHeader, sizeof(m_OptionalHeader), 1, ExeFile) != 1)
         {
@@ -94,18 +95,18 @@ Exe::Exe(const char *x_szFilename)
             goto cleanup;
         }
 
-        printf("OK\n");
+        PrintProgress("OK\n");
     }
 
     // read section headers
     {
         m_SectionHeader = new SectionHeader[m_Header.m_sections];
 
-        printf("Exe::Exe: Reading Section Headers...\n");
+        PrintProgress("Exe::Exe: Reading Section Headers...\n");
 
         for(uint32 v = 0; v < m_Header.m_sections; v++)
         {
-            printf("Exe::Exe: Reading Section Header 0x%.04X...", v);
+            PrintProgress("Exe::Exe: Reading Section Header 0x%.04X...", v);
 
             if(fread(&m_SectionHeader[v], sizeof(SectionHeader), 1, ExeFile) != 1)
             {
@@ -115,19 +116,19 @@ Exe::Exe(const char *x_szFilename)
                 goto cleanup;
             }
 
-            printf("OK %d\n", v);
+            PrintProgress("OK %d\n", v);
         }
     }
 
     // read sections
     {
-        printf("Exe::Exe: Reading Sections...\n");
+        PrintProgress("Exe::Exe: Reading Sections...\n");
 
         m_bzSection = new uint08 *[m_Header.m_sections];
 
         for(uint32 v = 0; v < m_Header.m_sections; v++)
         {
-            printf("Exe::Exe: Reading Section 0x%.04X...", v);
+            PrintProgress("Exe::Exe: Reading Section 0x%.04X...", v);
 
             uint32 raw_size = m_SectionHeader[v].m_sizeof_raw;
             uint32 raw_addr = m_SectionHeader[v].m_raw_addr;
@@ -140,7 +141,7 @@ Exe::Exe(const char *x_szFilename)
 
             if(raw_size == 0)
             {
-                printf("OK\n");
+                PrintProgress("OK\n");
                 continue;
             }
 
@@ -157,17 +158,17 @@ Exe::Exe(const char *x_szFilename)
                 }
             }
 
-            printf("OK\n");
+            PrintProgress("OK\n");
         }
     }
 
-    printf("Exe::Exe: Exe %s was successfully opened.\n", x_szFilename);
+    PrintProgress("Exe::Exe: Exe %s was successfully opened.\n", x_szFilename);
 
 cleanup:
 
     if(GetError() != 0)
     {
-        printf("FAILED!\n");
+        PrintProgress("FAILED!\n");
         printf("Exe::Exe: ERROR -> %s\n", GetError());
     }
 
@@ -207,7 +208,12 @@ void Exe::Export(const char *x_szExeFilename)
     if(GetError() != 0)
         return;
 
-    printf("Exe::Export: Opening Exe file...");
+    // file offset of the stream, which is written in file order without seeks
+    uint32 Cursor = 0;
+
+    char *bzStream = new char[STREAM_BUFFER_SIZE];
+
+    PrintProgress("Exe::Export: Opening Exe file...");
 
     FILE *ExeFile = fopen(x_szExeFilename, "wb");
 
@@ -218,88 +224,50 @@ void Exe::Export(const char *x_szExeFilename)
         goto cleanup;
     }
 
-    printf("OK\n");
+    setvbuf(ExeFile, bzStream, _IOFBF, STREAM_BUFFER_SIZE);
 
-    // write dos stub
-    {
-        printf("Exe::Export: Writing DOS stub...");
+    PrintProgress("OK\n");
 
-        if(fwrite(bzDOSStub, sizeof(bzDOSStub), 1, ExeFile) != 1)
-        {
-            SetError("Could not write dos stub", false);
-            goto cleanup;
-        }
-
-        printf("OK\n");
-    }
-
-    // write pe header
+    // write headers
     {
-        printf("Exe::Export: Writing PE Header...");
+        PrintProgress("Exe::Export: Writing Headers...");
 
-        if(fwrite(&m_Header, sizeof(Header), 1, ExeFile) != 1)
+        if(fwrite(bzDOSStub, sizeof(bzDOSStub), 1, ExeFile) != 1 ||
+           fwrite(&m_Header, sizeof(Header), 1, ExeFile) != 1 ||
+           fwrite(&m_OptionalHeader, sizeof(OptionalHeader), 1, ExeFile) != 1 ||
+           fwrite(m_SectionHeader, sizeof(SectionHeader), m_Header.m_sections, ExeFile) !=
+               m_Header.m_sections)
         {
-            SetError("Could not write PE header", false);
+            SetError("Could not write PE headers", false);
             goto cleanup;
         }
 
-        printf("OK\n");
-    }
+        Cursor = sizeof(bzDOSStub) + sizeof(Header) + sizeof(OptionalHeader) +
+                 m_Header.m_sections * sizeof(SectionHeader);
 
-    // write optional header
-    {
-        printf("Exe::Export: Writing Optional Header...");
-
-        if(fwrite(&m_OptionalHeader, sizeof(OptionalHeader), 1, ExeFile) != 1)
-        {
-            SetError("Could not write PE optional header", false);
-            goto cleanup;
-        }
-
-        printf("OK\n");
-    }
-
-    // write section header
-    {
-        printf("Exe::Export: Writing Section Headers...\n");
-
-        for(uint32 v = 0; v < m_Header.m_sections; v++)
-        {
-            printf("Exe::Export: Writing Section Header 0x%.04X...", v);
-
-            if(fwrite(&m_SectionHeader[v], sizeof(SectionHeader), 1, ExeFile) != 1)
-            {
-                char buffer[255];
-                snprintf(
-                    buffer, sizeof(buffer), "Could not write PE section header %d (%Xh)", v, v);
-                SetError(buffer, false);
-                goto cleanup;
-            }
-
-            printf("OK\n");
-        }
+        PrintProgress("OK\n");
     }
 
     // write sections
     {
-        printf("Exe::Export: Writing Sections...\n");
+        PrintProgress("Exe::Export: Writing Sections...\n");
 
         for(uint32 v = 0; v < m_Header.m_sections; v++)
         {
-            printf("Exe::Export: Writing Section 0x%.04X...", v);
+            PrintProgress("Exe::Export: Writing Section 0x%.04X...", v);
 
             uint32 RawSize = m_SectionHeader[v].m_sizeof_raw;
             uint32 RawAddr = m_SectionHeader[v].m_raw_addr;
 
-            fseek(ExeFile, RawAddr, SEEK_SET);
-
             if(RawSize == 0)
             {
-                printf("OK\n");
+                PrintProgress("OK\n");
                 continue;
             }
 
-            if(fwrite(m_bzSection[v], RawSize, 1, ExeFile) != 1)
+            // the stream can't go back, so sections must be in file order
+            if(RawAddr < Cursor || !WriteZeros(ExeFile, RawAddr - Cursor) ||
+               fwrite(m_bzSection[v], RawSize, 1, ExeFile) != 1)
             {
                 char buffer[255];
                 snprintf(buffer, sizeof(buffer), "Could not write PE section %d (%Xh)", v, v);
@@ -307,24 +275,27 @@ void Exe::Export(const char *x_szExeFilename)
                 goto cleanup;
             }
 
-            fflush(ExeFile);
+            Cursor = RawAddr + RawSize;
 
-            printf("OK\n");
+            PrintProgress("OK\n");
         }
     }
 
 cleanup:
 
-    if(GetError() != 0)
+    if(ExeFile != NULL)
     {
-        printf("FAILED!\n");
-        printf("Exe::Export: ERROR -> %s\n", GetError());
+        if(fclose(ExeFile) != 0 && GetError() == 0)
+            SetError("Could not write Exe file", false);
+        ExeFile = NULL;
     }
 
-    if(ExeFile != NULL)
+    delete[] bzStream;
+
+    if(GetError() != 0)
     {
-        fclose(ExeFile);
-        ExeFile = NULL;
+        PrintProgress("FAILED!\n");
+        printf("Exe::Export: ERROR -> %s\n", GetError());
     }
 
     return;
@@ -22,6 +22,8 @@ int main(int argc, char *argv[])
     char szMode[OPTION_LEN + 1] = "retail";
     char szLogo[OPTION_LEN + 1] = "";
     char szDebugPath[OPTION_LEN + 1] = "";
+    char szNoPreload[OPTION_LEN + 1] = "";
+    char szQuiet[OPTION_LEN + 1] = "no";
     bool bRetail;
 
     const char *program = argv[0];
@@ -30,7 +32,8 @@ int main(int argc, char *argv[])
         { szExeFilename, NULL, "exefile" },         { szXbeFilename, "OUT", "filename" },
         { szDumpFilename, "DUMPINFO", "filename" }, { szXbeTitle, "TITLE", "title" },
         { szMode, "MODE", "{debug|retail}" },       { szLogo, "LOGO", "filename" },
-        { szDebugPath, "DEBUGPATH", "path" },       { NULL }
+        { szDebugPath, "DEBUGPATH", "path" },       { szNoPreload, "NOPRELOAD", "section[,section...]" },
+        { szQuiet, "QUIET", "{yes|no}" },           { NULL }
     };
 
     if(ParseOptions(argv, argc, options, szErrorMessage))
@@ -48,6 +51,14 @@ int main(int argc, char *argv[])
         goto cleanup;
     }
 
+    if(CompareString(szQuiet, "YES"))
+        SetQuiet(true);
+    else if(!CompareString(szQuiet, "NO"))
+    {
+        strncpy(szErrorMessage, "invalid QUIET", ERROR_LEN);
+        goto cleanup;
+    }
+
     if(strlen(szXbeTitle) > 40)
     {
         printf("WARNING: Title too long, trimming\n");
@@ -90,7 +101,24 @@ int main(int argc, char *argv[])
             LogoPtr = &logo;
         }
 
-        Xbe *XbeFile = new Xbe(ExeFile, szXbeTitle, bRetail, LogoPtr, szDebugPath);
+        // sections listed here are not loaded at boot, but with XeLoadSection
+        std::vector<std::string> NoPreloadSections;
+        for(char *szSection = strtok(szNoPreload, ","); szSection != NULL; szSection = strtok(NULL, ","))
+        {
+            bool bFound = false;
+            for(uint32 v = 0; v < ExeFile->m_Header.m_sections; v++)
+            {
+                if(strncmp(szSection, (const char *)ExeFile->m_SectionHeader[v].m_name, 8) == 0)
+                    bFound = true;
+            }
+
+            if(!bFound)
+                printf("WARNING: Section %s not found, ignoring NOPRELOAD\n", szSection);
+
+            NoPreloadSections.push_back(szSection);
+        }
+
+        Xbe *XbeFile = new Xbe(ExeFile, szXbeTitle, bRetail, LogoPtr, szDebugPath, &NoPreloadSections);
 
         if(XbeFile->GetError() != 0)
         {
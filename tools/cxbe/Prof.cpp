@@ -0,0 +1,393 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// SPDX-FileCopyrightText: 2026 nxdk Contributors
+
+// nxprof turns the samples written by nxProfilerSave into folded stacks
+// ("outer;inner count" per line), the input format of flamegraph.pl and
+// compatible viewers. Neither the EXE nor the XBE carry a symbol table, so
+// symbols are read from the linker map (-map:<file> for lld-link). Addresses
+// without a symbol are reported relative to their EXE section.
+//
+// With -ORDER, it also writes the sampled functions, hottest first, as a
+// function order file for lld-link (-order:@<file>), which packs them into
+// as few pages as possible when the code is built with -ffunction-sections.
+// The folded stacks are then only written if -OUT is given.
+
+#include "Common.h"
+#include "Exe.h"
+
+#include "../../lib/nxdk/profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct Symbol
+{
+    uint32 m_address;
+    std::string m_name;
+    // name as seen by the linker, with underscore or C++ mangling
+    std::string m_linkName;
+    bool m_bFunction;
+
+    bool operator<(const Symbol &other) const
+    {
+        return m_address < other.m_address;
+    }
+};
+
+// parse the "Publics by Value" and "Static symbols" tables of a link.exe
+// compatible map file, which contain lines like:
+// " 0001:00000000       _main                      00011000 f   main.obj"
+static bool LoadMap(const char *szFilename, std::vector<Symbol> &symbols)
+{
+    FILE *file = fopen(szFilename, "rt");
+    if(file == NULL)
+        return false;
+
+    char szLine[1024];
+    bool bInTable = false;
+    while(fgets(szLine, sizeof(szLine), file))
+    {
+        if(strstr(szLine, "Publics by Value") || strstr(szLine, "Static symbols"))
+        {
+            bInTable = true;
+            continue;
+        }
+
+        if(!bInTable)
+            continue;
+
+        unsigned int section, offset, address;
+        char szName[512];
+        char szFlag[8] = { 0 };
+        if(sscanf(szLine, " %x:%x %511s %x %7s", &section, &offset, szName, &address, szFlag) < 4)
+            continue;
+
+        // absolute symbols aren't code
+        if(section == 0)
+            continue;
+
+        Symbol symbol;
+        symbol.m_address = address;
+        // strip the underscore of C symbols, C++ symbols keep their mangling
+        symbol.m_name = (szName[0] == '_') ? &szName[1] : szName;
+        symbol.m_linkName = szName;
+        // functions are flagged with "f" in front of the object file name
+        symbol.m_bFunction = strcmp(szFlag, "f") == 0;
+        symbols.push_back(symbol);
+    }
+
+    fclose(file);
+
+    std::sort(symbols.begin(), symbols.end());
+    return true;
+}
+
+// find the EXE section of an address, returns NULL if there is none
+static const Exe::SectionHeader *FindSection(uint32 address, const Exe *ExeFile, uint32 *start)
+{
+    if(ExeFile == NULL)
+        return NULL;
+
+    for(uint32 v = 0; v < ExeFile->m_Header.m_sections; v++)
+    {
+        const Exe::SectionHeader &section = ExeFile->m_SectionHeader[v];
+        *start = ExeFile->m_OptionalHeader.m_image_base + section.m_virtual_addr;
+
+        if(address >= *start && address - *start < section.m_virtual_size)
+            return &section;
+    }
+
+    return NULL;
+}
+
+// find the symbol an address belongs to, returns -1 if there is none
+static int FindSymbol(uint32 address, const std::vector<Symbol> &symbols, const Exe *ExeFile)
+{
+    // use the section of the address to reject symbols of preceding sections
+    uint32 sectionStart = 0;
+    FindSection(address, ExeFile, &sectionStart);
+
+    Symbol key;
+    key.m_address = address;
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), key);
+    if(it != symbols.begin() && (it - 1)->m_address >= sectionStart)
+        return (int)(it - 1 - symbols.begin());
+
+    return -1;
+}
+
+static std::string Symbolize(uint32 address, const std::vector<Symbol> &symbols, const Exe *ExeFile)
+{
+    char szBuffer[64];
+
+    int symbol = FindSymbol(address, symbols, ExeFile);
+    if(symbol >= 0)
+        return symbols[symbol].m_name;
+
+    uint32 sectionStart = 0;
+    const Exe::SectionHeader *section = FindSection(address, ExeFile, &sectionStart);
+    char szSection[9] = { 0 };
+    if(section != NULL)
+        memcpy(szSection, section->m_name, 8);
+
+    if(section != NULL)
+        snprintf(szBuffer, sizeof(szBuffer), "[%s+0x%x]", szSection, address - sectionStart);
+    else
+        snprintf(szBuffer, sizeof(szBuffer), "[0x%08x]", address);
+
+    return szBuffer;
+}
+
+// size of a symbol, up to the next symbol or the end of its section
+static uint32 SymbolSize(size_t v, const std::vector<Symbol> &symbols, const Exe *ExeFile)
+{
+    uint32 address = symbols[v].m_address;
+    uint32 end = (v + 1 < symbols.size()) ? symbols[v + 1].m_address : address + 1;
+
+    uint32 sectionStart = 0;
+    const Exe::SectionHeader *section = FindSection(address, ExeFile, &sectionStart);
+    if(section != NULL && end - sectionStart > section->m_virtual_size)
+        end = sectionStart + section->m_virtual_size;
+
+    return end - address;
+}
+
+// write the sampled functions as an lld-link order file, hottest first
+static bool WriteOrder(const char *szFilename, const std::vector<Symbol> &symbols, const Exe *ExeFile,
+                       const std::vector<uint32> &selfCounts, const std::vector<uint32> &totalCounts)
+{
+    // maps without function flags can't tell code from data
+    bool bAnyFunction = false;
+    for(const Symbol &symbol : symbols)
+        bAnyFunction |= symbol.m_bFunction;
+
+    std::vector<size_t> hot;
+    for(size_t v = 0; v < symbols.size(); v++)
+    {
+        if(totalCounts[v] != 0 && (symbols[v].m_bFunction || !bAnyFunction))
+            hot.push_back(v);
+    }
+
+    // functions running themselves come first, callers by how often they
+    // were on the stack, ties keep the current layout
+    std::sort(hot.begin(), hot.end(), [&](size_t a, size_t b) {
+        if(selfCounts[a] != selfCounts[b])
+            return selfCounts[a] > selfCounts[b];
+        if(totalCounts[a] != totalCounts[b])
+            return totalCounts[a] > totalCounts[b];
+        return a < b;
+    });
+
+    FILE *outfile = fopen(szFilename, "wt");
+    if(outfile == NULL)
+        return false;
+
+    // pages spanned by the hot functions now, and packed back to back with
+    // the 16 byte function alignment of clang
+    std::set<uint32> pages;
+    uint32 packedSize = 0;
+    for(size_t v : hot)
+    {
+        fprintf(outfile, "%s\n", symbols[v].m_linkName.c_str());
+
+        uint32 address = symbols[v].m_address;
+        uint32 size = SymbolSize(v, symbols, ExeFile);
+        for(uint32 page = address / 0x1000; size != 0 && page <= (address + size - 1) / 0x1000; page++)
+            pages.insert(page);
+
+        packedSize += RoundUp(size, 16);
+    }
+
+    if(fclose(outfile) != 0)
+        return false;
+
+    fprintf(stderr, "nxprof: %u sampled functions span %u code pages, %u when ordered\n",
+            (unsigned int)hot.size(), (unsigned int)pages.size(),
+            (unsigned int)RoundUp(packedSize, 0x1000) / 0x1000);
+
+    return true;
+}
+
+// program entry point
+int main(int argc, char *argv[])
+{
+    char szErrorMessage[ERROR_LEN + 1] = { 0 };
+    char szProfFilename[OPTION_LEN + 1] = { 0 };
+    char szMapFilename[OPTION_LEN + 1] = { 0 };
+    char szExeFilename[OPTION_LEN + 1] = { 0 };
+    char szOutFilename[OPTION_LEN + 1] = { 0 };
+    char szOrderFilename[OPTION_LEN + 1] = { 0 };
+
+    const char *program = argv[0];
+    const char *program_desc = "nxprof nxdk profiler sample symbolizer (Version: " VERSION ")";
+    Option options[] = {
+        { szProfFilename, NULL, "proffile" }, { szMapFilename, "MAP", "filename" },
+        { szExeFilename, "EXE", "filename" }, { szOutFilename, "OUT", "filename" },
+        { szOrderFilename, "ORDER", "filename" }, { NULL }
+    };
+
+    std::vector<Symbol> symbols;
+    std::map<std::string, uint32> stacks;
+    // samples a symbol was running in, and was anywhere on the stack in
+    std::vector<uint32> selfCounts, totalCounts, lastSample;
+    Exe *ExeFile = NULL;
+    FILE *infile = NULL;
+    FILE *outfile = stdout;
+
+    if(ParseOptions(argv, argc, options, szErrorMessage))
+    {
+        goto cleanup;
+    }
+
+    if(szProfFilename[0] == '\0')
+    {
+        ShowUsage(program, program_desc, options);
+        return 1;
+    }
+
+    if(szMapFilename[0] != '\0' && !LoadMap(szMapFilename, symbols))
+    {
+        strncpy(szErrorMessage, "Could not open map file", ERROR_LEN);
+        goto cleanup;
+    }
+
+    if(szExeFilename[0] != '\0')
+    {
+        // the stacks may go to stdout, keep the loading progress out of them
+        SetQuiet(true);
+        ExeFile = new Exe(szExeFilename);
+
+        if(ExeFile->GetError() != 0)
+        {
+            strncpy(szErrorMessage, ExeFile->GetError(), ERROR_LEN);
+            goto cleanup;
+        }
+    }
+
+    if(szOrderFilename[0] != '\0' && symbols.empty())
+    {
+        strncpy(szErrorMessage, "Function order requires a map file", ERROR_LEN);
+        goto cleanup;
+    }
+
+    selfCounts.resize(symbols.size());
+    totalCounts.resize(symbols.size());
+    lastSample.resize(symbols.size(), UINT32_MAX);
+
+    infile = fopen(szProfFilename, "rb");
+    if(infile == NULL)
+    {
+        strncpy(szErrorMessage, "Could not open sample file", ERROR_LEN);
+        goto cleanup;
+    }
+
+    // fold the samples, outermost frame first
+    {
+        nx_profiler_file_header_t header;
+        if(fread(&header, sizeof(header), 1, infile) != 1 || header.magic != NX_PROFILER_MAGIC ||
+           header.version != NX_PROFILER_VERSION || header.maxDepth == 0)
+        {
+            strncpy(szErrorMessage, "Invalid sample file", ERROR_LEN);
+            goto cleanup;
+        }
+
+        std::vector<uint32> sample(1 + header.maxDepth);
+        for(uint32 v = 0; v < header.sampleCount; v++)
+        {
+            if(fread(sample.data(), sizeof(uint32), sample.size(), infile) != sample.size())
+            {
+                strncpy(szErrorMessage, "Truncated sample file", ERROR_LEN);
+                goto cleanup;
+            }
+
+            uint32 depth = std::min(sample[0], header.maxDepth);
+            std::string stack;
+            if(depth == 0)
+                stack = "[kernel]";
+
+            for(uint32 d = depth; d > 0; d--)
+            {
+                // return addresses point behind the call, the innermost
+                // address is the interrupted instruction itself
+                uint32 address = sample[d];
+                if(d > 1)
+                    address--;
+
+                if(!stack.empty())
+                    stack += ';';
+                stack += Symbolize(address, symbols, ExeFile);
+
+                // recursion must not count a function more than once
+                int symbol = FindSymbol(address, symbols, ExeFile);
+                if(symbol >= 0)
+                {
+                    if(d == 1)
+                        selfCounts[symbol]++;
+                    if(lastSample[symbol] != v)
+                        totalCounts[symbol]++;
+                    lastSample[symbol] = v;
+                }
+            }
+
+            stacks[stack]++;
+        }
+
+        if(header.droppedCount != 0)
+            fprintf(stderr, "nxprof: %u older samples were overwritten\n", header.droppedCount);
+    }
+
+    if(szOrderFilename[0] != '\0')
+    {
+        if(!WriteOrder(szOrderFilename, symbols, ExeFile, selfCounts, totalCounts))
+        {
+            strncpy(szErrorMessage, "Could not write order file", ERROR_LEN);
+            goto cleanup;
+        }
+
+        // the order file was asked for, don't flood stdout with stacks
+        if(szOutFilename[0] == '\0')
+            goto cleanup;
+    }
+
+    if(szOutFilename[0] != '\0')
+    {
+        outfile = fopen(szOutFilename, "wt");
+        if(outfile == NULL)
+        {
+            outfile = stdout;
+            strncpy(szErrorMessage, "Could not open output file", ERROR_LEN);
+            goto cleanup;
+        }
+    }
+
+    for(const auto &stack : stacks)
+        fprintf(outfile, "%s %u\n", stack.first.c_str(), stack.second);
+
+cleanup:
+
+    if(infile != NULL)
+        fclose(infile);
+
+    if(outfile != stdout)
+        fclose(outfile);
+
+    delete ExeFile;
+
+    if(szErrorMessage[0] != 0)
+    {
+        ShowUsage(program, program_desc, options);
+
+        printf("\n");
+        printf(" *  Error : %s\n", szErrorMessage);
+
+        return 1;
+    }
+
+    return 0;
+}
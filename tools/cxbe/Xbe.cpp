@@ -7,6 +7,7 @@
 // SPDX-FileCopyrightText: 2019 Jannik Vogel
 
 #include "Xbe.h"
+#include "Common.h"
 #include "Exe.h"
 
 #include <algorithm>
@@ -20,6 +21,15 @@
 static const char kKernelImageName[] = "xboxkrnl.exe";
 static uint32 CountNonKernelImportTableEntries(class Exe *x_Exe, uint32_t *extra_bytes);
 
+// size of the raw data up to its last non-zero byte, word aligned
+static uint32 TrimmedRawSize(const uint08 *x_bzData, uint32 x_dwSize)
+{
+    while(x_dwSize > 0 && x_bzData[x_dwSize - 1] == 0)
+        x_dwSize--;
+
+    return RoundUp(x_dwSize, 4);
+}
+
 static size_t BasenameOffset(const std::string &path)
 {
     size_t sep_offset = path.find_last_of("/\\");
@@ -33,7 +43,7 @@ static size_t BasenameOffset(const std::string &path)
 
 // construct via Exe file object
 Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vector<uint08> *logo,
-         const char *x_szDebugPath)
+         const char *x_szDebugPath, const std::vector<std::string> *x_NoPreloadSections)
 {
     ConstructorInit();
 
@@ -41,7 +51,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
     time(&CurrentTime);
 
-    printf("Xbe::Xbe: Pass 1 (Simple Pass)...");
+    PrintProgress("Xbe::Xbe: Pass 1 (Simple Pass)...");
     std::string debug_path = x_szDebugPath;
 
     // pass 1
@@ -94,9 +104,9 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
         m_Header.dwXAPILibraryVersionAddr = 0;
     }
 
-    printf("OK\n");
+    PrintProgress("OK\n");
 
-    printf("Xbe::Xbe: Pass 2 (Calculating Requirements)...");
+    PrintProgress("Xbe::Xbe: Pass 2 (Calculating Requirements)...");
 
     // pass 2
     uint32 non_kernel_import_table_bytes = 0;
@@ -206,9 +216,9 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
         m_Header.dwSizeofHeaders = mrc - m_Header.dwBaseAddr;
     }
 
-    printf("OK\n");
+    PrintProgress("OK\n");
 
-    printf("Xbe::Xbe: Pass 3 (Generating Xbe)...\n");
+    PrintProgress("Xbe::Xbe: Pass 3 (Generating Xbe)...\n");
 
     // pass 3
     {
@@ -217,7 +227,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
         // encode entry point
         {
-            printf("Xbe::Xbe: Encoding %s Entry Point...", x_bRetail ? "Retail" : "Debug");
+            PrintProgress("Xbe::Xbe: Encoding %s Entry Point...", x_bRetail ? "Retail" : "Debug");
 
             uint32 ep = x_Exe->m_OptionalHeader.m_entry + m_Header.dwPeBaseAddr;
 
@@ -228,11 +238,11 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
             m_Header.dwEntryAddr = ep;
 
-            printf("OK (0x%.08X)\n", ep);
+            PrintProgress("OK (0x%.08X)\n", ep);
         }
 
         {
-            printf("Xbe::Xbe: Relocating TLS directory...");
+            PrintProgress("Xbe::Xbe: Relocating TLS directory...");
 
             uint32 tls_directory =
                 x_Exe->m_OptionalHeader.m_image_data_directory[IMAGE_DIRECTORY_ENTRY_TLS]
@@ -242,7 +252,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
             else
                 m_Header.dwTLSAddr = tls_directory + m_Header.dwPeBaseAddr;
 
-            printf("OK (0x%.08X)\n", m_Header.dwTLSAddr);
+            PrintProgress("OK (0x%.08X)\n", m_Header.dwTLSAddr);
         }
 
         // header write cursor
@@ -251,14 +261,14 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
         // check if we need to store extra header bytes (we always will)
         if(m_Header.dwSizeofHeaders > sizeof(m_Header))
         {
-            printf("Xbe::Xbe: Found Extra Header Bytes...");
+            PrintProgress("Xbe::Xbe: Found Extra Header Bytes...");
 
             uint32 ExSize = RoundUp(m_Header.dwSizeofHeaders - sizeof(m_Header), 0x1000);
 
             m_HeaderEx = new char[ExSize];
             memset(m_HeaderEx, 0, ExSize);
 
-            printf("OK\n");
+            PrintProgress("OK\n");
         }
 
         // start a write buffer inside of m_HeaderEx
@@ -351,6 +361,9 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
             uint32 SectionCursor = RoundUp(m_Header.dwSizeofHeaders, 0x1000);
 
+            // page aligned raw data of the Exe sections, to report what the layout saves
+            uint32 ExeRawBytes = 0;
+
             // head/tail reference count write buffer
             uint16 *htrc = (uint16 *)(szBuffer + m_Header.dwSections * sizeof(*m_SectionHeader));
 
@@ -363,11 +376,11 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
             // section write cursor
             uint32 hwc_secn = hwc_htrc + (m_Header.dwSections + 1) * 2;
 
-            printf("Xbe::Xbe: Generating Section Headers...\n");
+            PrintProgress("Xbe::Xbe: Generating Section Headers...\n");
 
             for(uint32 v = 0; v < m_Header.dwSections; v++)
             {
-                printf("Xbe::Xbe: Generating Section Header %.04X...", v);
+                PrintProgress("Xbe::Xbe: Generating Section Header %.04X...", v);
 
                 uint32 characteristics = x_Exe->m_SectionHeader[v].m_characteristics;
 
@@ -380,28 +393,36 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
                    (characteristics & IMAGE_SCN_CNT_CODE))
                     m_SectionHeader[v].dwFlags.bExecutable = true;
 
-                m_SectionHeader[v].dwFlags.bPreload = true;
-                m_SectionHeader[v].dwVirtualAddr =
-                    x_Exe->m_SectionHeader[v].m_virtual_addr + m_Header.dwPeBaseAddr;
+                // sections which are loaded on demand with XeLoadSection
+                {
+                    std::string name((const char *)x_Exe->m_SectionHeader[v].m_name,
+                                     strnlen((const char *)x_Exe->m_SectionHeader[v].m_name, 8));
 
-                m_SectionHeader[v].dwRawAddr = SectionCursor;
+                    bool bPreload = true;
+                    if(x_NoPreloadSections != nullptr)
+                        bPreload = std::find(x_NoPreloadSections->begin(), x_NoPreloadSections->end(),
+                                             name) == x_NoPreloadSections->end();
 
-                // calculate sizeof_raw by locating the last non-zero value in the raw section data
-                {
-                    uint32 r = x_Exe->m_SectionHeader[v].m_sizeof_raw;
-                    if(r > 0)
+                    uint32 entry = x_Exe->m_OptionalHeader.m_entry;
+                    uint32 start = x_Exe->m_SectionHeader[v].m_virtual_addr;
+                    if(!bPreload && entry >= start && entry - start < x_Exe->m_SectionHeader[v].m_virtual_size)
                     {
-                        r--;
-                        while(r > 0)
-                        {
-                            if(x_Exe->m_bzSection[v][r--] != 0)
-                                break;
-                        }
+                        PrintProgress("\n");
+                        SetError("The section containing the entry point must be preloaded", true);
+                        goto cleanup;
                     }
 
-                    // word aligned
-                    m_SectionHeader[v].dwSizeofRaw = RoundUp(r + 2, 4);
+                    m_SectionHeader[v].dwFlags.bPreload = bPreload;
                 }
+                m_SectionHeader[v].dwVirtualAddr =
+                    x_Exe->m_SectionHeader[v].m_virtual_addr + m_Header.dwPeBaseAddr;
+
+                m_SectionHeader[v].dwRawAddr = SectionCursor;
+
+                // the loader zero fills sections up to their virtual size, so trailing
+                // zeros are left out of the file (sections without data take no space)
+                m_SectionHeader[v].dwSizeofRaw =
+                    TrimmedRawSize(x_Exe->m_bzSection[v], x_Exe->m_SectionHeader[v].m_sizeof_raw);
 
                 // calculate virtual size
                 if(v < m_Header.dwSections - 1)
@@ -419,6 +440,8 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
                 SectionCursor += RoundUp(m_SectionHeader[v].dwSizeofRaw, 0x1000);
 
+                ExeRawBytes += RoundUp(x_Exe->m_SectionHeader[v].m_sizeof_raw, 0x1000);
+
                 // head/tail reference count
                 {
                     m_SectionHeader[v].dwHeadSharedRefCountAddr = hwc_htrc;
@@ -459,11 +482,16 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
                 szBuffer += sizeof(*m_SectionHeader);
 
-                printf("OK\n");
+                PrintProgress("OK\n");
             }
 
             hwc = hwc_secn;
             szBuffer = m_HeaderEx + hwc - (m_Header.dwBaseAddr + sizeof(m_Header));
+
+            uint32 XbeRawBytes = SectionCursor - RoundUp(m_Header.dwSizeofHeaders, 0x1000);
+
+            PrintProgress("Xbe::Xbe: Section data takes 0x%.08X bytes (0x%.08X bytes saved)\n",
+                          XbeRawBytes, ExeRawBytes - std::min(ExeRawBytes, XbeRawBytes));
         }
 
         // Reserve space for the non-kernel import table.
@@ -517,25 +545,25 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
         }
 
         {
-            printf("Xbe::Xbe: Generating Logo Bitmap...");
+            PrintProgress("Xbe::Xbe: Generating Logo Bitmap...");
 
             uint08 *RawAddr = GetAddr(m_Header.dwLogoBitmapAddr);
 
             if(logo)
             {
                 memcpy(RawAddr, logo->data(), logo->size());
-                printf("OK (custom)\n");
+                PrintProgress("OK (custom)\n");
             }
             else
             {
                 memcpy(RawAddr, defaultXbeLogo, defaultXbeLogoSize);
-                printf("OK (default)\n");
+                PrintProgress("OK (default)\n");
             }
         }
 
         // write sections
         {
-            printf("Xbe::Xbe: Generating Sections...\n");
+            PrintProgress("Xbe::Xbe: Generating Sections...\n");
 
             m_bzSection = new uint08 *[m_Header.dwSections];
 
@@ -543,7 +571,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
             for(uint32 v = 0; v < m_Header.dwSections; v++)
             {
-                printf("Xbe::Xbe: Generating Section %.04X...", v);
+                PrintProgress("Xbe::Xbe: Generating Section %.04X...", v);
 
                 uint32 RawSize = m_SectionHeader[v].dwSizeofRaw;
                 uint32 VirtSize = m_SectionHeader[v].dwVirtualSize;
@@ -555,7 +583,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
                 memcpy(m_bzSection[v], x_Exe->m_bzSection[v], RawSize);
 
-                printf("OK\n");
+                PrintProgress("OK\n");
             }
         }
 
@@ -566,7 +594,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
         }
     }
 
-    printf("Xbe::Xbe: Pass 4 (Finalizing)...\n");
+    PrintProgress("Xbe::Xbe: Pass 4 (Finalizing)...\n");
 
     // pass 4
     {
@@ -587,7 +615,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
 
         // relocate to base : 0x00010000
         {
-            printf("Xbe::Xbe: Relocating to Base 0x00010000...");
+            PrintProgress("Xbe::Xbe: Relocating to Base 0x00010000...");
 
             uint32 fixCount = 0;
 
@@ -647,7 +675,7 @@ Xbe::Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail, const std::vec
                 }
             }
 
-            printf("OK (%d Fixups)\n", fixCount);
+            PrintProgress("OK (%d Fixups)\n", fixCount);
         }
     }
 
@@ -655,7 +683,7 @@ cleanup:
 
     if(GetError() != 0)
     {
-        printf("FAILED!\n");
+        PrintProgress("FAILED!\n");
         printf("Xbe::Xbe: ERROR -> %s\n", GetError());
     }
 }
@@ -688,7 +716,25 @@ void Xbe::Export(const char *x_szXbeFilename)
 
     char szBuffer[260];
 
-    printf("Xbe::Export: Writing Xbe file...");
+    uint32 CertificateAddr = m_Header.dwCertificateAddr - m_Header.dwBaseAddr;
+    uint32 SectionHeadersAddr = m_Header.dwSectionHeadersAddr - m_Header.dwBaseAddr;
+    uint32 SectionHeadersSize = m_Header.dwSections * sizeof(*m_SectionHeader);
+
+    // the headers are put together in memory, everything else is streamed in
+    // file order, so there are no seeks and only a few large writes
+    uint32 HeadersSize = m_Header.dwSizeofHeaders;
+    HeadersSize = std::max(HeadersSize, CertificateAddr + (uint32)sizeof(m_Certificate));
+    HeadersSize = std::max(HeadersSize, SectionHeadersAddr + SectionHeadersSize);
+
+    uint08 *bzHeaders = new uint08[HeadersSize];
+    memset(bzHeaders, 0, HeadersSize);
+
+    // file offset of the stream, the end of the data written so far
+    uint32 Cursor = 0;
+
+    char *bzStream = new char[STREAM_BUFFER_SIZE];
+
+    PrintProgress("Xbe::Export: Writing Xbe file...");
 
     FILE *XbeFile = fopen(x_szXbeFilename, "wb");
 
@@ -699,88 +745,67 @@ void Xbe::Export(const char *x_szXbeFilename)
         goto cleanup;
     }
 
-    printf("OK\n");
+    setvbuf(XbeFile, bzStream, _IOFBF, STREAM_BUFFER_SIZE);
+
+    PrintProgress("OK\n");
 
     // write Xbe image header
     {
-        printf("Xbe::Export: Writing Image Header...");
+        PrintProgress("Xbe::Export: Writing Image Header...");
 
-        if(fwrite(&m_Header, sizeof(m_Header), 1, XbeFile) != 1)
-        {
-            SetError("Unexpected write error while writing Xbe Image Header", false);
-            goto cleanup;
-        }
-
-        printf("OK\n");
-
-        printf("Xbe::Export: Writing Image Header Extra Bytes...");
-
-        if(fwrite(m_HeaderEx, m_Header.dwSizeofHeaders, 1, XbeFile) != 1)
-        {
-            SetError("Unexpected write error while writing Xbe Image Header (Ex)", false);
-            goto cleanup;
-        }
+        memcpy(&bzHeaders[0], &m_Header, sizeof(m_Header));
+        memcpy(&bzHeaders[sizeof(m_Header)], m_HeaderEx,
+               m_Header.dwSizeofHeaders - sizeof(m_Header));
 
-        printf("OK\n");
+        PrintProgress("OK\n");
     }
 
     // write Xbe certificate
     {
-        printf("Xbe::Export: Writing Certificate...");
-
-        fseek(XbeFile, m_Header.dwCertificateAddr - m_Header.dwBaseAddr, SEEK_SET);
+        PrintProgress("Xbe::Export: Writing Certificate...");
 
-        if(fwrite(&m_Certificate, sizeof(m_Certificate), 1, XbeFile) != 1)
-        {
-            SetError("Unexpected write error while writing Xbe Certificate", false);
-            goto cleanup;
-        }
+        memcpy(&bzHeaders[CertificateAddr], &m_Certificate, sizeof(m_Certificate));
 
-        printf("OK\n");
+        PrintProgress("OK\n");
     }
 
     // write Xbe section headers
     {
-        printf("Xbe::Export: Writing Section Headers...\n");
+        PrintProgress("Xbe::Export: Writing Section Headers...");
 
-        fseek(XbeFile, m_Header.dwSectionHeadersAddr - m_Header.dwBaseAddr, SEEK_SET);
+        memcpy(&bzHeaders[SectionHeadersAddr], m_SectionHeader, SectionHeadersSize);
 
-        for(uint32 v = 0; v < m_Header.dwSections; v++)
+        if(fwrite(bzHeaders, HeadersSize, 1, XbeFile) != 1)
         {
-            printf("Xbe::Export: Writing Section Header 0x%.04X...", v);
+            SetError("Unexpected write error while writing Xbe Image Header", false);
+            goto cleanup;
+        }
 
-            if(fwrite(&m_SectionHeader[v], sizeof(*m_SectionHeader), 1, XbeFile) != 1)
-            {
-                snprintf(szBuffer, sizeof(szBuffer),
-                         "Unexpected write error while writing Xbe Section %d (%Xh)", v, v);
-                SetError(szBuffer, false);
-                goto cleanup;
-            }
+        Cursor = HeadersSize;
 
-            printf("OK\n");
-        }
+        PrintProgress("OK\n");
     }
 
     // write Xbe sections
     {
-        printf("Xbe::Export: Writing Sections...\n");
+        PrintProgress("Xbe::Export: Writing Sections...\n");
 
         for(uint32 v = 0; v < m_Header.dwSections; v++)
         {
-            printf("Xbe::Export: Writing Section 0x%.04X (%s)...", v, m_szSectionName[v]);
+            PrintProgress("Xbe::Export: Writing Section 0x%.04X (%s)...", v, m_szSectionName[v]);
 
             uint32 RawSize = m_SectionHeader[v].dwSizeofRaw;
             uint32 RawAddr = m_SectionHeader[v].dwRawAddr;
 
-            fseek(XbeFile, RawAddr, SEEK_SET);
-
             if(RawSize == 0)
             {
-                printf("OK\n");
+                PrintProgress("OK\n");
                 continue;
             }
 
-            if(fwrite(m_bzSection[v], RawSize, 1, XbeFile) != 1)
+            // sections are laid out in ascending order by the constructor
+            if(RawAddr < Cursor || !WriteZeros(XbeFile, RawAddr - Cursor) ||
+               fwrite(m_bzSection[v], RawSize, 1, XbeFile) != 1)
             {
                 snprintf(szBuffer, sizeof(szBuffer),
                          "Unexpected write error while writing Xbe Section %d (%Xh) (%s)", v, v,
@@ -789,53 +814,48 @@ void Xbe::Export(const char *x_szXbeFilename)
                 goto cleanup;
             }
 
-            printf("OK\n");
+            Cursor = RawAddr + RawSize;
+
+            PrintProgress("OK\n");
         }
     }
 
     // zero pad
     {
-        printf("Xbe::Export: Writing Zero Padding...");
-
-        fpos_t pos;
+        PrintProgress("Xbe::Export: Writing Zero Padding...");
 
-        uint32 remaining = 0;
+        // sections without raw data have nothing in the file to pad
+        uint32 PadEnd = Cursor + 0x1000 - Cursor % 0x1000;
 
-        fgetpos(XbeFile, &pos);
-
-        remaining = (uint32)(0x1000 - ftell(XbeFile) % 0x1000);
-
-        // write remaining bytes
+        if(!WriteZeros(XbeFile, PadEnd - Cursor))
         {
-            char *szBuffer = new char[remaining];
-
-            for(uint32 v = 0; v < remaining; v++)
-                szBuffer[v] = 0;
-
-            fwrite(szBuffer, remaining, 1, XbeFile);
-
-            delete[] szBuffer;
+            SetError("Unexpected write error while writing Xbe Zero Padding", false);
+            goto cleanup;
         }
 
-        printf("OK\n");
+        PrintProgress("OK\n");
     }
 
 cleanup:
 
+    if(XbeFile != NULL)
+    {
+        if(fclose(XbeFile) != 0 && GetError() == 0)
+            SetError("Unexpected write error while writing Xbe file", false);
+        XbeFile = NULL;
+    }
+
+    delete[] bzStream;
+    delete[] bzHeaders;
+
     // if we came across an error, delete the file we were creating
     if(GetError() != 0)
     {
         remove(x_szXbeFilename);
-        printf("FAILED!\n");
+        PrintProgress("FAILED!\n");
         printf("Xbe::Export: ERROR -> %s\n", GetError());
     }
 
-    if(XbeFile != NULL)
-    {
-        fclose(XbeFile);
-        XbeFile = NULL;
-    }
-
     return;
 }
 
@@ -11,6 +11,7 @@
 #include "Error.h"
 
 #include <stdio.h>
+#include <string>
 #include <vector>
 
 static const int XBE_UNCOMPRESSED_LOGO_SIZE = 100 * 17;
@@ -27,7 +28,8 @@ class Xbe : public Error
   public:
     // construct via Exe file object
     Xbe(class Exe *x_Exe, const char *x_szTitle, bool x_bRetail,
-        const std::vector<uint08> *logo = nullptr, const char *x_szDebugPath = nullptr);
+        const std::vector<uint08> *logo = nullptr, const char *x_szDebugPath = nullptr,
+        const std::vector<std::string> *x_NoPreloadSections = nullptr);
 
     // deconstructor
     ~Xbe();
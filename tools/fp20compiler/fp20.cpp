@@ -0,0 +1,224 @@
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <pthread.h>
+
+#include "fp20.h"
+#include "nvparse_errors.h"
+#include "nvparse_externs.h"
+#include "pb_output.h"
+
+
+
+// RC1.0  -- register combiners 1.0 configuration
+bool rc10_init(char *);
+int  rc10_parse();
+bool is_rc10(const char *);
+
+// TS1.0  -- texture shader 1.0 configuration
+bool ts10_init(char *);
+int  ts10_parse();
+bool is_ts10(const char *);
+
+
+
+// State of the parsers, guarded by lock. It's kept in a namespace, so the
+// library doesn't export these names to the programs linking it.
+namespace fp20 {
+nvparse_errors errors;
+pb_output output;
+bool optimize = true;
+int line_number;
+char * myin = 0;
+}
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static Fp20Result* current_result;
+
+static void add_message(const char* message, int line) {
+    Fp20Result* result = current_result;
+    if (result->num_errors < FP20_MAX_ERRORS) {
+        Fp20Message* m = &result->errors[result->num_errors++];
+        m->line = line;
+        snprintf(m->message, sizeof(m->message), "%s", message);
+    }
+}
+
+// Moves the errors of the last shader into the result
+static void collect_errors() {
+    int num_errors = errors.get_num_errors();
+    for (int i = 0; i < num_errors; i++) {
+        add_message(errors.get_errors()[i], errors.get_lines()[i]);
+    }
+    errors.reset();
+}
+
+static char* copy_string(const char* str, size_t length) {
+    char* buffer = (char*)malloc(length + 1);
+    memcpy(buffer, str, length);
+    buffer[length] = '\0';
+    return buffer;
+}
+
+static char* find_at_line_start(const char* haystack, const char* cursor,
+                                const char* needle) {
+    cursor = strstr(cursor, needle);
+    while (cursor != NULL) {
+
+        // Accept if candidate is at beginning of file or line
+        if ((cursor == haystack) || (cursor[-1] == '\n')) {
+            return (char*)cursor;
+        }
+
+        cursor = strstr(cursor + 1, needle);
+    }
+    return NULL;
+}
+
+static void translate(const char* s) {
+
+    // Keep a cursor for line-counting
+    const char* line_cursor = s;
+    unsigned int shader_line_number = 1;
+
+    // Look for the first shader magic
+    const char* shader_magic = find_at_line_start(s, s, "!!");
+
+    // Warn the user if we couldn't find any shader at all
+    if (shader_magic == NULL) {
+        add_message("no shaders found", 0);
+    }
+
+    // Loop until we can't find a shader anymore
+    while (shader_magic != NULL) {
+
+        // Move line cursor until we found the line of the shader magic
+        while (line_cursor < shader_magic) {
+            line_cursor = strchr(line_cursor, '\n');
+            assert(line_cursor != NULL);
+            line_cursor++;
+            shader_line_number++;
+        }
+
+        // Find end of shader magic line (whitespace or comment)
+        const char* shader_magic_end = shader_magic+2;
+        while (1) {
+            shader_magic_end += strcspn(shader_magic_end, " \t\n\r#;/*");
+
+            // Check for start of C style comment or single-line comment
+            if (shader_magic_end[0] == '/') {
+                if ((shader_magic_end[1] != '*') &&
+                    (shader_magic_end[1] != '/')) {
+                    shader_magic_end++;
+                    continue;
+                }
+            }
+
+            // Check for end of C style comment
+            if (shader_magic_end[0] == '*') {
+                if (shader_magic_end[1] != '/') {
+                    shader_magic_end++;
+                    continue;
+                }
+            }
+
+            break;
+        }
+
+        // Copy the magic
+        size_t shader_magic_len = shader_magic_end - shader_magic;
+        char* shader_magic_str = copy_string(shader_magic, shader_magic_len);
+
+        // Add information about shader section to output
+        output.print("/* %s (line %u) */\n", shader_magic_str, shader_line_number);
+
+        // Shader magic marks shader start
+        const char* shader = shader_magic;
+
+        // The next shader magic will mark the end of current shader; find it
+        const char* next_shader_magic;
+        if (*shader_magic_end != '\0') {
+            next_shader_magic = find_at_line_start(s, shader_magic_end+1, "!!");
+        } else {
+            next_shader_magic = NULL;
+        }
+
+        // Find shader end; also respect case where no other shader follows
+        const char* shader_end;
+        if (next_shader_magic != NULL) {
+            shader_end = next_shader_magic;
+        } else {
+            shader_end = &shader_magic_end[strlen(shader_magic_end)];
+        }
+
+        // Copy the shader
+        size_t shader_len = shader_end - shader;
+        char* shader_str = copy_string(shader, shader_len);
+
+        // Prepare error reporting
+        errors.set_line_number_offset(shader_line_number-1);
+
+        // Process shader
+        if (is_ts10(shader_str)) {
+            ts10_init(shader_str);
+            ts10_parse();
+        } else if (is_rc10(shader_str)) {
+            rc10_init(shader_str);
+            rc10_parse();
+        } else {
+            char message[256];
+            snprintf(message, sizeof(message), "unknown shader type \"%s\"", shader_magic_str);
+            add_message(message, shader_line_number);
+        }
+        collect_errors();
+
+        // Free temporary string copies
+        free(shader_str);
+        free(shader_magic_str);
+
+        // Continue with next shader by jumping to its magic
+        shader_magic = next_shader_magic;
+    }
+}
+
+bool fp20_compile(const char* source, bool optimize_stages, Fp20Result* result) {
+    memset(result, 0, sizeof(*result));
+
+    pthread_mutex_lock(&lock);
+
+    current_result = result;
+    optimize = optimize_stages;
+    output.reset();
+
+    translate(source);
+
+    const std::string& text = output.get_text();
+    result->text = (char*)malloc(text.size() + 1);
+    memcpy(result->text, text.c_str(), text.size() + 1);
+
+    const std::vector<uint32_t>& data = output.get_data();
+    // One spare byte keeps malloc from returning NULL for no methods
+    result->methods = (uint32_t*)malloc(data.size() * sizeof(uint32_t) + 1);
+    memcpy(result->methods, data.data(), data.size() * sizeof(uint32_t));
+    result->num_methods = data.size();
+
+    output.reset();
+    current_result = NULL;
+
+    pthread_mutex_unlock(&lock);
+
+    return result->num_errors == 0;
+}
+
+void fp20_free_result(Fp20Result* result) {
+    free(result->text);
+    free(result->methods);
+    result->text = NULL;
+    result->methods = NULL;
+    result->num_methods = 0;
+}
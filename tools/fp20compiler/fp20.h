@@ -0,0 +1,46 @@
+#ifndef FP20_H
+#define FP20_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Further errors are dropped
+#define FP20_MAX_ERRORS 32
+
+typedef struct Fp20Message {
+    int line; // 0 if the message isn't tied to a line
+    char message[256];
+} Fp20Message;
+
+typedef struct Fp20Result {
+    // Zero terminated C code for a pb_begin() block
+    char *text;
+    // Packets for the 3D object, ready for a pb_push_blob() blob
+    uint32_t *methods;
+    unsigned int num_methods;
+    unsigned int num_errors;
+    Fp20Message errors[FP20_MAX_ERRORS];
+} Fp20Result;
+
+// Compiles the register combiner (!!RC1.0) and texture shader (!!TS1.0)
+// programs of the source. Returns false if there were errors. The result has
+// to be released with fp20_free_result in any case.
+//
+// The parsers are generated by bison and flex and keep their state in
+// globals. All calls are serialized by one global mutex, so calling this from
+// several threads is safe but doesn't compile anything in parallel. For the
+// same reason, the batch mode of fp20compiler runs on a single thread and
+// ignores -j.
+bool fp20_compile(const char *source, bool optimize, Fp20Result *result);
+
+void fp20_free_result(Fp20Result *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,206 +1,181 @@
-#include <vector>
-
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
-#include <cassert>
-
-#include "nvparse_errors.h"
-
-
-
-// RC1.0  -- register combiners 1.0 configuration
-bool rc10_init(char *);
-int  rc10_parse();
-bool is_rc10(const char *);
-
-// TS1.0  -- texture shader 1.0 configuration
-bool ts10_init(char *);
-int  ts10_parse();
-bool is_ts10(const char *);
-
-// DX8 stuff
-
-// PS1.0  -- DX8 Pixel Shader 1.0 configuration
-bool ps10_init(char *);
-int  ps10_parse();
-bool ps10_set_map(const std::vector<int>& argv);
-bool is_ps10(const char *);
-const int* ps10_get_info(int* pcount);
-
-
 
-nvparse_errors errors;
-int line_number;
-char * myin = 0;
+#include "fp20.h"
+#include "../../lib/pbkit/pbkit_blob.h"
 
-static char* copy_string(const char* str, size_t length) {
-    char* buffer = (char*)malloc(length + 1);
-    memcpy(buffer, str, length);
-    buffer[length] = '\0';
-    return buffer;
-}
 
-static char* find_at_line_start(const char* haystack, const char* cursor,
-                                const char* needle) {
-    cursor = strstr(cursor, needle);
-    while (cursor != NULL) {
 
-        // Accept if candidate is at beginning of file or line
-        if ((cursor == haystack) || (cursor[-1] == '\n')) {
-            return (char*)cursor;
+static void print_errors(const char* filename, const Fp20Result* result) {
+    for (unsigned int i = 0; i < result->num_errors; i++) {
+        const Fp20Message* m = &result->errors[i];
+        if (m->line > 0) {
+            fprintf(stderr, "%s: error: line %d: %s\n", filename, m->line, m->message);
+        } else {
+            fprintf(stderr, "%s: error: %s\n", filename, m->message);
         }
-
-        cursor = strstr(cursor + 1, needle);
     }
-    return NULL;
 }
 
-int translate(const char* s) {
-    int ret = 0;
+static bool write_blob(FILE* fh, const Fp20Result* result) {
+    pb_blob_header_t header;
+    header.magic = PB_BLOB_MAGIC;
+    header.version = PB_BLOB_VERSION;
+    header.size = result->num_methods;
 
-    // Keep a cursor for line-counting
-    const char* line_cursor = s;
-    unsigned int shader_line_number = 1;
+    if (fwrite(&header, sizeof(header), 1, fh) != 1)
+        return false;
+    return fwrite(result->methods, sizeof(uint32_t), result->num_methods, fh) == result->num_methods;
+}
 
-    // Look for the first shader magic
-    const char* shader_magic = find_at_line_start(s, s, "!!");
+// Writes the shaders as C code or as a pushbuffer blob. Returns nonzero
+// on error.
+static int translate(FILE* fh, const char* filename, const char* str, bool optimize, bool binary) {
+    Fp20Result result;
+    int ret = 0;
 
-    // Warn the user if we couldn't find any shader at all
-    if (shader_magic == NULL) {
-        fprintf(stderr, "no shaders found\n");
+    if (!fp20_compile(str, optimize, &result)) {
+        print_errors(filename, &result);
         ret = 1;
+    } else if (binary) {
+        if (!write_blob(fh, &result)) {
+            fprintf(stderr, "%s: failed to write blob\n", filename);
+            ret = 1;
+        }
+    } else {
+        fputs(result.text, fh);
     }
 
-    // Loop until we can't find a shader anymore
-    while (shader_magic != NULL) {
-
-        // Move line cursor until we found the line of the shader magic
-        while (line_cursor < shader_magic) {
-            line_cursor = strchr(line_cursor, '\n');
-            assert(line_cursor != NULL);
-            line_cursor++;
-            shader_line_number++;
-        }
+    fp20_free_result(&result);
+    return ret;
+}
 
-        // Find end of shader magic line (whitespace or comment)
-        const char* shader_magic_end = shader_magic+2;
-        while (1) {
-            shader_magic_end += strcspn(shader_magic_end, " \t\n\r#;/*");
-
-            // Check for start of C style comment or single-line comment
-            if (shader_magic_end[0] == '/') {
-                if ((shader_magic_end[1] != '*') &&
-                    (shader_magic_end[1] != '/')) {
-                    shader_magic_end++;
-                    continue;
-                }
-            }
-
-            // Check for end of C style comment
-            if (shader_magic_end[0] == '*') {
-                if (shader_magic_end[1] != '/') {
-                    shader_magic_end++;
-                    continue;
-                }
-            }
+// Reads the whole file into a zero terminated buffer. Returns NULL on error.
+static char* read_file(const char* filename) {
+    FILE* fh = fopen(filename, "rb");
+    if (!fh) {
+        fprintf(stderr, "unable to open \"%s\"\n", filename);
+        return NULL;
+    }
 
-            break;
-        }
+    fseek(fh, 0L, SEEK_END);
+    long size = ftell(fh);
+    rewind(fh);
+    char* buffer = (char*)malloc(size+1);
+    if (buffer == NULL) {
+        fprintf(stderr, "failed to allocate buffer for file\n");
+        fclose(fh);
+        return NULL;
+    }
 
-        // Copy the magic
-        size_t shader_magic_len = shader_magic_end - shader_magic;
-        char* shader_magic_str = copy_string(shader_magic, shader_magic_len);
+    fread(buffer, size, 1, fh);
+    buffer[size] = '\0';
+    fclose(fh);
 
-        // Add information about shader section to output
-        printf("/* %s (line %u) */\n", shader_magic_str, shader_line_number);
+    return buffer;
+}
 
-        // Shader magic marks shader start
-        const char* shader = shader_magic;
+static int compile_file(const char* input, const char* output, bool optimize, bool binary) {
+    char* buffer = read_file(input);
+    if (buffer == NULL) {
+        return 1;
+    }
 
-        // The next shader magic will mark the end of current shader; find it
-        const char* next_shader_magic;
-        if (*shader_magic_end != '\0') {
-            next_shader_magic = find_at_line_start(s, shader_magic_end+1, "!!");
-        } else {
-            next_shader_magic = NULL;
-        }
+    FILE* fh = fopen(output, binary ? "wb" : "w");
+    if (!fh) {
+        fprintf(stderr, "unable to create \"%s\"\n", output);
+        free(buffer);
+        return 1;
+    }
 
-        // Find shader end; also respect case where no other shader follows
-        const char* shader_end;
-        if (next_shader_magic != NULL) {
-            shader_end = next_shader_magic;
-        } else {
-            shader_end = &shader_magic_end[strlen(shader_magic_end)];
-        }
+    int ret = translate(fh, input, buffer, optimize, binary);
+    if (fclose(fh) != 0) {
+        ret = 1;
+    }
+    if (ret != 0) {
+        remove(output);
+    }
 
-        // Copy the shader
-        size_t shader_len = shader_end - shader;
-        char* shader_str = copy_string(shader, shader_len);
+    free(buffer);
+    return ret;
+}
 
-        // Prepare error reporting
-        errors.set_line_number_offset(shader_line_number-1);
+// Compiles the files of the list, which holds an input and an output path
+// per line. The parsers can't run concurrently, so unlike vp20compiler this
+// works through the list on one thread; it still saves a process per file.
+// -j is accepted for compatibility with vp20compiler and ignored.
+// Returns the number of failed files.
+static int batch_compile(const char* listfile, bool optimize, bool binary) {
+    char* list = read_file(listfile);
+    if (list == NULL) {
+        return -1;
+    }
 
-        // Process shader
-        if (is_ts10(shader_str)) {
-            ts10_init(shader_str);
-            ts10_parse();
-        } else if (is_rc10(shader_str)) {
-            rc10_init(shader_str);
-            rc10_parse();
-        } else {
-            fprintf(stderr, "unknown shader type \"%s\"\n", shader_magic_str);
+    int num_failed = 0;
+    unsigned int line_number = 0;
+    char* save_line;
+    for (char* line = strtok_r(list, "\n", &save_line); line; line = strtok_r(NULL, "\n", &save_line)) {
+        char* save_word;
+        char* input = strtok_r(line, " \t\r", &save_word);
+        char* output = strtok_r(NULL, " \t\r", &save_word);
+        line_number++;
+        if (input == NULL) {
+            continue;
         }
-
-        // Show all errors
-        int num_errors = errors.get_num_errors();
-        if (num_errors > 0) {
-            fprintf(stderr, "errors in shader \"%s\" (line %d):\n",
-                    shader_magic_str, shader_line_number);
-            for(int i = 0; i < num_errors; i++) {
-                fprintf(stderr, "error: %s\n", errors.get_errors()[i]);
-            }
-            ret = 1;
+        if (output == NULL || strtok_r(NULL, " \t\r", &save_word) != NULL) {
+            fprintf(stderr, "%s: line %u: expected an input and an output file\n", listfile, line_number);
+            num_failed++;
+            continue;
+        }
+        if (compile_file(input, output, optimize, binary)) {
+            num_failed++;
         }
-
-        // Free temporary string copies
-        free(shader_str);
-        free(shader_magic_str);
-
-        // Continue with next shader by jumping to its magic
-        shader_magic = next_shader_magic;
     }
 
-    return ret;
+    free(list);
+    return num_failed;
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <fpfile>\n", argv[0]);
-        exit(1);
+    const char* filename = NULL;
+    bool optimize = true;
+    bool binary = false;
+    bool batch = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-bin")) {
+            binary = true;
+        } else if (!strcmp(argv[i], "-O0")) {
+            optimize = false;
+        } else if (!strcmp(argv[i], "-batch")) {
+            batch = true;
+        } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            i++;
+        } else if (filename == NULL) {
+            filename = argv[i];
+        } else {
+            filename = NULL;
+            break;
+        }
     }
 
-    FILE* fh = fopen(argv[1], "rb");
-    if (!fh) {
-        fprintf(stderr, "unable to open \"%s\"\n", argv[1]);
+    if (filename == NULL) {
+        fprintf(stderr, "usage: %s [-O0] [-bin] <fpfile>\n", argv[0]);
+        fprintf(stderr, "       %s [-O0] [-bin] [-j threads] -batch <listfile>\n", argv[0]);
         exit(1);
     }
 
-    fseek(fh, 0L, SEEK_END);
-    long size = ftell(fh);
-    rewind(fh);
-    char* buffer = (char*)malloc(size+1);
+    if (batch) {
+        return batch_compile(filename, optimize, binary) == 0 ? 0 : 1;
+    }
+
+    char* buffer = read_file(filename);
     if (buffer == NULL) {
-        fprintf(stderr, "failed to allocate buffer for file\n");
         exit(1);
     }
 
-    fread(buffer, size, 1, fh);
-    buffer[size] = '\0';
+    int ret = translate(stdout, filename, buffer, optimize, binary);
 
-    int ret = translate(buffer);
-
-    fclose(fh);
     free(buffer);
 
     return ret;
@@ -30,16 +30,18 @@ void nvparse_errors::reset()
 
 void nvparse_errors::set(const char * e)
 {
-	if(num_errors < NVPARSE_MAX_ERRORS)
+	if(num_errors < NVPARSE_MAX_ERRORS) {
+		lines[num_errors] = 0;
 		elist[num_errors++] = strdup(e);
+	}
 }
 
 void nvparse_errors::set(const char * e, int line_number)
 {
-	char buff[256];
-	sprintf(buff, "line %d: %s", line_number_offset + line_number, e);
-	if(num_errors < NVPARSE_MAX_ERRORS)
-		elist[num_errors++] = strdup(buff);
+	if(num_errors < NVPARSE_MAX_ERRORS) {
+		lines[num_errors] = line_number_offset + line_number;
+		elist[num_errors++] = strdup(e);
+	}
 }
 
 char * const * const nvparse_errors::get_errors()
@@ -16,10 +16,13 @@ public:
 	void set(const char * e);
 	void set(const char * e, int line_number);
 	char * const * const get_errors();
+	// Source line of each error, 0 if it isn't tied to a line
+	inline const int * get_lines() { return lines; }
 	inline int  get_num_errors() { return num_errors; }
 	void set_line_number_offset(int offset) { line_number_offset = offset; }
 private:
 	char* elist [NVPARSE_MAX_ERRORS+1];
+	int lines [NVPARSE_MAX_ERRORS];
 	int num_errors;
 	int line_number_offset;
 };
@@ -1,9 +1,22 @@
 #ifndef NVPARSE_EXTERNS_H
 #define NVPARSE_EXTERNS_H
 
+#include "pb_output.h"
+
+// Defined in fp20.cpp
+namespace fp20 {
 extern nvparse_errors errors;
 extern int line_number;
 extern char * myin;
+extern pb_output output;
+extern bool optimize;
+}
+
+using fp20::errors;
+using fp20::line_number;
+using fp20::myin;
+using fp20::output;
+using fp20::optimize;
 
 
 #endif
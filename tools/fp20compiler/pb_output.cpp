@@ -0,0 +1,59 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "pb_output.h"
+#include "../../lib/pbkit/pbkit_blob.h"
+
+#define PACKET_COUNT(header) (((header) >> 18) & 0x7FF)
+
+pb_output::pb_output()
+{
+	reset();
+}
+
+void pb_output::reset()
+{
+	text.clear();
+	data.clear();
+	packet = 0;
+	next_method = 0;
+}
+
+int pb_output::print(const char * format, ...)
+{
+	char buff[256];
+	va_list args;
+	va_start(args, format);
+	int ret = vsnprintf(buff, sizeof(buff), format, args);
+	va_end(args);
+	if (ret < 0)
+		return ret;
+
+	if ((size_t)ret < sizeof(buff)) {
+		text.append(buff, ret);
+		return ret;
+	}
+
+	// Longer than the stack buffer, format again into the string itself
+	size_t offset = text.size();
+	text.resize(offset + ret + 1);
+	va_start(args, format);
+	vsnprintf(&text[offset], ret + 1, format, args);
+	va_end(args);
+	text.resize(offset + ret);
+	return ret;
+}
+
+void pb_output::method(uint32_t method, uint32_t value)
+{
+	// A packet must fit into a single block of the loader
+	if (data.empty() || method != next_method ||
+	    PACKET_COUNT(data[packet]) + 1 >= PB_BLOB_MAX_BLOCK) {
+		packet = data.size();
+		data.push_back(method);
+	}
+
+	data[packet] += 1 << 18;
+	data.push_back(value);
+	next_method = method + 4;
+}
@@ -0,0 +1,36 @@
+#ifndef _PB_OUTPUT_H_
+#define _PB_OUTPUT_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "../../lib/pbkit/nv_regs.h"
+
+#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))
+
+// Receives the state of all shaders, both as C code for a pb_begin() block
+// and as the methods of a pushbuffer blob for pb_push_blob().
+class pb_output
+{
+public:
+	pb_output();
+
+	void reset();
+
+	// printf into the C code
+	int print(const char * format, ...);
+	// Queues one method, consecutive methods share a packet
+	void method(uint32_t method, uint32_t value);
+
+	inline const std::string & get_text() { return text; }
+	inline const std::vector<uint32_t> & get_data() { return data; }
+private:
+	std::string text;
+	std::vector<uint32_t> data;
+	size_t packet;
+	uint32_t next_method;
+};
+
+#endif
@@ -24,24 +24,30 @@ void CombinersStruct::Validate()
 
 void CombinersStruct::Invoke()
 {
-    printf("#pragma push_macro(\"MASK\")\n");
-    printf("#undef MASK\n");
-    printf("#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))\n");
-    printf("\n");
+    output.print("#pragma push_macro(\"MASK\")\n");
+    output.print("#undef MASK\n");
+    output.print("#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))\n");
+    output.print("\n");
 
     assert(numConsts <= 2);
     for (int i = 0; i < numConsts; i++) {
     //     glCombinerParameterfvNV(cc[i].reg.bits.name, &(cc[i].v[0]));
         const char* general_cmd = NULL;
         const char* final_cmd = NULL;
+        uint32_t general_method = 0;
+        uint32_t final_method = 0;
         switch(cc[i].reg.bits.name) {
         case REG_CONSTANT_COLOR0:
             general_cmd = "NV097_SET_COMBINER_FACTOR0";
             final_cmd = "NV097_SET_SPECULAR_FOG_FACTOR + 0";
+            general_method = NV097_SET_COMBINER_FACTOR0;
+            final_method = NV097_SET_SPECULAR_FOG_FACTOR + 0;
             break;
         case REG_CONSTANT_COLOR1:
             general_cmd = "NV097_SET_COMBINER_FACTOR1";
             final_cmd = "NV097_SET_SPECULAR_FOG_FACTOR + 4";
+            general_method = NV097_SET_COMBINER_FACTOR1;
+            final_method = NV097_SET_SPECULAR_FOG_FACTOR + 4;
             break;
         default:
             assert(false);
@@ -62,23 +68,25 @@ void CombinersStruct::Invoke()
         // Also see mode selection in GeneralCombinersStruct::Invoke() and
         // local-constant emitter in GeneralCombinerStruct::Invoke(int stage).
         if (generals.localConsts == 0) {
-            printf("pb_push1(p, %s,", general_cmd);
-            printf("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
-            printf("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
-            printf("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
-            printf("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
-            printf(");\n");
-            printf("p += 2;\n");
+            output.method(general_method, cc[i].ToRaw());
+            output.print("pb_push1(p, %s,", general_cmd);
+            output.print("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
+            output.print("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
+            output.print("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
+            output.print("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
+            output.print(");\n");
+            output.print("p += 2;\n");
         }
 
         // Global-constants are also used in final-combiner
-        printf("pb_push1(p, %s,", final_cmd);
-        printf("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
-        printf("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
-        printf("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
-        printf("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
-        printf(");\n");
-        printf("p += 2;\n");
+        output.method(final_method, cc[i].ToRaw());
+        output.print("pb_push1(p, %s,", final_cmd);
+        output.print("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
+        output.print("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
+        output.print("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
+        output.print("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
+        output.print(");\n");
+        output.print("p += 2;\n");
     }
 
 
@@ -86,8 +94,8 @@ void CombinersStruct::Invoke()
 
     final.Invoke();
 
-    printf("\n");
-    printf("#pragma pop_macro(\"MASK\")\n");
+    output.print("\n");
+    output.print("#pragma pop_macro(\"MASK\")\n");
 }
 
 bool is_rc10(const char * s)
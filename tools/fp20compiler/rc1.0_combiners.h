@@ -13,8 +13,15 @@ public:
     void Init(GeneralCombinersStruct _gcs, FinalCombinerStruct _fc)
     { generals = _gcs; final = _fc; numConsts = 0;}
     void Validate();
+    // Reduces the number of general combiner stages
+    void Optimize();
     void Invoke();
 private:
+    void ForwardCopies();
+    void RemoveDeadOutputs();
+    void RemoveUnusedStages();
+    bool MergeStages(int stage);
+
     GeneralCombinersStruct generals;
     FinalCombinerStruct final;
     ConstColorStruct cc[2];
@@ -101,42 +101,84 @@ void FinalCombinerStruct::Validate()
     ValidateAlphaInputRegister(alpha.g.reg);
 }
 
-static void GenerateFinalInput(char var, MappedRegisterStruct reg) {
+static uint32_t GenerateFinalInput(char var, MappedRegisterStruct reg) {
     int num = (var >= 'E') ? 1 : 0;
-    printf("MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_SOURCE, %s)", num, var, GetRegisterNameString(reg.reg.bits.name));
-    printf(" | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_ALPHA, %d)", num, var,
+    output.print("MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_SOURCE, %s)", num, var, GetRegisterNameString(reg.reg.bits.name));
+    output.print(" | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_ALPHA, %d)", num, var,
             reg.reg.bits.channel == RCP_ALPHA);
-    printf(" | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_INVERSE, %d)", num, var,
+    output.print(" | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW%d_%c_INVERSE, %d)", num, var,
             (reg.map == MAP_UNSIGNED_INVERT));
+
+    uint32_t source = GetRegisterNameValue(reg.reg.bits.name);
+    uint32_t alpha = (reg.reg.bits.channel == RCP_ALPHA) ? 1 : 0;
+    uint32_t inverse = (reg.map == MAP_UNSIGNED_INVERT) ? 1 : 0;
+    switch (var) {
+    case 'A':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_A_INVERSE, inverse);
+    case 'B':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_B_INVERSE, inverse);
+    case 'C':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_C_INVERSE, inverse);
+    case 'D':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW0_D_INVERSE, inverse);
+    case 'E':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_E_INVERSE, inverse);
+    case 'F':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_F_INVERSE, inverse);
+    case 'G':
+        return MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_G_INVERSE, inverse);
+    default:
+        assert(false);
+        return 0;
+    }
 }
 
 void FinalCombinerStruct::Invoke()
 {
-
-    printf("pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0,\n");
-    printf("    ");
-    GenerateFinalInput('A', rgb.a);
-    printf("\n    | ");
-    GenerateFinalInput('B', rgb.b);
-    printf("\n    | ");
-    GenerateFinalInput('C', rgb.c);
-    printf("\n    | ");
-    GenerateFinalInput('D', rgb.d);
-    printf(");\n");
-    printf("p += 2;\n");
-
-    printf("pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW1,\n");
-    printf("    ");
-    GenerateFinalInput('E', product.e);
-    printf("\n    | ");
-    GenerateFinalInput('F', product.f);
-    printf("\n    | ");
-    GenerateFinalInput('G', alpha.g);
-
-    printf("\n    | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_SPECULAR_CLAMP, %d)", clamp);
-
-    printf(");\n");
-    printf("p += 2;\n");
+    uint32_t cw0 = 0;
+    uint32_t cw1 = 0;
+
+    output.print("pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0,\n");
+    output.print("    ");
+    cw0 |= GenerateFinalInput('A', rgb.a);
+    output.print("\n    | ");
+    cw0 |= GenerateFinalInput('B', rgb.b);
+    output.print("\n    | ");
+    cw0 |= GenerateFinalInput('C', rgb.c);
+    output.print("\n    | ");
+    cw0 |= GenerateFinalInput('D', rgb.d);
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(NV097_SET_COMBINER_SPECULAR_FOG_CW0, cw0);
+
+    output.print("pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW1,\n");
+    output.print("    ");
+    cw1 |= GenerateFinalInput('E', product.e);
+    output.print("\n    | ");
+    cw1 |= GenerateFinalInput('F', product.f);
+    output.print("\n    | ");
+    cw1 |= GenerateFinalInput('G', alpha.g);
+
+    output.print("\n    | MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_SPECULAR_CLAMP, %d)", clamp);
+    cw1 |= MASK(NV097_SET_COMBINER_SPECULAR_FOG_CW1_SPECULAR_CLAMP, clamp ? 1 : 0);
+
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(NV097_SET_COMBINER_SPECULAR_FOG_CW1, cw1);
     // if(clamp)
     //     glCombinerParameteriNV(GL_COLOR_SUM_CLAMP_NV, GL_TRUE);
     // else
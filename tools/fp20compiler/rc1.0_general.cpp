@@ -60,16 +60,24 @@ void GeneralCombinersStruct::Invoke()
     // }
     // assert(false);
 
-    printf("pb_push1(p, NV097_SET_COMBINER_CONTROL,");
-    printf("\n    MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, %s)",
+    output.method(NV097_SET_COMBINER_CONTROL,
+        MASK(NV097_SET_COMBINER_CONTROL_FACTOR0,
+            localConsts > 0 ? NV097_SET_COMBINER_CONTROL_FACTOR0_EACH_STAGE
+                    : NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL)
+        | MASK(NV097_SET_COMBINER_CONTROL_FACTOR1,
+            localConsts > 0 ? NV097_SET_COMBINER_CONTROL_FACTOR1_EACH_STAGE
+                    : NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL)
+        | MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, num));
+    output.print("pb_push1(p, NV097_SET_COMBINER_CONTROL,");
+    output.print("\n    MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, %s)",
         localConsts > 0 ? "NV097_SET_COMBINER_CONTROL_FACTOR0_EACH_STAGE"
                 : "NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL");
-    printf("\n    | MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, %s)",
+    output.print("\n    | MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, %s)",
         localConsts > 0 ? "NV097_SET_COMBINER_CONTROL_FACTOR1_EACH_STAGE"
                 : "NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL");
-    printf("\n    | MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, %d)", num);
-    printf(");\n");
-    printf("p += 2;\n");
+    output.print("\n    | MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, %d)", num);
+    output.print(");\n");
+    output.print("p += 2;\n");
 }
 
 void GeneralCombinerStruct::ZeroOut()
@@ -141,12 +149,15 @@ void GeneralCombinerStruct::Invoke(int stage)
     assert(numConsts <= 2);
     for (i = 0; i < numConsts; i++) {
         const char* cmd = NULL;
+        uint32_t method = 0;
         switch(cc[i].reg.bits.name) {
         case REG_CONSTANT_COLOR0:
             cmd = "NV097_SET_COMBINER_FACTOR0";
+            method = NV097_SET_COMBINER_FACTOR0;
             break;
         case REG_CONSTANT_COLOR1:
             cmd = "NV097_SET_COMBINER_FACTOR1";
+            method = NV097_SET_COMBINER_FACTOR1;
             break;
         default:
             assert(false);
@@ -158,13 +169,14 @@ void GeneralCombinerStruct::Invoke(int stage)
         assert(cc[i].v[2] >= 0.0f && cc[i].v[2] <= 1.0f);
         assert(cc[i].v[3] >= 0.0f && cc[i].v[3] <= 1.0f);
 
-        printf("pb_push1(p, %s + %d * 4,", cmd, stage);
-        printf("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
-        printf("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
-        printf("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
-        printf("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
-        printf(");\n");
-        printf("p += 2;\n");
+        output.method(method + stage * 4, cc[i].ToRaw());
+        output.print("pb_push1(p, %s + %d * 4,", cmd, stage);
+        output.print("\n    MASK(0xFF000000, 0x%02X)", (unsigned char)(cc[i].v[3] * 0xFF));
+        output.print("\n    | MASK(0x00FF0000, 0x%02X)", (unsigned char)(cc[i].v[0] * 0xFF));
+        output.print("\n    | MASK(0x0000FF00, 0x%02X)", (unsigned char)(cc[i].v[1] * 0xFF));
+        output.print("\n    | MASK(0x000000FF, 0x%02X)", (unsigned char)(cc[i].v[2] * 0xFF));
+        output.print(");\n");
+        output.print("p += 2;\n");
     }
 
     for (i = 0; i < 2; i++)
@@ -257,30 +269,60 @@ void GeneralFunctionStruct::Validate(int stage, int portion)
     }
 }
 
-static void GenerateInput(int portion, char variable, MappedRegisterStruct reg) {
+// Returns the bits of the input, which are laid out the same way in the
+// color and the alpha input control words
+static uint32_t GenerateInput(int portion, char variable, MappedRegisterStruct reg) {
     const char* portion_s = portion == RCP_RGB ? "COLOR" : "ALPHA";
-    printf("MASK(NV097_SET_COMBINER_%s_ICW_%c_SOURCE, %s)", portion_s, variable, GetRegisterNameString(reg.reg.bits.name));
-    printf(" | MASK(NV097_SET_COMBINER_%s_ICW_%c_ALPHA, %d)", portion_s, variable,
+    output.print("MASK(NV097_SET_COMBINER_%s_ICW_%c_SOURCE, %s)", portion_s, variable, GetRegisterNameString(reg.reg.bits.name));
+    output.print(" | MASK(NV097_SET_COMBINER_%s_ICW_%c_ALPHA, %d)", portion_s, variable,
             reg.reg.bits.channel == RCP_ALPHA);
-    printf(" | MASK(NV097_SET_COMBINER_%s_ICW_%c_MAP, 0x%x)", portion_s, variable, reg.map);
+    output.print(" | MASK(NV097_SET_COMBINER_%s_ICW_%c_MAP, 0x%x)", portion_s, variable, reg.map);
+
+    uint32_t source = GetRegisterNameValue(reg.reg.bits.name);
+    uint32_t alpha = (reg.reg.bits.channel == RCP_ALPHA) ? 1 : 0;
+    switch (variable) {
+    case 'A':
+        return MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_A_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, reg.map);
+    case 'B':
+        return MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_B_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, reg.map);
+    case 'C':
+        return MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_C_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, reg.map);
+    case 'D':
+        return MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, source)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_D_ALPHA, alpha)
+            | MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, reg.map);
+    default:
+        assert(false);
+        return 0;
+    }
 }
 
 void GeneralFunctionStruct::Invoke(int stage, int portion, BiasScaleEnum bs)
 {
     // GLenum portionEnum = (RCP_RGB == portion) ? GL_RGB : GL_ALPHA;
     const char* portion_s = (portion == RCP_RGB ? "COLOR" : "ALPHA");
-
-    printf("pb_push1(p, NV097_SET_COMBINER_%s_ICW + %d * 4,", portion_s, stage);
-    printf("\n    ");
-    GenerateInput(portion, 'A', op[0].reg[1]);
-    printf("\n    | ");
-    GenerateInput(portion, 'B', op[0].reg[2]);
-    printf("\n    | ");
-    GenerateInput(portion, 'C', op[1].reg[1]);
-    printf("\n    | ");
-    GenerateInput(portion, 'D', op[1].reg[2]);
-    printf(");\n");
-    printf("p += 2;\n");
+    uint32_t icw_method = (portion == RCP_RGB ? NV097_SET_COMBINER_COLOR_ICW : NV097_SET_COMBINER_ALPHA_ICW);
+    uint32_t ocw_method = (portion == RCP_RGB ? NV097_SET_COMBINER_COLOR_OCW : NV097_SET_COMBINER_ALPHA_OCW);
+
+    uint32_t icw = 0;
+    output.print("pb_push1(p, NV097_SET_COMBINER_%s_ICW + %d * 4,", portion_s, stage);
+    output.print("\n    ");
+    icw |= GenerateInput(portion, 'A', op[0].reg[1]);
+    output.print("\n    | ");
+    icw |= GenerateInput(portion, 'B', op[0].reg[2]);
+    output.print("\n    | ");
+    icw |= GenerateInput(portion, 'C', op[1].reg[1]);
+    output.print("\n    | ");
+    icw |= GenerateInput(portion, 'D', op[1].reg[2]);
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(icw_method + stage * 4, icw);
 
     // glCombinerInputNV(GL_COMBINER0_NV + stage,
     //     portionEnum,
@@ -310,34 +352,52 @@ void GeneralFunctionStruct::Invoke(int stage, int portion, BiasScaleEnum bs)
     //     op[1].reg[2].map,
     //     MAP_CHANNEL(op[1].reg[2].reg.bits.channel));
 
-    printf("pb_push1(p, NV097_SET_COMBINER_%s_OCW + %d * 4,\n", portion_s, stage);
-    printf("    MASK(NV097_SET_COMBINER_%s_OCW_AB_DST, %s)\n", portion_s, GetRegisterNameString(op[0].reg[0].reg.bits.name));
-    printf("    | MASK(NV097_SET_COMBINER_%s_OCW_CD_DST, %s)\n", portion_s, GetRegisterNameString(op[1].reg[0].reg.bits.name));
-    printf("    | MASK(NV097_SET_COMBINER_%s_OCW_SUM_DST, %s)\n", portion_s, GetRegisterNameString(op[2].reg[0].reg.bits.name));
-    printf("    | MASK(NV097_SET_COMBINER_%s_OCW_MUX_ENABLE, %d)\n", portion_s, (op[2].op == RCP_MUX));
+    output.print("pb_push1(p, NV097_SET_COMBINER_%s_OCW + %d * 4,\n", portion_s, stage);
+    output.print("    MASK(NV097_SET_COMBINER_%s_OCW_AB_DST, %s)\n", portion_s, GetRegisterNameString(op[0].reg[0].reg.bits.name));
+    output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_CD_DST, %s)\n", portion_s, GetRegisterNameString(op[1].reg[0].reg.bits.name));
+    output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_SUM_DST, %s)\n", portion_s, GetRegisterNameString(op[2].reg[0].reg.bits.name));
+    output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_MUX_ENABLE, %d)\n", portion_s, (op[2].op == RCP_MUX));
+
+    // The OCW fields match between both portions, except for the dot
+    // products which only exist in the color portion
+    uint32_t ocw = MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, GetRegisterNameValue(op[0].reg[0].reg.bits.name))
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DST, GetRegisterNameValue(op[1].reg[0].reg.bits.name))
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_SUM_DST, GetRegisterNameValue(op[2].reg[0].reg.bits.name))
+        | MASK(NV097_SET_COMBINER_COLOR_OCW_MUX_ENABLE, (op[2].op == RCP_MUX) ? 1 : 0);
 
     const char* scale_s = NULL;
+    uint32_t op_value = 0;
     switch(bs.bits.scale) {
-    case SCALE_NONE: scale_s = "NOSHIFT"; break;
-    case SCALE_BY_TWO: scale_s = "SHIFTLEFTBY1"; break;
-    case SCALE_BY_FOUR: scale_s = "SHIFTLEFTBY2"; break;
-    case SCALE_BY_ONE_HALF: scale_s = "SHIFTRIGHTBY1"; break;
+    case SCALE_NONE: scale_s = "NOSHIFT"; op_value = NV097_SET_COMBINER_COLOR_OCW_OP_NOSHIFT; break;
+    case SCALE_BY_TWO: scale_s = "SHIFTLEFTBY1"; op_value = NV097_SET_COMBINER_COLOR_OCW_OP_SHIFTLEFTBY1; break;
+    case SCALE_BY_FOUR: scale_s = "SHIFTLEFTBY2"; op_value = NV097_SET_COMBINER_COLOR_OCW_OP_SHIFTLEFTBY2; break;
+    case SCALE_BY_ONE_HALF: scale_s = "SHIFTRIGHTBY1"; op_value = NV097_SET_COMBINER_COLOR_OCW_OP_SHIFTRIGHTBY1; break;
     default:
         assert(false);
         break;
     }
 
     if (portion == RCP_RGB) {
-        printf("    | MASK(NV097_SET_COMBINER_%s_OCW_AB_DOT_ENABLE, %d)\n", portion_s, op[0].op);
-        printf("    | MASK(NV097_SET_COMBINER_%s_OCW_CD_DOT_ENABLE, %d)\n", portion_s, op[1].op);
+        output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_AB_DOT_ENABLE, %d)\n", portion_s, op[0].op);
+        output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_CD_DOT_ENABLE, %d)\n", portion_s, op[1].op);
+        ocw |= MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DOT_ENABLE, op[0].op)
+            | MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DOT_ENABLE, op[1].op);
     }
 
-    printf("    | MASK(NV097_SET_COMBINER_%s_OCW_OP, NV097_SET_COMBINER_%s_OCW_OP_%s%s)",
+    if (bs.bits.bias == BIAS_BY_NEGATIVE_ONE_HALF)
+        op_value++;
+    if (portion == RCP_RGB)
+        ocw |= MASK(NV097_SET_COMBINER_COLOR_OCW_OP, op_value);
+    else
+        ocw |= MASK(NV097_SET_COMBINER_ALPHA_OCW_OP, op_value);
+
+    output.print("    | MASK(NV097_SET_COMBINER_%s_OCW_OP, NV097_SET_COMBINER_%s_OCW_OP_%s%s)",
             portion_s, portion_s, scale_s,
             (bs.bits.bias == BIAS_BY_NEGATIVE_ONE_HALF) ? "_BIAS" : "");
 
-    printf(");\n");
-    printf("p += 2;\n");
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(ocw_method + stage * 4, ocw);
 
     // glCombinerOutputNV(GL_COMBINER0_NV + stage,
     //     portionEnum,
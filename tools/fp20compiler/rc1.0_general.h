@@ -16,6 +16,12 @@ class ConstColorStruct {
 public:
     void Init(RegisterEnum _reg, float _v0, float _v1, float _v2, float _v3)
     { line_number = ::line_number; reg = _reg; v[0] = _v0; v[1] = _v1; v[2] = _v2; v[3] = _v3; }
+    // A8R8G8B8, as the factor methods take it
+    uint32_t ToRaw() const
+    {
+        return ((uint32_t)(unsigned char)(v[3] * 0xFF) << 24) | ((uint32_t)(unsigned char)(v[0] * 0xFF) << 16) |
+               ((uint32_t)(unsigned char)(v[1] * 0xFF) << 8) | (uint32_t)(unsigned char)(v[2] * 0xFF);
+    }
     int line_number;
     RegisterEnum reg;
     float v[4];
@@ -72,6 +72,8 @@ int yylex ( void );
 WholeEnchilada	: Combiners
 		{
 			$1.Validate();
+			if (optimize && errors.get_num_errors() == 0)
+				$1.Optimize();
 			$1.Invoke();
 		}
 		;
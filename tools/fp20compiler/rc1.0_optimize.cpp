@@ -0,0 +1,378 @@
+#include "rc1.0_combiners.h"
+#include "nvparse_errors.h"
+#include "nvparse_externs.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+// The rgb and alpha channels of a register are tracked separately, the blue
+// channel belongs to rgb
+#define CHANNEL_RGB   (1 << RCP_RGB)
+#define CHANNEL_ALPHA (1 << RCP_ALPHA)
+
+#define NUM_REGISTERS (REG_ONE + 1)
+
+static int ChannelBits(int channel)
+{
+    return (RCP_ALPHA == channel) ? CHANNEL_ALPHA : CHANNEL_RGB;
+}
+
+static int PortionBits(const GeneralPortionStruct& portion)
+{
+    return (RCP_RGB == portion.designator) ? CHANNEL_RGB : CHANNEL_ALPHA;
+}
+
+static bool IsPortionUnused(const GeneralPortionStruct& portion)
+{
+    int k;
+    for (k = 0; k < 3; k++)
+        if (REG_DISCARD != portion.gf.op[k].reg[0].reg.bits.name)
+            return false;
+    return true;
+}
+
+static bool IsStageUnused(const GeneralCombinerStruct& gc)
+{
+    return IsPortionUnused(gc.portion[0]) && IsPortionUnused(gc.portion[1]);
+}
+
+// Adds the register channels which the portion reads to regs. Products
+// which neither reach an output nor the sum aren't read.
+static void PortionReads(const GeneralPortionStruct& portion, int *regs)
+{
+    const OpStruct *op = portion.gf.op;
+    bool sumUsed = (REG_DISCARD != op[2].reg[0].reg.bits.name);
+
+    int k;
+    for (k = 0; k < 2; k++) {
+        if (REG_DISCARD == op[k].reg[0].reg.bits.name && !sumUsed)
+            continue;
+        regs[op[k].reg[1].reg.bits.name] |= ChannelBits(op[k].reg[1].reg.bits.channel);
+        regs[op[k].reg[2].reg.bits.name] |= ChannelBits(op[k].reg[2].reg.bits.channel);
+    }
+
+    // The mux selects by the most significant bit of spare0 alpha
+    if (sumUsed && RCP_MUX == op[2].op)
+        regs[REG_SPARE0] |= CHANNEL_ALPHA;
+}
+
+static void PortionWrites(const GeneralPortionStruct& portion, int *regs)
+{
+    int k;
+    for (k = 0; k < 3; k++) {
+        unsigned int name = portion.gf.op[k].reg[0].reg.bits.name;
+        if (REG_DISCARD != name)
+            regs[name] |= PortionBits(portion);
+    }
+}
+
+static void StageReads(const GeneralCombinerStruct& gc, int *regs)
+{
+    int p;
+    for (p = 0; p < 2; p++)
+        PortionReads(gc.portion[p], regs);
+}
+
+static void StageWrites(const GeneralCombinerStruct& gc, int *regs)
+{
+    int p;
+    for (p = 0; p < 2; p++)
+        PortionWrites(gc.portion[p], regs);
+}
+
+static int FindConst(const ConstColorStruct *cc, int numConsts, unsigned int name)
+{
+    int i;
+    for (i = 0; i < numConsts; i++)
+        if (cc[i].reg.bits.name == name)
+            return i;
+    return -1;
+}
+
+static bool SameConst(const ConstColorStruct& a, const ConstColorStruct& b)
+{
+    return !memcmp(a.v, b.v, sizeof(a.v));
+}
+
+// If output k of the portion is a plain copy of an input (x * 1), returns
+// that input in src
+static bool GetCopySource(const GeneralPortionStruct& portion, int k, MappedRegisterStruct& src)
+{
+    if (k > 1 || RCP_SCALE_BY_ONE != portion.bs.word)
+        return false;
+
+    const OpStruct& op = portion.gf.op[k];
+    if (RCP_MUL != op.op)
+        return false;
+
+    int i;
+    for (i = 1; i <= 2; i++) {
+        const MappedRegisterStruct& one = op.reg[i];
+        const MappedRegisterStruct& other = op.reg[3 - i];
+        if (REG_ZERO == one.reg.bits.name && MAP_UNSIGNED_INVERT == one.map &&
+            MAP_UNSIGNED_IDENTITY == other.map) {
+            src = other;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lets the final combiner read the source of general combiner outputs which
+// only copy a register, so the copy itself becomes dead. Both clamp their
+// inputs to [0, 1], so the value stays the same.
+void CombinersStruct::ForwardCopies()
+{
+    MappedRegisterStruct *inputs[] = {
+        &final.rgb.a, &final.rgb.b, &final.rgb.c, &final.rgb.d,
+        &final.product.e, &final.product.f, &final.alpha.g
+    };
+    int numInputs = sizeof(inputs) / sizeof(inputs[0]);
+
+    int i;
+    for (i = 0; i < numInputs; i++) {
+        MappedRegisterStruct& input = *inputs[i];
+        bool isAlphaInput = (&input == &final.alpha.g);
+        unsigned int name = input.reg.bits.name;
+        int bits = ChannelBits(input.reg.bits.channel);
+
+        // Find the last write to the channel
+        int stage;
+        MappedRegisterStruct src;
+        bool found = false;
+        bool isCopy = false;
+        for (stage = generals.num - 1; stage >= 0 && !found; stage--) {
+            int p;
+            for (p = 0; p < 2 && !found; p++) {
+                const GeneralPortionStruct& portion = generals.general[stage].portion[p];
+                if (!(PortionBits(portion) & bits))
+                    continue;
+                int k;
+                for (k = 0; k < 3; k++) {
+                    if (portion.gf.op[k].reg[0].reg.bits.name == name) {
+                        found = true;
+                        isCopy = GetCopySource(portion, k, src);
+                        break;
+                    }
+                }
+            }
+        }
+        if (!isCopy)
+            continue;
+        stage++;
+
+        // Pick the channel which the final combiner has to read
+        int channel = src.reg.bits.channel;
+        if (RCP_ALPHA == input.reg.bits.channel) {
+            // Only the final alpha input can read blue
+            if (RCP_BLUE == channel && !isAlphaInput)
+                continue;
+        } else if (RCP_BLUE == input.reg.bits.channel) {
+            if (RCP_RGB == channel)
+                channel = RCP_BLUE;
+        }
+
+        // The source must keep its value until the final combiner
+        int writes[NUM_REGISTERS] = { 0 };
+        int s;
+        for (s = stage; s < generals.num; s++)
+            StageWrites(generals.general[s], writes);
+        if (writes[src.reg.bits.name] & ChannelBits(channel))
+            continue;
+
+        // The final combiner only sees the global constants
+        if (REG_CONSTANT_COLOR0 == src.reg.bits.name || REG_CONSTANT_COLOR1 == src.reg.bits.name) {
+            int global = FindConst(cc, numConsts, src.reg.bits.name);
+            if (global < 0)
+                continue;
+            if (generals.localConsts > 0) {
+                const GeneralCombinerStruct& gc = generals.general[stage];
+                int local = FindConst(gc.cc, gc.numConsts, src.reg.bits.name);
+                if (local < 0 || !SameConst(gc.cc[local], cc[global]))
+                    continue;
+            }
+        }
+
+        input.reg.word = src.reg.word;
+        input.reg.bits.channel = channel;
+    }
+}
+
+// Discards outputs which are never read, walking from the final combiner
+// back to the first general combiner
+void CombinersStruct::RemoveDeadOutputs()
+{
+    int live[NUM_REGISTERS] = { 0 };
+
+    MappedRegisterStruct *inputs[] = {
+        &final.rgb.a, &final.rgb.b, &final.rgb.c, &final.rgb.d, &final.alpha.g
+    };
+    int numInputs = sizeof(inputs) / sizeof(inputs[0]);
+    bool productUsed = false;
+
+    int i;
+    for (i = 0; i < numInputs; i++) {
+        const RegisterEnum& reg = inputs[i]->reg;
+        if (REG_E_TIMES_F == reg.bits.name) {
+            productUsed = true;
+        } else if (REG_SPARE0_PLUS_SECONDARY_COLOR == reg.bits.name) {
+            live[REG_SPARE0] |= CHANNEL_RGB;
+            live[REG_SECONDARY_COLOR] |= CHANNEL_RGB;
+        } else {
+            live[reg.bits.name] |= ChannelBits(reg.bits.channel);
+        }
+    }
+    if (productUsed) {
+        live[final.product.e.reg.bits.name] |= ChannelBits(final.product.e.reg.bits.channel);
+        live[final.product.f.reg.bits.name] |= ChannelBits(final.product.f.reg.bits.channel);
+    }
+
+    int stage;
+    for (stage = generals.num - 1; stage >= 0; stage--) {
+        GeneralCombinerStruct& gc = generals.general[stage];
+
+        int p, k;
+        for (p = 0; p < 2; p++) {
+            GeneralPortionStruct& portion = gc.portion[p];
+            for (k = 0; k < 3; k++) {
+                RegisterEnum& dst = portion.gf.op[k].reg[0].reg;
+                if (REG_DISCARD != dst.bits.name && !(live[dst.bits.name] & PortionBits(portion)))
+                    dst.bits.name = REG_DISCARD;
+            }
+        }
+
+        // All inputs are read before any output is written
+        int writes[NUM_REGISTERS] = { 0 };
+        StageWrites(gc, writes);
+        for (i = 0; i < NUM_REGISTERS; i++)
+            live[i] &= ~writes[i];
+        StageReads(gc, live);
+    }
+}
+
+void CombinersStruct::RemoveUnusedStages()
+{
+    int num = 0;
+    int stage;
+    for (stage = 0; stage < generals.num; stage++) {
+        GeneralCombinerStruct& gc = generals.general[stage];
+        if (IsStageUnused(gc))
+            continue;
+
+        int p;
+        for (p = 0; p < 2; p++) {
+            if (IsPortionUnused(gc.portion[p])) {
+                int designator = gc.portion[p].designator;
+                gc.portion[p].ZeroOut();
+                gc.portion[p].designator = designator;
+            }
+        }
+        generals.general[num++] = gc;
+    }
+
+    // The hardware always runs at least one general combiner
+    if (num == 0) {
+        generals.general[0].ZeroOut();
+        num = 1;
+    }
+
+    for (stage = num; stage < generals.num; stage++)
+        generals.general[stage].ZeroOut();
+    generals.num = num;
+}
+
+// Merges the stage with the following one, if each of them only uses the
+// portion the other one leaves unused. Returns false if they can't be merged.
+bool CombinersStruct::MergeStages(int stage)
+{
+    GeneralCombinerStruct& a = generals.general[stage];
+    GeneralCombinerStruct& b = generals.general[stage + 1];
+
+    int p;
+    int moved = -1;
+    for (p = 0; p < 2; p++) {
+        if (IsPortionUnused(b.portion[p]))
+            continue;
+        if (moved >= 0)
+            return false;
+        moved = p;
+    }
+    if (moved < 0)
+        return false;
+
+    int target = -1;
+    for (p = 0; p < 2; p++)
+        if (a.portion[p].designator == b.portion[moved].designator)
+            target = p;
+    assert(target >= 0);
+    if (!IsPortionUnused(a.portion[target]))
+        return false;
+
+    // The moved portion can't depend on the results of the earlier stage.
+    // Reading what the earlier stage overwrites is fine, as a stage reads all
+    // of its inputs first.
+    int reads[NUM_REGISTERS] = { 0 };
+    int writes[NUM_REGISTERS] = { 0 };
+    PortionReads(b.portion[moved], reads);
+    StageWrites(a, writes);
+    int i;
+    for (i = 0; i < NUM_REGISTERS; i++)
+        if (reads[i] & writes[i])
+            return false;
+
+    // Per-stage constants have to agree
+    if (generals.localConsts > 0) {
+        int aReads[NUM_REGISTERS] = { 0 };
+        StageReads(a, aReads);
+
+        unsigned int names[] = { REG_CONSTANT_COLOR0, REG_CONSTANT_COLOR1 };
+        for (i = 0; i < 2; i++) {
+            if (!reads[names[i]])
+                continue;
+            int bc = FindConst(b.cc, b.numConsts, names[i]);
+            int ac = FindConst(a.cc, a.numConsts, names[i]);
+            if (bc < 0 || ac < 0)
+                continue;
+            if (aReads[names[i]] && !SameConst(a.cc[ac], b.cc[bc]))
+                return false;
+        }
+
+        for (i = 0; i < 2; i++) {
+            if (!reads[names[i]])
+                continue;
+            int bc = FindConst(b.cc, b.numConsts, names[i]);
+            if (bc < 0)
+                continue;
+            int ac = FindConst(a.cc, a.numConsts, names[i]);
+            if (ac < 0) {
+                assert(a.numConsts < 2);
+                ac = a.numConsts++;
+            }
+            a.cc[ac] = b.cc[bc];
+        }
+    }
+
+    a.portion[target] = b.portion[moved];
+
+    int s;
+    for (s = stage + 1; s < generals.num - 1; s++)
+        generals.general[s] = generals.general[s + 1];
+    generals.general[--generals.num].ZeroOut();
+    return true;
+}
+
+void CombinersStruct::Optimize()
+{
+    int original = generals.num;
+
+    ForwardCopies();
+    RemoveDeadOutputs();
+    RemoveUnusedStages();
+
+    int stage;
+    for (stage = 0; stage < generals.num - 1; stage++)
+        MergeStages(stage);
+
+    output.print("/* %d general combiner stages, %d after optimization */\n", original, generals.num);
+}
@@ -42,38 +42,38 @@ enum RegisterName {
 #ifdef __GNUC__
 __attribute__ ((unused))
 #endif
-static const char* GetRegisterNameString(unsigned int reg_name) {
+static unsigned int GetRegisterNameValue(unsigned int reg_name) {
     switch(reg_name) {
     case REG_ZERO:
-        return "0x0";
+        return 0x0;
     case REG_CONSTANT_COLOR0:
-        return "0x1";
+        return 0x1;
     case REG_CONSTANT_COLOR1:
-        return "0x2";
+        return 0x2;
     case REG_FOG:
-        return "0x3";
+        return 0x3;
     case REG_PRIMARY_COLOR:
-        return "0x4";
+        return 0x4;
     case REG_SECONDARY_COLOR:
-        return "0x5";
+        return 0x5;
     case REG_TEXTURE0:
-        return "0x8";
+        return 0x8;
     case REG_TEXTURE1:
-        return "0x9";
+        return 0x9;
     case REG_TEXTURE2:
-        return "0xa";
+        return 0xa;
     case REG_TEXTURE3:
-        return "0xb";
+        return 0xb;
     case REG_SPARE0:
-        return "0xc";
+        return 0xc;
     case REG_SPARE1:
-        return "0xd";
+        return 0xd;
     case REG_SPARE0_PLUS_SECONDARY_COLOR:
-        return "0xe";
+        return 0xe;
     case REG_E_TIMES_F:
-        return "0xf";
+        return 0xf;
     case REG_DISCARD:
-        return "0x0";
+        return 0x0;
     case REG_ONE:
         // REG_ONE is a pseudo-register that should have been 
         // mapped to REG_ZERO (with modifier) in MappedRegisterStruct::Init; 
@@ -85,7 +85,18 @@ static const char* GetRegisterNameString(unsigned int reg_name) {
         assert(false);
         break;
     }
-    return "UNKNOWN";
+    return 0;
+}
+
+#ifdef __GNUC__
+__attribute__ ((unused))
+#endif
+static const char* GetRegisterNameString(unsigned int reg_name) {
+    static const char* names[] = {
+        "0x0", "0x1", "0x2", "0x3", "0x4", "0x5", "0x6", "0x7",
+        "0x8", "0x9", "0xa", "0xb", "0xc", "0xd", "0xe", "0xf"
+    };
+    return names[GetRegisterNameValue(reg_name)];
 }
 
 #define BIAS_NONE 0
@@ -46,30 +46,85 @@ static unsigned int FloatToRaw(float value)
     return *(unsigned int*)&value;
 }
 
+// Values of the NV097_SET_SHADER_STAGE_PROGRAM_STAGEn_* programs, which are
+// the same for every stage that supports them
+static uint32_t StageProgramValue(const char* op)
+{
+    static const struct {
+        const char* name;
+        uint32_t value;
+    } programs[] = {
+        { "PROGRAM_NONE", 0x00 },
+        { "2D_PROJECTIVE", 0x01 },
+        { "3D_PROJECTIVE", 0x02 },
+        { "CUBE_MAP", 0x03 },
+        { "PASS_THROUGH", 0x04 },
+        { "CLIP_PLANE", 0x05 },
+        { "BUMPENVMAP", 0x06 },
+        { "BUMPENVMAP_LUMINANCE", 0x07 },
+        { "BRDF", 0x08 },
+        { "DOT_ST", 0x09 },
+        { "DOT_ZW", 0x0A },
+        { "DOT_REFLECT_DIFFUSE", 0x0B },
+        { "DOT_REFLECT_SPECULAR", 0x0C },
+        { "DOT_STR_3D", 0x0D },
+        { "DOT_STR_CUBE", 0x0E },
+        { "DEPENDENT_AR", 0x0F },
+        { "DEPENDENT_GB", 0x10 },
+        { "DOT_PRODUCT", 0x11 },
+        { "DOT_REFLECT_SPECULAR_CONST", 0x12 },
+    };
+
+    for (unsigned int i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        if (!strcmp(programs[i].name, op))
+            return programs[i].value;
+    }
+    assert(false);
+    return 0;
+}
+
 void InstList::Invoke()
 {
     int i;
 
-    printf("#pragma push_macro(\"MASK\")\n");
-    printf("#undef MASK\n");
-    printf("#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))\n");
-    printf("\n");
+    output.print("#pragma push_macro(\"MASK\")\n");
+    output.print("#undef MASK\n");
+    output.print("#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))\n");
+    output.print("\n");
+
+    static const uint32_t other_stage_input_masks[] = {
+        0,
+        NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE1,
+        NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE2,
+        NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE3
+    };
+    static const uint32_t stage_program_masks[] = {
+        NV097_SET_SHADER_STAGE_PROGRAM_STAGE0,
+        NV097_SET_SHADER_STAGE_PROGRAM_STAGE1,
+        NV097_SET_SHADER_STAGE_PROGRAM_STAGE2,
+        NV097_SET_SHADER_STAGE_PROGRAM_STAGE3
+    };
 
     assert(size > 1);
-    printf("pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT,\n    ");
+    assert(size <= 4);
+    uint32_t other_stage_input = 0;
+    output.print("pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT,\n    ");
     for (i=1; i<size; i++) {
-        if (i != 1) printf("    | ");
+        if (i != 1) output.print("    | ");
         int previousTexture = 0;
         if (list[i].opcode.bits.dependent)
             previousTexture = (int)list[i].args[0];
-        printf("MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE%d, %d)",
+        output.print("MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE%d, %d)",
             i, previousTexture);
-        if (i != size-1) printf("\n");
+        other_stage_input |= MASK(other_stage_input_masks[i], previousTexture);
+        if (i != size-1) output.print("\n");
     }
-    printf(");\n");
-    printf("p += 2;\n");
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(NV097_SET_SHADER_OTHER_STAGE_INPUT, other_stage_input);
 
-    printf("pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM,\n    ");
+    uint32_t stage_program = 0;
+    output.print("pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM,\n    ");
     for (i=0; i<size; i++) {
         const char* op = NULL;
         switch(list[i].opcode.word) {
@@ -219,13 +274,15 @@ void InstList::Invoke()
             assert(false);
             break;
         }
-        if (i != 0) printf("    | ");
-        printf("MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE%d, NV097_SET_SHADER_STAGE_PROGRAM_STAGE%d_%s)",
+        if (i != 0) output.print("    | ");
+        output.print("MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE%d, NV097_SET_SHADER_STAGE_PROGRAM_STAGE%d_%s)",
                i, i, op);
-        if (i != size-1) printf("\n");
+        stage_program |= MASK(stage_program_masks[i], StageProgramValue(op));
+        if (i != size-1) output.print("\n");
     }
-    printf(");\n");
-    printf("p += 2;\n");
+    output.print(");\n");
+    output.print("p += 2;\n");
+    output.method(NV097_SET_SHADER_STAGE_PROGRAM, stage_program);
 
     // Process texture stage mode arguments
     for (i=0; i<size; i++) {
@@ -242,13 +299,19 @@ void InstList::Invoke()
             float offset = list[i].args[5];
             float scale = list[i].args[6];
 
-            printf("pb_push(p++, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + %d * 64, 6);\n", i);
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[0] */\n", FloatToRaw(matrix[0]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[1] */\n", FloatToRaw(matrix[1]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[2] */\n", FloatToRaw(matrix[2]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[3] */\n", FloatToRaw(matrix[3]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE */\n", FloatToRaw(scale));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET */\n", FloatToRaw(offset));
+            output.print("pb_push(p++, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + %d * 64, 6);\n", i);
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[0] */\n", FloatToRaw(matrix[0]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[1] */\n", FloatToRaw(matrix[1]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[2] */\n", FloatToRaw(matrix[2]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[3] */\n", FloatToRaw(matrix[3]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE */\n", FloatToRaw(scale));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET */\n", FloatToRaw(offset));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 0, FloatToRaw(matrix[0]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 4, FloatToRaw(matrix[1]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 8, FloatToRaw(matrix[2]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 12, FloatToRaw(matrix[3]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE + i * 64, FloatToRaw(scale));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET + i * 64, FloatToRaw(offset));
             assert(false); /* Untested */
             break;
         }
@@ -258,12 +321,16 @@ void InstList::Invoke()
                 list[i].args[3], list[i].args[4]
             };
 
-            printf("/* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT */\n");
-            printf("pb_push(p++, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + %d * 64, 4);\n", i);
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[0] */\n", FloatToRaw(matrix[0]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[1] */\n", FloatToRaw(matrix[1]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[2] */\n", FloatToRaw(matrix[2]));
-            printf("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[3] */\n", FloatToRaw(matrix[3]));
+            output.print("/* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT */\n");
+            output.print("pb_push(p++, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + %d * 64, 4);\n", i);
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[0] */\n", FloatToRaw(matrix[0]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[1] */\n", FloatToRaw(matrix[1]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[2] */\n", FloatToRaw(matrix[2]));
+            output.print("*p++ = 0x%08x; /* NV097_SET_TEXTURE_SET_BUMP_ENV_MAT m[3] */\n", FloatToRaw(matrix[3]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 0, FloatToRaw(matrix[0]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 4, FloatToRaw(matrix[1]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 8, FloatToRaw(matrix[2]));
+            output.method(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 64 + 12, FloatToRaw(matrix[3]));
             break;
         }
         case TSP_DOT_PRODUCT_REFLECT_CUBE_MAP_CONST_EYE_1_OF_3:
@@ -275,11 +342,15 @@ void InstList::Invoke()
             float eye_vector_z = list[i].args[3];
             float eye_vector_w = 1.0f;
 
-            printf("pb_push(p++, NV097_SET_EYE_VECTOR, 4);\n");
-            printf("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR x */\n", FloatToRaw(eye_vector_x));
-            printf("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR y */\n", FloatToRaw(eye_vector_y));
-            printf("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR z */\n", FloatToRaw(eye_vector_z));
-            printf("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR w */\n", FloatToRaw(eye_vector_w));
+            output.print("pb_push(p++, NV097_SET_EYE_VECTOR, 4);\n");
+            output.print("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR x */\n", FloatToRaw(eye_vector_x));
+            output.print("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR y */\n", FloatToRaw(eye_vector_y));
+            output.print("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR z */\n", FloatToRaw(eye_vector_z));
+            output.print("*p++ = 0x%08x; /* NV097_SET_EYE_VECTOR w */\n", FloatToRaw(eye_vector_w));
+            output.method(NV097_SET_EYE_VECTOR + 0, FloatToRaw(eye_vector_x));
+            output.method(NV097_SET_EYE_VECTOR + 4, FloatToRaw(eye_vector_y));
+            output.method(NV097_SET_EYE_VECTOR + 8, FloatToRaw(eye_vector_z));
+            output.method(NV097_SET_EYE_VECTOR + 12, FloatToRaw(eye_vector_w));
             assert(false); /* Untested */
             break;
         }
@@ -288,8 +359,8 @@ void InstList::Invoke()
         }
     }
 
-    printf("\n");
-    printf("#pragma pop_macro(\"MASK\")\n");
+    output.print("\n");
+    output.print("#pragma pop_macro(\"MASK\")\n");
 }
 
 void InstList::Validate()
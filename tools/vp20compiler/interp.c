@@ -0,0 +1,443 @@
+#include <math.h>
+#include <string.h>
+
+#include "interp.h"
+#include "vsh.h"
+
+// Vertices are executed side by side, the GCC vector extensions map the
+// lanes to SSE registers on x86 hosts.
+#define VSH_LANES 4
+
+typedef float VshLanes __attribute__((vector_size(VSH_LANES * sizeof(float))));
+typedef int32_t VshLaneMask __attribute__((vector_size(VSH_LANES * sizeof(int32_t))));
+
+// A register of all lanes, one vector per component
+typedef struct VshVec {
+    VshLanes c[4];
+} VshVec;
+
+typedef struct VshState {
+    VshVec v[VSH_NUM_INPUTS];
+    VshVec r[MAX_NV_VERTEX_PROGRAM_TEMPS - 1];
+    VshVec o[VSH_NUM_OUTPUTS];
+    VshLaneMask a0;
+    unsigned int active;
+} VshState;
+
+static const VshFieldName mux_field[3] = {FLD_A_MUX, FLD_B_MUX, FLD_C_MUX};
+static const VshFieldName swizzle_field[3][4] = {
+    {FLD_A_SWZ_X, FLD_A_SWZ_Y, FLD_A_SWZ_Z, FLD_A_SWZ_W},
+    {FLD_B_SWZ_X, FLD_B_SWZ_Y, FLD_B_SWZ_Z, FLD_B_SWZ_W},
+    {FLD_C_SWZ_X, FLD_C_SWZ_Y, FLD_C_SWZ_Z, FLD_C_SWZ_W},
+};
+static const VshFieldName reg_field[3] = {FLD_A_R, FLD_B_R, FLD_C_R};
+static const VshFieldName neg_field[3] = {FLD_A_NEG, FLD_B_NEG, FLD_C_NEG};
+
+static VshLanes vsh_splat(float f)
+{
+    return (VshLanes){ f, f, f, f };
+}
+
+static VshLanes vsh_select(VshLaneMask mask, VshLanes a, VshLanes b)
+{
+    return (VshLanes)(((VshLaneMask)a & mask) | ((VshLaneMask)b & ~mask));
+}
+
+// R12 reads and writes the position output
+static VshVec *vsh_temp(VshState *s, unsigned int index)
+{
+    return index == 12 ? &s->o[0] : &s->r[index];
+}
+
+// Whether the slot consumes input A, B or C
+static bool vsh_uses_source(const VshDecodedSlot *slot, int j)
+{
+    switch (j) {
+    case 0:
+        return slot->mac != MAC_NOP;
+    case 1:
+        return slot->mac != MAC_NOP && slot->mac != MAC_MOV &&
+               slot->mac != MAC_ADD && slot->mac != MAC_ARL;
+    default:
+        return slot->mac == MAC_ADD || slot->mac == MAC_MAD || slot->ilu != ILU_NOP;
+    }
+}
+
+bool vsh_interp_load(VshProgram *program, const uint32_t *tokens, unsigned int max_slots)
+{
+    program->num_slots = 0;
+    program->inputs_read = 0;
+
+    unsigned int i;
+    for (i=0; i<max_slots && i<MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS; i++) {
+        const uint32_t *token = &tokens[i * VSH_TOKEN_SIZE];
+        VshDecodedSlot *slot = &program->slots[i];
+
+        slot->ilu = vsh_get_field(token, FLD_ILU);
+        slot->mac = vsh_get_field(token, FLD_MAC);
+        slot->const_index = vsh_get_field(token, FLD_CONST);
+        slot->relative = vsh_get_field(token, FLD_A0X);
+        slot->input = vsh_get_field(token, FLD_V);
+        if (slot->mac > MAC_ARL) {
+            return false;
+        }
+
+        int j;
+        for (j=0; j<3; j++) {
+            VshSource *src = &slot->src[j];
+            src->mux = vsh_get_field(token, mux_field[j]);
+            src->index = vsh_get_field(token, reg_field[j]);
+            src->negate = vsh_get_field(token, neg_field[j]);
+            int k;
+            for (k=0; k<4; k++) {
+                src->swizzle[k] = vsh_get_field(token, swizzle_field[j][k]);
+            }
+
+            if (!vsh_uses_source(slot, j)) {
+                continue;
+            }
+            if (src->mux == PARAM_R && src->index >= MAX_NV_VERTEX_PROGRAM_TEMPS) {
+                return false;
+            }
+            if (src->mux == PARAM_V) {
+                program->inputs_read |= 1 << slot->input;
+            }
+        }
+
+        slot->mac_mask = vsh_get_field(token, FLD_OUT_MAC_MASK);
+        slot->ilu_mask = vsh_get_field(token, FLD_OUT_ILU_MASK);
+        slot->out_r = vsh_get_field(token, FLD_OUT_R);
+        slot->o_mask = vsh_get_field(token, FLD_OUT_O_MASK);
+        slot->orb = vsh_get_field(token, FLD_OUT_ORB);
+        slot->out_address = vsh_get_field(token, FLD_OUT_ADDRESS);
+        slot->out_mux = vsh_get_field(token, FLD_OUT_MUX);
+
+        if ((slot->mac_mask || slot->ilu_mask) && slot->out_r >= MAX_NV_VERTEX_PROGRAM_TEMPS) {
+            return false;
+        }
+        if (slot->o_mask) {
+            unsigned int limit = slot->orb == OUTPUT_O ? VSH_NUM_OUTPUTS : VSH_NUM_CONSTANTS;
+            if (slot->out_address >= limit) {
+                return false;
+            }
+        }
+
+        if (vsh_get_field(token, FLD_FINAL)) {
+            program->num_slots = i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void vsh_interp_stats(const VshProgram *program, VshStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->num_slots = program->num_slots;
+
+    unsigned int i;
+    for (i=0; i<program->num_slots; i++) {
+        const VshDecodedSlot *slot = &program->slots[i];
+        if (slot->mac != MAC_NOP) {
+            stats->num_mac++;
+        }
+        if (slot->ilu != ILU_NOP) {
+            stats->num_ilu++;
+        }
+        if (slot->mac != MAC_NOP && slot->ilu != ILU_NOP) {
+            stats->num_paired++;
+        }
+    }
+}
+
+static void vsh_read(VshState *s, const VshDecodedSlot *slot,
+                     float constants[VSH_NUM_CONSTANTS][4], int j, VshVec *out)
+{
+    const VshSource *src = &slot->src[j];
+    VshVec value;
+    int k;
+
+    switch (src->mux) {
+    case PARAM_R:
+        value = *vsh_temp(s, src->index);
+        break;
+    case PARAM_V:
+        value = s->v[slot->input];
+        break;
+    case PARAM_C:
+        if (!slot->relative) {
+            for (k=0; k<4; k++) {
+                value.c[k] = vsh_splat(constants[slot->const_index][k]);
+            }
+        } else {
+            // Each vertex has its own address register, constants outside
+            // of the register file read as zero
+            int l;
+            for (l=0; l<VSH_LANES; l++) {
+                int index = slot->const_index + s->a0[l];
+                for (k=0; k<4; k++) {
+                    value.c[k][l] = (index >= 0 && index < VSH_NUM_CONSTANTS) ? constants[index][k] : 0.0f;
+                }
+            }
+        }
+        break;
+    default:
+        memset(&value, 0, sizeof(value));
+        break;
+    }
+
+    for (k=0; k<4; k++) {
+        out->c[k] = src->negate ? -value.c[src->swizzle[k]] : value.c[src->swizzle[k]];
+    }
+}
+
+static void vsh_broadcast(VshVec *out, VshLanes value)
+{
+    int k;
+    for (k=0; k<4; k++) {
+        out->c[k] = value;
+    }
+}
+
+static void vsh_mac(uint8_t mac, const VshVec *a, const VshVec *b, const VshVec *c, VshVec *out)
+{
+    int k;
+
+    switch (mac) {
+    case MAC_MOV:
+        *out = *a;
+        break;
+    case MAC_MUL:
+        for (k=0; k<4; k++) {
+            out->c[k] = a->c[k] * b->c[k];
+        }
+        break;
+    case MAC_ADD:
+        for (k=0; k<4; k++) {
+            out->c[k] = a->c[k] + c->c[k];
+        }
+        break;
+    case MAC_MAD:
+        for (k=0; k<4; k++) {
+            out->c[k] = a->c[k] * b->c[k] + c->c[k];
+        }
+        break;
+    case MAC_DP3:
+        vsh_broadcast(out, a->c[0] * b->c[0] + a->c[1] * b->c[1] + a->c[2] * b->c[2]);
+        break;
+    case MAC_DPH:
+        vsh_broadcast(out, a->c[0] * b->c[0] + a->c[1] * b->c[1] + a->c[2] * b->c[2] + b->c[3]);
+        break;
+    case MAC_DP4:
+        vsh_broadcast(out, a->c[0] * b->c[0] + a->c[1] * b->c[1] + a->c[2] * b->c[2] + a->c[3] * b->c[3]);
+        break;
+    case MAC_DST:
+        out->c[0] = vsh_splat(1.0f);
+        out->c[1] = a->c[1] * b->c[1];
+        out->c[2] = a->c[2];
+        out->c[3] = b->c[3];
+        break;
+    case MAC_MIN:
+        for (k=0; k<4; k++) {
+            out->c[k] = vsh_select(a->c[k] < b->c[k], a->c[k], b->c[k]);
+        }
+        break;
+    case MAC_MAX:
+        for (k=0; k<4; k++) {
+            out->c[k] = vsh_select(a->c[k] > b->c[k], a->c[k], b->c[k]);
+        }
+        break;
+    case MAC_SLT:
+        for (k=0; k<4; k++) {
+            out->c[k] = vsh_select(a->c[k] < b->c[k], vsh_splat(1.0f), vsh_splat(0.0f));
+        }
+        break;
+    case MAC_SGE:
+        for (k=0; k<4; k++) {
+            out->c[k] = vsh_select(a->c[k] >= b->c[k], vsh_splat(1.0f), vsh_splat(0.0f));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// The ILU operates on scalars, so it is evaluated lane by lane
+static void vsh_ilu(uint8_t ilu, const VshVec *c, VshVec *out)
+{
+    int l;
+
+    if (ilu == ILU_MOV) {
+        *out = *c;
+        return;
+    }
+
+    for (l=0; l<VSH_LANES; l++) {
+        float x = c->c[0][l];
+        float r[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        switch (ilu) {
+        case ILU_RCP:
+            r[0] = r[1] = r[2] = r[3] = 1.0f / x;
+            break;
+        case ILU_RCC: {
+            float f = 1.0f / x;
+            if (f > 0.0f) {
+                f = fminf(fmaxf(f, 5.42101e-020f), 1.884467e+019f);
+            } else if (f < 0.0f) {
+                f = fmaxf(fminf(f, -5.42101e-020f), -1.884467e+019f);
+            }
+            r[0] = r[1] = r[2] = r[3] = f;
+            break;
+        }
+        case ILU_RSQ:
+            r[0] = r[1] = r[2] = r[3] = 1.0f / sqrtf(fabsf(x));
+            break;
+        case ILU_EXP:
+            r[0] = exp2f(floorf(x));
+            r[1] = x - floorf(x);
+            r[2] = exp2f(x);
+            break;
+        case ILU_LOG: {
+            float t = fabsf(x);
+            if (t == 0.0f) {
+                r[0] = r[2] = -INFINITY;
+            } else if (isinf(t)) {
+                r[0] = r[2] = INFINITY;
+            } else {
+                int e;
+                float m = frexpf(t, &e);
+                r[0] = e - 1;
+                r[1] = m * 2.0f;
+                r[2] = log2f(t);
+            }
+            break;
+        }
+        case ILU_LIT: {
+            float dot_n = fmaxf(x, 0.0f);
+            float dot_h = fmaxf(c->c[1][l], 0.0f);
+            float power = fminf(fmaxf(c->c[3][l], -127.9961f), 127.9961f);
+            r[1] = dot_n;
+            r[2] = dot_n > 0.0f ? powf(dot_h, power) : 0.0f;
+            break;
+        }
+        default:
+            break;
+        }
+
+        int k;
+        for (k=0; k<4; k++) {
+            out->c[k][l] = r[k];
+        }
+    }
+}
+
+static void vsh_write(VshVec *dst, const VshVec *value, uint8_t mask)
+{
+    int k;
+    for (k=0; k<4; k++) {
+        if (mask & (8 >> k)) {
+            dst->c[k] = value->c[k];
+        }
+    }
+}
+
+static void vsh_write_output(VshState *s, const VshDecodedSlot *slot,
+                             float constants[VSH_NUM_CONSTANTS][4], const VshVec *value)
+{
+    if (slot->orb == OUTPUT_O) {
+        vsh_write(&s->o[slot->out_address], value, slot->o_mask);
+        return;
+    }
+
+    // All vertices share the constants, the last one wins
+    int k;
+    for (k=0; k<4; k++) {
+        if (slot->o_mask & (8 >> k)) {
+            constants[slot->out_address][k] = value->c[k][s->active - 1];
+        }
+    }
+}
+
+static void vsh_step(VshState *s, const VshDecodedSlot *slot, float constants[VSH_NUM_CONSTANTS][4])
+{
+    VshVec src[3];
+    VshVec mac_result;
+    VshVec ilu_result;
+
+    // Both units read their operands before either of them writes
+    int j;
+    for (j=0; j<3; j++) {
+        if (vsh_uses_source(slot, j)) {
+            vsh_read(s, slot, constants, j, &src[j]);
+        }
+    }
+
+    if (slot->mac == MAC_ARL) {
+        int l;
+        for (l=0; l<VSH_LANES; l++) {
+            s->a0[l] = (int32_t)floorf(src[0].c[0][l]);
+        }
+    } else if (slot->mac != MAC_NOP) {
+        vsh_mac(slot->mac, &src[0], &src[1], &src[2], &mac_result);
+        vsh_write(vsh_temp(s, slot->out_r), &mac_result, slot->mac_mask);
+        if (slot->o_mask && slot->out_mux == OMUX_MAC) {
+            vsh_write_output(s, slot, constants, &mac_result);
+        }
+    }
+
+    if (slot->ilu != ILU_NOP) {
+        vsh_ilu(slot->ilu, &src[2], &ilu_result);
+        // The ILU writes R1 when it shares the slot with the MAC
+        unsigned int index = slot->mac != MAC_NOP ? 1 : slot->out_r;
+        vsh_write(vsh_temp(s, index), &ilu_result, slot->ilu_mask);
+        if (slot->o_mask && slot->out_mux == OMUX_ILU) {
+            vsh_write_output(s, slot, constants, &ilu_result);
+        }
+    }
+}
+
+void vsh_interp_run(const VshProgram *program,
+                    float constants[VSH_NUM_CONSTANTS][4],
+                    const float (*inputs)[VSH_NUM_INPUTS][4],
+                    float (*outputs)[VSH_NUM_OUTPUTS][4],
+                    unsigned int num_vertices)
+{
+    VshState s;
+
+    unsigned int first;
+    for (first=0; first<num_vertices; first+=VSH_LANES) {
+        unsigned int active = num_vertices - first < VSH_LANES ? num_vertices - first : VSH_LANES;
+        memset(&s, 0, sizeof(s));
+        s.active = active;
+
+        // Transpose the inputs into one vector per component. Lanes without
+        // a vertex repeat the last one, their results are discarded.
+        int i, k, l;
+        for (i=0; i<VSH_NUM_INPUTS; i++) {
+            if (!(program->inputs_read & (1 << i))) {
+                continue;
+            }
+            for (l=0; l<VSH_LANES; l++) {
+                const float *in = inputs[first + (l < active ? l : active - 1)][i];
+                for (k=0; k<4; k++) {
+                    s.v[i].c[k][l] = in[k];
+                }
+            }
+        }
+
+        unsigned int n;
+        for (n=0; n<program->num_slots; n++) {
+            vsh_step(&s, &program->slots[n], constants);
+        }
+
+        for (l=0; l<active; l++) {
+            for (i=0; i<VSH_NUM_OUTPUTS; i++) {
+                for (k=0; k<4; k++) {
+                    outputs[first + l][i][k] = s.o[i].c[k][l];
+                }
+            }
+        }
+    }
+}
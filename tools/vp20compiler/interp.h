@@ -0,0 +1,70 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#define VSH_NUM_CONSTANTS MAX_NV_VERTEX_PROGRAM_PARAMS
+#define VSH_NUM_INPUTS    MAX_HARDWARE_INPUTS
+#define VSH_NUM_OUTPUTS   MAX_HARDWARE_OUTPUTS
+
+typedef struct VshSource {
+    uint8_t mux;
+    uint8_t index;
+    uint8_t swizzle[4];
+    bool negate;
+} VshSource;
+
+// One slot of the transform program with its fields already extracted
+typedef struct VshDecodedSlot {
+    uint8_t ilu;
+    uint8_t mac;
+    uint8_t const_index;
+    bool relative;
+    uint8_t input;
+    VshSource src[3];
+    uint8_t mac_mask;
+    uint8_t ilu_mask;
+    uint8_t out_r;
+    uint8_t o_mask;
+    uint8_t orb;
+    uint8_t out_address;
+    uint8_t out_mux;
+} VshDecodedSlot;
+
+typedef struct VshProgram {
+    unsigned int num_slots;
+    // Inputs which are read by the program
+    uint16_t inputs_read;
+    VshDecodedSlot slots[MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS];
+} VshProgram;
+
+// Static cost of one vertex. The transform engine issues one slot per step,
+// so num_slots is the number of steps per vertex.
+typedef struct VshStats {
+    unsigned int num_slots;
+    unsigned int num_mac;
+    unsigned int num_ilu;
+    unsigned int num_paired;
+} VshStats;
+
+// Decodes the transform tokens (VSH_TOKEN_SIZE DWORDs per slot) up to the
+// slot with the final bit set. Returns false if the program is invalid or
+// has no final slot within max_slots.
+bool vsh_interp_load(VshProgram *program, const uint32_t *tokens, unsigned int max_slots);
+
+void vsh_interp_stats(const VshProgram *program, VshStats *stats);
+
+// Runs the program for each vertex. Vertices are processed in groups of
+// four, one per SIMD lane. Temporaries, outputs and the address register
+// start out as zero for every vertex. Writes to constants are visible to
+// all vertices from the following slot on.
+void vsh_interp_run(const VshProgram *program,
+                    float constants[VSH_NUM_CONSTANTS][4],
+                    const float (*inputs)[VSH_NUM_INPUTS][4],
+                    float (*outputs)[VSH_NUM_OUTPUTS][4],
+                    unsigned int num_vertices);
+
+#endif
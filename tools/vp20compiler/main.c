@@ -3,229 +3,93 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "nvvertparse.h"
-#include "prog_instruction.h"
-#include "mtypes.h"
-
-
-#define VSH_TOKEN_SIZE 4
-
-typedef enum {
-    FLD_ILU = 0,
-    FLD_MAC,
-    FLD_CONST,
-    FLD_V,
-    // Input A
-    FLD_A_NEG,
-    FLD_A_SWZ_X,
-    FLD_A_SWZ_Y,
-    FLD_A_SWZ_Z,
-    FLD_A_SWZ_W,
-    FLD_A_R,
-    FLD_A_MUX,
-    // Input B
-    FLD_B_NEG,
-    FLD_B_SWZ_X,
-    FLD_B_SWZ_Y,
-    FLD_B_SWZ_Z,
-    FLD_B_SWZ_W,
-    FLD_B_R,
-    FLD_B_MUX,
-    // Input C
-    FLD_C_NEG,
-    FLD_C_SWZ_X,
-    FLD_C_SWZ_Y,
-    FLD_C_SWZ_Z,
-    FLD_C_SWZ_W,
-    FLD_C_R_HIGH,
-    FLD_C_R_LOW,
-    FLD_C_MUX,
-    // Output
-    FLD_OUT_MAC_MASK,
-    FLD_OUT_R,
-    FLD_OUT_ILU_MASK,
-    FLD_OUT_O_MASK,
-    FLD_OUT_ORB,
-    FLD_OUT_ADDRESS,
-    FLD_OUT_MUX,
-    // Relative addressing
-    FLD_A0X,
-    // Final instruction
-    FLD_FINAL,
-
-    FLD_C_R, //hax
-} VshFieldName;
-
-
-
-
-typedef enum {
-    PARAM_UNKNOWN = 0,
-    PARAM_R,
-    PARAM_V,
-    PARAM_C
-} VshParameterType;
-
-typedef enum {
-    OUTPUT_C = 0,
-    OUTPUT_O
-} VshOutputType;
-
-typedef enum {
-    OMUX_MAC = 0,
-    OMUX_ILU
-} VshOutputMux;
-
-typedef enum {
-    ILU_NOP = 0,
-    ILU_MOV,
-    ILU_RCP,
-    ILU_RCC,
-    ILU_RSQ,
-    ILU_EXP,
-    ILU_LOG,
-    ILU_LIT
-} VshILU;
-
-typedef enum {
-    MAC_NOP,
-    MAC_MOV,
-    MAC_MUL,
-    MAC_ADD,
-    MAC_MAD,
-    MAC_DP3,
-    MAC_DPH,
-    MAC_DP4,
-    MAC_DST,
-    MAC_MIN,
-    MAC_MAX,
-    MAC_SLT,
-    MAC_SGE,
-    MAC_ARL
-} VshMAC;
-
-// typedef enum {
-//     SWIZZLE_X = 0,
-//     SWIZZLE_Y,
-//     SWIZZLE_Z,
-//     SWIZZLE_W
-// } VshSwizzle;
-
-
-typedef struct VshFieldMapping {
-    VshFieldName field_name;
-    uint8_t subtoken;
-    uint8_t start_bit;
-    uint8_t bit_length;
-} VshFieldMapping;
-
-static const VshFieldMapping field_mapping[] = {
-    // Field Name         DWORD BitPos BitSize
-    {  FLD_ILU,              1,   25,     3 },
-    {  FLD_MAC,              1,   21,     4 },
-    {  FLD_CONST,            1,   13,     8 },
-    {  FLD_V,                1,    9,     4 },
-    // INPUT A
-    {  FLD_A_NEG,            1,    8,     1 },
-    {  FLD_A_SWZ_X,          1,    6,     2 },
-    {  FLD_A_SWZ_Y,          1,    4,     2 },
-    {  FLD_A_SWZ_Z,          1,    2,     2 },
-    {  FLD_A_SWZ_W,          1,    0,     2 },
-    {  FLD_A_R,              2,   28,     4 },
-    {  FLD_A_MUX,            2,   26,     2 },
-    // INPUT B
-    {  FLD_B_NEG,            2,   25,     1 },
-    {  FLD_B_SWZ_X,          2,   23,     2 },
-    {  FLD_B_SWZ_Y,          2,   21,     2 },
-    {  FLD_B_SWZ_Z,          2,   19,     2 },
-    {  FLD_B_SWZ_W,          2,   17,     2 },
-    {  FLD_B_R,              2,   13,     4 },
-    {  FLD_B_MUX,            2,   11,     2 },
-    // INPUT C
-    {  FLD_C_NEG,            2,   10,     1 },
-    {  FLD_C_SWZ_X,          2,    8,     2 },
-    {  FLD_C_SWZ_Y,          2,    6,     2 },
-    {  FLD_C_SWZ_Z,          2,    4,     2 },
-    {  FLD_C_SWZ_W,          2,    2,     2 },
-    {  FLD_C_R_HIGH,         2,    0,     2 },
-    {  FLD_C_R_LOW,          3,   30,     2 },
-    {  FLD_C_MUX,            3,   28,     2 },
-    // Output
-    {  FLD_OUT_MAC_MASK,     3,   24,     4 },
-    {  FLD_OUT_R,            3,   20,     4 },
-    {  FLD_OUT_ILU_MASK,     3,   16,     4 },
-    {  FLD_OUT_O_MASK,       3,   12,     4 },
-    {  FLD_OUT_ORB,          3,   11,     1 },
-    {  FLD_OUT_ADDRESS,      3,    3,     8 },
-    {  FLD_OUT_MUX,          3,    2,     1 },
-    // Other
-    {  FLD_A0X,              3,    1,     1 },
-    {  FLD_FINAL,            3,    0,     1 }
-};
-
-typedef enum {
-    MASK_W = 1,   
-    MASK_Z,   
-    MASK_ZW,  
-    MASK_Y,   
-    MASK_YW,  
-    MASK_YZ,  
-    MASK_YZW, 
-    MASK_X,   
-    MASK_XW,  
-    MASK_XZ,  
-    MASK_XZW, 
-    MASK_XY,  
-    MASK_XYW, 
-    MASK_XYZ, 
-    MASK_XYZW,
-} VshMask;
-
-
-void vsh_set_field(uint32_t *shader_token, VshFieldName field_name, uint8_t v)
+#include "interp.h"
+#include "vp20.h"
+#include "vsh.h"
+
+#include "../../lib/pbkit/nv_regs.h"
+#include "../../lib/pbkit/pbkit_blob.h"
+
+
+#define MASK(mask, val) (((val) << (__builtin_ffs(mask)-1)) & (mask))
+#define PB_PACKET(method, count) (((count) << 18) | (method))
+
+// SET_TRANSFORM_PROGRAM spans 32 DWORDs, each packet loads up to 8 slots
+#define TRANSFORM_PROGRAM_RUN 32
+
+// Writes the program as a pushbuffer blob for pb_push_blob. It selects
+// program mode, loads the program at slot 0 and starts it from there.
+static void write_blob(FILE* fh, const uint32_t* vsh_buf, unsigned int num_slots)
 {
-    if (field_name == FLD_C_R) {
-        vsh_set_field(shader_token, FLD_C_R_LOW, v & 3);
-        vsh_set_field(shader_token, FLD_C_R_HIGH, (v >> 2));
-        return;
+    uint32_t data[5 + VP20_MAX_SLOTS * (VP20_TOKEN_SIZE + 1)];
+    uint32_t* p = data;
+
+    // EXECUTION_MODE, CXT_WRITE_EN, LOAD and START are consecutive methods
+    *p++ = PB_PACKET(NV097_SET_TRANSFORM_EXECUTION_MODE, 4);
+    *p++ = MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_MODE_PROGRAM)
+           | MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE_PRIV);
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+
+    unsigned int remaining = num_slots * VP20_TOKEN_SIZE;
+    const uint32_t* src = vsh_buf;
+    while (remaining > 0) {
+        unsigned int count = remaining < TRANSFORM_PROGRAM_RUN ? remaining : TRANSFORM_PROGRAM_RUN;
+        *p++ = PB_PACKET(NV097_SET_TRANSFORM_PROGRAM, count);
+        memcpy(p, src, count * sizeof(uint32_t));
+        p += count;
+        src += count;
+        remaining -= count;
     }
-    VshFieldMapping f = field_mapping[field_name];
-    uint32_t f_bits = (1<<f.bit_length)-1;
-    shader_token[f.subtoken] &= ~(f_bits << f.start_bit);
-    shader_token[f.subtoken] |= (uint32_t)(v & f_bits) << f.start_bit;
-}
 
+    pb_blob_header_t header;
+    header.magic = PB_BLOB_MAGIC;
+    header.version = PB_BLOB_VERSION;
+    header.size = p - data;
 
-static uint8_t vsh_mask(unsigned int write_mask) {
-    switch (write_mask) {
-    case WRITEMASK_X: return MASK_X;
-    case WRITEMASK_Y: return MASK_Y;
-    case WRITEMASK_XY: return MASK_XY;
-    case WRITEMASK_Z: return MASK_Z;
-    case WRITEMASK_XZ: return MASK_XZ;
-    case WRITEMASK_YZ: return MASK_YZ;
-    case WRITEMASK_XYZ: return MASK_XYZ;
-    case WRITEMASK_W: return MASK_W;
-    case WRITEMASK_XW: return MASK_XW;
-    case WRITEMASK_YW: return MASK_YW;
-    case WRITEMASK_XYW: return MASK_XYW;
-    case WRITEMASK_ZW: return MASK_ZW;
-    case WRITEMASK_XZW: return MASK_XZW;
-    case WRITEMASK_YZW: return MASK_YZW;
-    case WRITEMASK_XYZW: return MASK_XYZW;
-    default:
-        assert(false);
-        return 0;
+    fwrite(&header, sizeof(header), 1, fh);
+    fwrite(data, sizeof(uint32_t), header.size, fh);
+}
+
+static void print_message(const char* filename, const char* kind, const Vp20Message* message)
+{
+    if (message->line > 0) {
+        fprintf(stderr, "%s: %s: line %d, column %d: %s\n",
+                filename, kind, message->line, message->column, message->message);
+    } else {
+        fprintf(stderr, "%s: %s: %s\n", filename, kind, message->message);
     }
 }
 
-void translate(const char* str)
+static bool compile(const char* filename, const char* str, bool optimize, Vp20Result* result)
 {
-    struct prog_instruction *instructions = NULL;
-    unsigned int num_instructions = 0;
+    bool ok = vp20_compile(str, optimize, result);
 
-    int r = parse_nv_vertex_program(str, &instructions, &num_instructions);
+    unsigned int i;
+    for (i=0; i<result->num_warnings; i++) {
+        print_message(filename, "warning", &result->warnings[i]);
+    }
+    if (!ok) {
+        print_message(filename, "error", &result->error);
+    }
+
+    return ok;
+}
+
+// Writes the program as C array initializers, preceded by the comments of
+// the source, or as a pushbuffer blob. Returns nonzero on error.
+static int translate(FILE* fh, const char* filename, const char* str, bool optimize, bool binary)
+{
+    Vp20Result result;
+    if (!compile(filename, str, optimize, &result)) {
+        return 1;
+    }
 
 //     int r = parse_nv_vertex_program(
 // "!!VP1.1\n"
@@ -291,279 +155,119 @@ void translate(const char* str)
         if (cr == NULL) { cr = end; }
         const char* line_end = (lf < cr ? lf : cr) + 1;
 
-        if (*cur == '#') {
-            printf("//%.*s\n", line_end - &cur[1] - 1, &cur[1]);
+        if (*cur == '#' && !binary) {
+            fprintf(fh, "//%.*s\n", (int)(line_end - &cur[1] - 1), &cur[1]);
         }
 
         cur = line_end;
 
     }
 
-    uint32_t vsh_buf[136*4];
-    memset(vsh_buf, 0, sizeof(vsh_buf));
-
-    uint32_t* vsh_ins = vsh_buf;
+    if (binary) {
+        write_blob(fh, result.tokens, result.num_slots);
+        return 0;
+    }
 
-    int i;
-    for (i=0; i<num_instructions; i++) {
-        struct prog_instruction ins = instructions[i];
+    if (optimize) {
+        fprintf(fh, "// %u instructions, %u after optimization\n", result.num_instructions, result.num_slots);
+    }
+    uint32_t* vsh_ins = &result.tokens[result.num_slots * VP20_TOKEN_SIZE];
 
-        if (ins.Opcode == OPCODE_END) {
-            break;
-        }
+    for (uint32_t* pvsh = result.tokens; pvsh < vsh_ins; pvsh += 4) {
+        fprintf(fh, "0x%08x, 0x%08x, 0x%08x, 0x%08x,\n", pvsh[0], pvsh[1], pvsh[2], pvsh[3]);
+    }
 
-        // printf("%s\n", _mesa_opcode_string(ins.Opcode));
-
-        vsh_set_field(vsh_ins, FLD_ILU, ILU_NOP);
-        vsh_set_field(vsh_ins, FLD_MAC, MAC_NOP);
-        vsh_set_field(vsh_ins, FLD_A_SWZ_X, SWIZZLE_X);
-        vsh_set_field(vsh_ins, FLD_A_SWZ_Y, SWIZZLE_Y);
-        vsh_set_field(vsh_ins, FLD_A_SWZ_Z, SWIZZLE_Z);
-        vsh_set_field(vsh_ins, FLD_A_SWZ_W, SWIZZLE_W);
-        vsh_set_field(vsh_ins, FLD_A_MUX, PARAM_V);
-        vsh_set_field(vsh_ins, FLD_B_SWZ_X, SWIZZLE_X);
-        vsh_set_field(vsh_ins, FLD_B_SWZ_Y, SWIZZLE_Y);
-        vsh_set_field(vsh_ins, FLD_B_SWZ_Z, SWIZZLE_Z);
-        vsh_set_field(vsh_ins, FLD_B_SWZ_W, SWIZZLE_W);
-        vsh_set_field(vsh_ins, FLD_B_MUX, PARAM_V);
-        vsh_set_field(vsh_ins, FLD_C_SWZ_X, SWIZZLE_X);
-        vsh_set_field(vsh_ins, FLD_C_SWZ_Y, SWIZZLE_Y);
-        vsh_set_field(vsh_ins, FLD_C_SWZ_Z, SWIZZLE_Z);
-        vsh_set_field(vsh_ins, FLD_C_SWZ_W, SWIZZLE_W);
-        vsh_set_field(vsh_ins, FLD_C_MUX, PARAM_V);
-        vsh_set_field(vsh_ins, FLD_OUT_R, 7);
-        vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, 0xff);
-        vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
-        // vsh_set_field(vsh_ins, )
-
-
-        bool ilu = false;
-        bool mac = false;
-
-        switch(ins.Opcode) {
-        case OPCODE_MOV:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_MOV);
-            mac = true;
-            break;
-        case OPCODE_ADD:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_ADD);
-            mac = true;
-            break;
-        case OPCODE_SUB:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_ADD);
-            vsh_set_field(vsh_ins, FLD_C_NEG, 1);
-            assert(false); //TODO: xor negated args
-            mac = true;
-            break;
-        case OPCODE_MAD:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_MAD);
-            mac = true;
-            break;
-        case OPCODE_MUL:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_MUL);
-            mac = true;
-            break;
-        case OPCODE_MAX:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_MAX);
-            mac = true;
-            break;
-        case OPCODE_MIN:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_MIN);
-            mac = true;
-            break;
-        case OPCODE_SGE:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_SGE);
-            mac = true;
-            break;
-        case OPCODE_SLT:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_SLT);
-            mac = true;
-            break;
-        case OPCODE_DP3:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_DP3);
-            mac = true;
-            break;
-        case OPCODE_DP4:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_DP4);
-            mac = true;
-            break;
-        case OPCODE_DPH:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_DPH);
-            mac = true;
-            break;
-        case OPCODE_DST:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_DST);
-            mac = true;
-            break;
+    return 0;
+}
 
-        case OPCODE_RCP:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_RCP);
-            ilu = true;
-            break;
-        case OPCODE_RCC:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_RCC);
-            ilu = true;
-            break;
-        case OPCODE_RSQ:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_RSQ);
-            ilu = true;
-            break;
-        case OPCODE_EXP:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_EXP);
-            ilu = true;
-            break;
-        case OPCODE_LOG:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_LOG);
-            ilu = true;
-            break;
-        case OPCODE_LIT:
-            vsh_set_field(vsh_ins, FLD_ILU, ILU_LIT);
-            ilu = true;
-            break;
-        case OPCODE_ARL:
-            vsh_set_field(vsh_ins, FLD_MAC, MAC_ARL);
-            mac = true;
-            break;
-        default:
-            assert(false);
-        }
+#define VERIFY_VERTICES 16384
 
+static float verify_random(void)
+{
+    return (float)rand() / RAND_MAX * 4.0f - 2.0f;
+}
 
-        if (ins.DstReg.File != PROGRAM_UNDEFINED) {
-            if (ins.DstReg.File == PROGRAM_TEMPORARY) {
-                vsh_set_field(vsh_ins, FLD_OUT_R, ins.DstReg.Index);
-                if (mac) {
-                    vsh_set_field(vsh_ins, FLD_OUT_MAC_MASK, vsh_mask(ins.DstReg.WriteMask));
-                } else if (ilu) {
-                    vsh_set_field(vsh_ins, FLD_OUT_ILU_MASK, vsh_mask(ins.DstReg.WriteMask));
-                }
-            } else if (ins.DstReg.File == PROGRAM_OUTPUT) {
-                vsh_set_field(vsh_ins, FLD_OUT_O_MASK, vsh_mask(ins.DstReg.WriteMask));
-                if (mac) {
-                    vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
-                } else if (ilu) {
-                    vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_ILU);
-                }
-                int out_reg;
-                const char* name = _mesa_nv_vertex_output_register_name(ins.DstReg.Index);
-                for (out_reg = 0; _mesa_nv_vertex_hw_output_register_name(out_reg); out_reg++) {
-                    if (strcmp(name, _mesa_nv_vertex_hw_output_register_name(out_reg)) == 0) {
-                        break;
-                    }
-                }
-                if (!_mesa_nv_vertex_hw_output_register_name(out_reg)) {
-                    assert(false);
-                }
-                vsh_set_field(vsh_ins, FLD_OUT_ORB, OUTPUT_O);
-                vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, out_reg);
-            } else if (ins.DstReg.File == PROGRAM_ENV_PARAM) {
-                vsh_set_field(vsh_ins, FLD_OUT_O_MASK, vsh_mask(ins.DstReg.WriteMask));
-                if (mac) {
-                    vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
-                } else if (ilu) {
-                    vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_ILU);
-                }
-                vsh_set_field(vsh_ins, FLD_OUT_ORB, OUTPUT_C);
-                // TODO: the index needs ajustment?
-                vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, ins.DstReg.Index);
-            } else if (ins.DstReg.File == PROGRAM_ADDRESS) {
-                // No need to do anything, setting the MAC_ARL is all that's necessary
-            } else {
-                assert(false);
+// Runs the unoptimized and the optimized program over the same random
+// vertices and compares their outputs. Returns the number of vertices whose
+// outputs differ, or -1 on error.
+int verify(const char* filename, const char* str)
+{
+    static Vp20Result results[2];
+    static VshProgram programs[2];
+    static float constants[2][VSH_NUM_CONSTANTS][4];
+    static float inputs[VERIFY_VERTICES][VSH_NUM_INPUTS][4];
+    static float outputs[2][VERIFY_VERTICES][VSH_NUM_OUTPUTS][4];
+
+    srand(0);
+    int i, k;
+    for (i=0; i<VSH_NUM_CONSTANTS; i++) {
+        for (k=0; k<4; k++) {
+            constants[0][i][k] = verify_random();
+        }
+    }
+    memcpy(constants[1], constants[0], sizeof(constants[0]));
+    for (i=0; i<VERIFY_VERTICES; i++) {
+        int j;
+        for (j=0; j<VSH_NUM_INPUTS; j++) {
+            for (k=0; k<4; k++) {
+                inputs[i][j][k] = verify_random();
             }
         }
+    }
 
-        VshFieldName mux_field[3] = {FLD_A_MUX, FLD_B_MUX, FLD_C_MUX};
-        VshFieldName swizzle_field[3][4] = {
-            {FLD_A_SWZ_X, FLD_A_SWZ_Y, FLD_A_SWZ_Z, FLD_A_SWZ_W},
-            {FLD_B_SWZ_X, FLD_B_SWZ_Y, FLD_B_SWZ_Z, FLD_B_SWZ_W},
-            {FLD_C_SWZ_X, FLD_C_SWZ_Y, FLD_C_SWZ_Z, FLD_C_SWZ_W},
-        };
-        VshFieldName reg_field[3] = {FLD_A_R, FLD_B_R, FLD_C_R};
-        VshFieldName neg_field[3] = {FLD_A_NEG, FLD_B_NEG, FLD_C_NEG};
-
-        if (ilu) {
-            // ILU instructions only use input C. Swap src reg 0 and 2.
-            assert(ins.SrcReg[1].File == PROGRAM_UNDEFINED);
-            assert(ins.SrcReg[2].File == PROGRAM_UNDEFINED);
-            struct prog_src_register unused_reg = ins.SrcReg[2];
-            ins.SrcReg[2] = ins.SrcReg[0];
-            ins.SrcReg[0] = unused_reg;
+    int p;
+    for (p=0; p<2; p++) {
+        if (!compile(filename, str, p == 1, &results[p])) {
+            return -1;
         }
 
-        if (ins.Opcode == OPCODE_ADD || ins.Opcode == OPCODE_SUB) {
-            // hax. ADD uses A and C. Swap src reg 1 and 2
-            assert(ins.SrcReg[2].File == PROGRAM_UNDEFINED);
-            struct prog_src_register unused_reg = ins.SrcReg[2];
-            ins.SrcReg[2] = ins.SrcReg[1];
-            ins.SrcReg[1] = unused_reg;
+        if (!vsh_interp_load(&programs[p], results[p].tokens, results[p].num_slots)) {
+            fprintf(stderr, "failed to decode program\n");
+            return -1;
         }
 
-        int j;
-        for (j=0; j<3; j++) {
-            struct prog_src_register reg = ins.SrcReg[j];
-            if (reg.File != PROGRAM_UNDEFINED) {
-                // printf(" - in %d\n", j);
-                if (reg.RelAddr) {
-                    vsh_set_field(vsh_ins, FLD_A0X, 1);
-                }
-                if (reg.File == PROGRAM_TEMPORARY) {
-                    vsh_set_field(vsh_ins, mux_field[j], PARAM_R);
-                    vsh_set_field(vsh_ins, reg_field[j], reg.Index);
-                } else if (reg.File == PROGRAM_ENV_PARAM) {
-                    vsh_set_field(vsh_ins, mux_field[j], PARAM_C);
-                    // TODO: the index needs ajustment?
-                    vsh_set_field(vsh_ins, FLD_CONST, reg.Index+96);
-                } else if (reg.File == PROGRAM_INPUT) {
-                    int in_reg;
-                    const char* name = _mesa_nv_vertex_input_register_name(reg.Index);
-                    for (in_reg = 0; _mesa_nv_vertex_hw_input_register_name(in_reg); in_reg++) {
-                        if (strcmp(name, _mesa_nv_vertex_hw_input_register_name(in_reg)) == 0) {
-                            break;
-                        }
-                    }
-                    if (!_mesa_nv_vertex_hw_input_register_name(in_reg)) {
-                        assert(false);
-                    }
-                    vsh_set_field(vsh_ins, mux_field[j], PARAM_V);
-                    vsh_set_field(vsh_ins, FLD_V, in_reg);
-                } else {
-                    assert(false);
-                }
+        clock_t start = clock();
+        vsh_interp_run(&programs[p], constants[p], (const float (*)[VSH_NUM_INPUTS][4])inputs,
+                       outputs[p], VERIFY_VERTICES);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
 
-                if (reg.Negate == NEGATE_XYZW) {
-                    vsh_set_field(vsh_ins, neg_field[j], 1);
-                }
+        VshStats stats;
+        vsh_interp_stats(&programs[p], &stats);
+        printf("// %s: %u slots (%u MAC, %u ILU, %u paired), %.1f ns per vertex on the host\n",
+               p == 0 ? "unoptimized" : "optimized", stats.num_slots, stats.num_mac,
+               stats.num_ilu, stats.num_paired, seconds * 1e9 / VERIFY_VERTICES);
+    }
 
-                int k;
-                for (k=0; k<4; k++) {
-                    vsh_set_field(vsh_ins, swizzle_field[j][k], GET_SWZ(reg.Swizzle, k));
+    int mismatches = 0;
+    for (i=0; i<VERIFY_VERTICES; i++) {
+        if (memcmp(outputs[0][i], outputs[1][i], sizeof(outputs[0][i])) == 0) {
+            continue;
+        }
+        if (mismatches++ == 0) {
+            int o;
+            for (o=0; o<VSH_NUM_OUTPUTS; o++) {
+                float *a = outputs[0][i][o];
+                float *b = outputs[1][i][o];
+                if (memcmp(a, b, sizeof(outputs[0][i][o])) != 0) {
+                    fprintf(stderr, "vertex %d, o[%s]: %f %f %f %f != %f %f %f %f\n",
+                            i, _mesa_nv_vertex_hw_output_register_name(o),
+                            a[0], a[1], a[2], a[3], b[0], b[1], b[2], b[3]);
                 }
             }
         }
-
-        vsh_ins += 4;
-    }
-
-    if (num_instructions) {
-        vsh_set_field(vsh_ins-4, FLD_FINAL, 1);
     }
+    printf("// %d of %d vertices differ\n", mismatches, VERIFY_VERTICES);
 
-    for (uint32_t* pvsh = vsh_buf; pvsh < vsh_ins; pvsh += 4) {
-        printf("0x%08x, 0x%08x, 0x%08x, 0x%08x,\n", pvsh[0], pvsh[1], pvsh[2], pvsh[3]);
-    }
+    return mismatches;
 }
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s vpfile\n", argv[0]);
-        exit(1);
-    }
-
-    FILE* fh = fopen(argv[1], "r");
+// Reads the whole file into a zero terminated buffer. Returns NULL on error.
+static char* read_file(const char* filename)
+{
+    FILE* fh = fopen(filename, "rb");
     if (!fh) {
-        fprintf(stderr, "unable to open %s\n", argv[1]);
-        exit(1);
+        fprintf(stderr, "unable to open %s\n", filename);
+        return NULL;
     }
 
     fseek(fh, 0L, SEEK_END);
@@ -572,16 +276,202 @@ int main(int argc, char** argv) {
     char* buffer = (char*)malloc(size+1);
     if (buffer == NULL) {
         fprintf(stderr, "failed to allocate buffer\n");
-        exit(1);
+        fclose(fh);
+        return NULL;
     }
     memset(buffer, 0, size+1);
 
     fread(buffer, size, 1, fh);
+    fclose(fh);
+
+    return buffer;
+}
 
-    translate(buffer);
+typedef struct BatchJob {
+    const char* input;
+    const char* output;
+} BatchJob;
+
+typedef struct Batch {
+    const BatchJob* jobs;
+    unsigned int num_jobs;
+    unsigned int next_job;
+    unsigned int num_failed;
+    bool optimize;
+    bool binary;
+} Batch;
+
+static int compile_file(const char* input, const char* output, bool optimize, bool binary)
+{
+    char* buffer = read_file(input);
+    if (buffer == NULL) {
+        return 1;
+    }
+
+    FILE* fh = fopen(output, binary ? "wb" : "w");
+    if (!fh) {
+        fprintf(stderr, "unable to create %s\n", output);
+        free(buffer);
+        return 1;
+    }
+
+    int ret = translate(fh, input, buffer, optimize, binary);
+    if (fclose(fh) != 0) {
+        ret = 1;
+    }
+    if (ret != 0) {
+        remove(output);
+    }
 
     free(buffer);
-    fclose(fh);
+    return ret;
+}
 
-    return 0;
-}
\ No newline at end of file
+static void* batch_worker(void* arg)
+{
+    Batch* batch = (Batch*)arg;
+
+    while (true) {
+        unsigned int i = __sync_fetch_and_add(&batch->next_job, 1);
+        if (i >= batch->num_jobs) {
+            break;
+        }
+
+        const BatchJob* job = &batch->jobs[i];
+        if (compile_file(job->input, job->output, batch->optimize, batch->binary)) {
+            __sync_fetch_and_add(&batch->num_failed, 1);
+        }
+    }
+
+    return NULL;
+}
+
+// Compiles the files of the list, which holds an input and an output path
+// per line, on num_threads threads. Returns the number of failed files.
+static int batch_compile(const char* listfile, unsigned int num_threads, bool optimize, bool binary)
+{
+    char* list = read_file(listfile);
+    if (list == NULL) {
+        return -1;
+    }
+
+    unsigned int max_jobs = 0;
+    const char* c;
+    for (c = list; *c; c++) {
+        if (*c == '\n') {
+            max_jobs++;
+        }
+    }
+    max_jobs++;
+
+    BatchJob* jobs = (BatchJob*)malloc(max_jobs * sizeof(BatchJob));
+    unsigned int num_jobs = 0;
+    unsigned int line_number = 0;
+    char* save_line;
+    char* line;
+    for (line = strtok_r(list, "\n", &save_line); line; line = strtok_r(NULL, "\n", &save_line)) {
+        char* save_word;
+        char* input = strtok_r(line, " \t\r", &save_word);
+        char* output = strtok_r(NULL, " \t\r", &save_word);
+        line_number++;
+        if (input == NULL) {
+            continue;
+        }
+        if (output == NULL || strtok_r(NULL, " \t\r", &save_word) != NULL) {
+            fprintf(stderr, "%s: line %u: expected an input and an output file\n", listfile, line_number);
+            free(jobs);
+            free(list);
+            return -1;
+        }
+        jobs[num_jobs].input = input;
+        jobs[num_jobs].output = output;
+        num_jobs++;
+    }
+
+    Batch batch;
+    batch.jobs = jobs;
+    batch.num_jobs = num_jobs;
+    batch.next_job = 0;
+    batch.num_failed = 0;
+    batch.optimize = optimize;
+    batch.binary = binary;
+
+    // The calling thread compiles as well
+    unsigned int num_workers = num_threads > 1 ? num_threads - 1 : 0;
+    if (num_workers > num_jobs) {
+        num_workers = num_jobs;
+    }
+    pthread_t* threads = (pthread_t*)malloc(num_workers * sizeof(pthread_t));
+    unsigned int i;
+    for (i=0; i<num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, batch_worker, &batch) != 0) {
+            break;
+        }
+    }
+    // This also covers failed thread creation
+    batch_worker(&batch);
+    while (i > 0) {
+        pthread_join(threads[--i], NULL);
+    }
+
+    free(threads);
+    free(jobs);
+    free(list);
+
+    return batch.num_failed;
+}
+
+int main(int argc, char** argv) {
+    const char* program = argv[0];
+    bool optimize = true;
+    bool verify_only = false;
+    bool binary = false;
+    bool batch = false;
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-O0") == 0) {
+            optimize = false;
+        } else if (strcmp(argv[1], "-verify") == 0) {
+            verify_only = true;
+        } else if (strcmp(argv[1], "-bin") == 0) {
+            binary = true;
+        } else if (strcmp(argv[1], "-batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[1], "-j") == 0 && argc > 3) {
+            num_threads = atol(argv[2]);
+            argv++;
+            argc--;
+        } else {
+            break;
+        }
+        argv++;
+        argc--;
+    }
+
+    if (argc != 2 || (batch && verify_only)) {
+        fprintf(stderr, "usage: %s [-O0] [-bin|-verify] vpfile\n", program);
+        fprintf(stderr, "       %s [-O0] [-bin] [-j threads] -batch listfile\n", program);
+        exit(1);
+    }
+
+    if (batch) {
+        int failed = batch_compile(argv[1], num_threads > 1 ? num_threads : 1, optimize, binary);
+        return failed == 0 ? 0 : 1;
+    }
+
+    char* buffer = read_file(argv[1]);
+    if (buffer == NULL) {
+        exit(1);
+    }
+
+    int ret = 0;
+    if (verify_only) {
+        ret = verify(argv[1], buffer) == 0 ? 0 : 1;
+    } else {
+        ret = translate(stdout, argv[1], buffer, optimize, binary);
+    }
+
+    free(buffer);
+
+    return ret;
+}
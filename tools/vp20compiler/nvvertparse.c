@@ -74,6 +74,7 @@ struct parse_state {
    bool anyProgRegsWritten;
    bool indirectRegisterFiles;
    unsigned int numInst;                 /* number of instructions parsed */
+   struct nv_parse_log *log;             /* receives errors and warnings */
 };
 
 /**
@@ -123,24 +124,40 @@ record_error(struct parse_state *parseState, const char *msg, const char* file,
 {
    int line, column;
    const unsigned char *lineStr;
+   struct nv_parse_message *message = NULL;
+   struct nv_parse_log *log = parseState->log;
+
+   if (onlyWarn) {
+      if (log->numWarnings < NV_PARSE_MAX_WARNINGS) {
+         message = &log->warnings[log->numWarnings++];
+      }
+   }
+   /* Check that no error was already recorded.  Only record the first one. */
+   else if (log->error.message[0] == 0) {
+      message = &log->error;
+   }
+   if (message == NULL) {
+      return;
+   }
+
    lineStr = _mesa_find_line_column(parseState->start,
                                     parseState->pos, &line, &column);
-   // _mesa_debug(parseState->ctx,
-   fprintf(stderr,
-               "%s: line %d, column %d: %s (%s)\n",
-               onlyWarn ? "warning" : "error",
-               line, column, (char *) lineStr, msg);
+   message->line = line;
+   message->column = column;
+   snprintf(message->message, sizeof(message->message),
+            "%s (%s)", (char *) lineStr, msg);
    free((void *) lineStr);
+}
 
-   /* Check that no error was already recorded.  Only record the first one. */
-   // if (parseState->ctx->Program.ErrorString[0] == 0) {
-   //    _mesa_set_program_error(parseState->ctx,
-   //                            parseState->pos - parseState->start,
-   //                            msg);
-   // }
-   if (!onlyWarn) {
-      exit(1);
-   }
+/*
+ * Records an error which isn't tied to a position in the program.
+ */
+static void
+record_program_error(struct nv_parse_log *log, const char *msg)
+{
+   log->error.line = 0;
+   log->error.column = 0;
+   snprintf(log->error.message, sizeof(log->error.message), "%s", msg);
 }
 
 #define WARNING1(msg)                                                        \
@@ -1355,15 +1372,19 @@ Parse_Program(struct parse_state *parseState,
 
 int parse_nv_vertex_program(const char *str,
                             struct prog_instruction **out_instructions,
-                            unsigned int *out_num_instructions)
+                            unsigned int *out_num_instructions,
+                            struct nv_parse_log *log)
 {
    struct parse_state parseState;
    struct prog_instruction instBuffer[MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS];
    struct prog_instruction *newInst;
+   int ret = 1;
    // GLenum target;
    
    unsigned char* programString = (unsigned char*)strdup(str);
 
+   memset(log, 0, sizeof(*log));
+
    /* Get ready to parse */
    // parseState.ctx = ctx;
    parseState.start = programString;
@@ -1374,6 +1395,7 @@ int parse_nv_vertex_program(const char *str,
    parseState.outputsWritten = 0;
    parseState.anyProgRegsWritten = FALSE;
    parseState.indirectRegisterFiles = 0x0;
+   parseState.log = log;
 
    /* Reset error state */
    // _mesa_set_program_error(ctx, -1, NULL);
@@ -1397,7 +1419,8 @@ int parse_nv_vertex_program(const char *str,
    }
    else {
       /* invalid header */
-      fprintf(stderr, "bad header\n");
+      record_program_error(log, "bad header");
+      free(programString);
       return 1;
    }
 
@@ -1411,7 +1434,8 @@ int parse_nv_vertex_program(const char *str,
          if (!parseState.anyProgRegsWritten) {
             // _mesa_error(ctx, GL_INVALID_OPERATION,
             //             "glLoadProgramNV(c[#] not written)");
-            fprintf(stderr, "c[#] not written\n");
+            record_program_error(log, "c[#] not written");
+            free(programString);
             return 1;
          }
       }
@@ -1419,7 +1443,8 @@ int parse_nv_vertex_program(const char *str,
          if (!parseState.isPositionInvariant &&
              !(parseState.outputsWritten & (1 << VERT_RESULT_HPOS))) {
             /* bit 1 = HPOS register */
-            fprintf(stderr, "HPOS not written\n");
+            record_program_error(log, "HPOS not written");
+            free(programString);
             return 1;
          }
       }
@@ -1433,12 +1458,17 @@ int parse_nv_vertex_program(const char *str,
       *out_instructions = newInst;
       *out_num_instructions = parseState.numInst;
 
-      return 0;
+      ret = 0;
    }
    else {
       /* Error! */
-      return 1;
+      if (log->error.message[0] == 0) {
+         record_program_error(log, "syntax error");
+      }
    }
+
+   free(programString);
+   return ret;
 }
 
 /**
@@ -31,9 +31,25 @@
 
 #include "prog_instruction.h"
 
+#define NV_PARSE_MAX_WARNINGS 16
+
+struct nv_parse_message {
+   int line;            /* 0 if the message isn't tied to a position */
+   int column;
+   char message[256];
+};
+
+struct nv_parse_log {
+   struct nv_parse_message error;       /* the first error, if any */
+   unsigned int numWarnings;            /* further warnings are dropped */
+   struct nv_parse_message warnings[NV_PARSE_MAX_WARNINGS];
+};
+
+/* Reentrant, all state lives in the call. Returns nonzero on error. */
 int parse_nv_vertex_program(const char *str,
                             struct prog_instruction **out_instructions,
-                            unsigned int *out_num_instructions);
+                            unsigned int *out_num_instructions,
+                            struct nv_parse_log *log);
 
 
 extern const char *
@@ -0,0 +1,393 @@
+#include <assert.h>
+#include <string.h>
+
+#include "config.h"
+#include "mtypes.h"
+#include "optimize.h"
+
+#define NUM_TEMPS MAX_NV_VERTEX_PROGRAM_TEMPS
+// R12 aliases the position output, so it keeps its index
+#define NUM_ALLOCATABLE_TEMPS 12
+// The ILU of a paired slot can only write to R1
+#define PAIRED_ILU_TEMP 1
+
+bool vsh_is_ilu_opcode(enum prog_opcode opcode)
+{
+    switch (opcode) {
+    case OPCODE_RCP:
+    case OPCODE_RCC:
+    case OPCODE_RSQ:
+    case OPCODE_EXP:
+    case OPCODE_LOG:
+    case OPCODE_LIT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Channels of the swizzled source operand that the instruction consumes
+static unsigned int vsh_src_channels(const struct prog_instruction *ins, int src)
+{
+    switch (ins->Opcode) {
+    case OPCODE_DP3:
+        return WRITEMASK_XYZ;
+    case OPCODE_DP4:
+        return WRITEMASK_XYZW;
+    case OPCODE_DPH:
+        return src == 0 ? WRITEMASK_XYZ : WRITEMASK_XYZW;
+    case OPCODE_DST:
+        return src == 0 ? WRITEMASK_YZ : WRITEMASK_YW;
+    case OPCODE_LIT:
+        return WRITEMASK_XYW;
+    case OPCODE_RCP:
+    case OPCODE_RCC:
+    case OPCODE_RSQ:
+    case OPCODE_EXP:
+    case OPCODE_LOG:
+    case OPCODE_ARL:
+        return WRITEMASK_X;
+    default:
+        // Component-wise operations
+        return ins->DstReg.WriteMask;
+    }
+}
+
+// Components of the source register that the instruction reads
+static unsigned int vsh_src_read_mask(const struct prog_instruction *ins, int src)
+{
+    unsigned int channels = vsh_src_channels(ins, src);
+    unsigned int mask = 0;
+
+    int k;
+    for (k=0; k<4; k++) {
+        if (channels & (1 << k)) {
+            unsigned int swizzle = GET_SWZ(ins->SrcReg[src].Swizzle, k);
+            if (swizzle <= SWIZZLE_W) {
+                mask |= 1 << swizzle;
+            }
+        }
+    }
+
+    return mask;
+}
+
+static bool vsh_reads_temp(const struct prog_instruction *ins, unsigned int index, unsigned int mask)
+{
+    int j;
+    for (j=0; j<3; j++) {
+        const struct prog_src_register *reg = &ins->SrcReg[j];
+        if (reg->File == PROGRAM_TEMPORARY && reg->Index == index &&
+            (vsh_src_read_mask(ins, j) & mask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool vsh_reads_address(const struct prog_instruction *ins)
+{
+    int j;
+    for (j=0; j<3; j++) {
+        if (ins->SrcReg[j].File != PROGRAM_UNDEFINED && ins->SrcReg[j].RelAddr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether instruction b must stay behind instruction a
+static bool vsh_depends(const struct prog_instruction *a, const struct prog_instruction *b)
+{
+    const struct prog_dst_register *da = &a->DstReg;
+    const struct prog_dst_register *db = &b->DstReg;
+
+    // Read after write
+    if (da->File == PROGRAM_TEMPORARY && vsh_reads_temp(b, da->Index, da->WriteMask)) {
+        return true;
+    }
+    if (da->File == PROGRAM_ADDRESS && vsh_reads_address(b)) {
+        return true;
+    }
+
+    // Write after read
+    if (db->File == PROGRAM_TEMPORARY && vsh_reads_temp(a, db->Index, db->WriteMask)) {
+        return true;
+    }
+    if (db->File == PROGRAM_ADDRESS && vsh_reads_address(a)) {
+        return true;
+    }
+
+    // Write after write
+    if (da->File == db->File && da->Index == db->Index &&
+        (da->File != PROGRAM_TEMPORARY || (da->WriteMask & db->WriteMask))) {
+        return true;
+    }
+
+    return false;
+}
+
+// Removes instructions which only write temporary components that are never
+// read afterwards
+static unsigned int vsh_remove_dead_writes(struct prog_instruction *instructions,
+                                           unsigned int num_instructions)
+{
+    unsigned int live[NUM_TEMPS];
+    bool keep[MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS];
+    memset(live, 0, sizeof(live));
+
+    int i;
+    for (i=num_instructions-1; i>=0; i--) {
+        const struct prog_instruction *ins = &instructions[i];
+
+        keep[i] = true;
+        if (ins->DstReg.File == PROGRAM_TEMPORARY) {
+            if (!(live[ins->DstReg.Index] & ins->DstReg.WriteMask)) {
+                keep[i] = false;
+                continue;
+            }
+            live[ins->DstReg.Index] &= ~ins->DstReg.WriteMask;
+        }
+
+        int j;
+        for (j=0; j<3; j++) {
+            if (ins->SrcReg[j].File == PROGRAM_TEMPORARY) {
+                live[ins->SrcReg[j].Index] |= vsh_src_read_mask(ins, j);
+            }
+        }
+    }
+
+    unsigned int num_kept = 0;
+    for (i=0; i<num_instructions; i++) {
+        if (keep[i]) {
+            instructions[num_kept++] = instructions[i];
+        }
+    }
+    return num_kept;
+}
+
+// Assigns temporaries to registers by their live ranges, so registers are
+// reused once their value is no longer needed. Values produced by the ILU
+// prefer R1, which allows pairing them with a MAC instruction.
+//
+// Components that are read before they were written hold 0. Temporaries with
+// such reads live from the start, and only get registers that no other range
+// has used, so they still read 0.
+static void vsh_allocate_temps(struct prog_instruction *instructions,
+                               unsigned int num_instructions)
+{
+    int first[NUM_TEMPS];
+    int last[NUM_TEMPS];
+    bool ilu_value[NUM_TEMPS];
+    unsigned int written[NUM_TEMPS];
+    bool reads_unwritten[NUM_TEMPS];
+    int map[NUM_TEMPS];
+    int busy_until[NUM_ALLOCATABLE_TEMPS];
+
+    int t;
+    for (t=0; t<NUM_TEMPS; t++) {
+        first[t] = -1;
+        last[t] = -1;
+        ilu_value[t] = false;
+        written[t] = 0;
+        reads_unwritten[t] = false;
+        map[t] = t;
+    }
+
+    int i;
+    for (i=0; i<num_instructions; i++) {
+        const struct prog_instruction *ins = &instructions[i];
+
+        int j;
+        for (j=0; j<3; j++) {
+            if (ins->SrcReg[j].File == PROGRAM_TEMPORARY) {
+                unsigned int index = ins->SrcReg[j].Index;
+                if (vsh_src_read_mask(ins, j) & ~written[index]) {
+                    first[index] = 0;
+                    reads_unwritten[index] = true;
+                }
+                last[index] = i;
+            }
+        }
+
+        if (ins->DstReg.File == PROGRAM_TEMPORARY) {
+            unsigned int index = ins->DstReg.Index;
+            if (first[index] < 0) {
+                first[index] = i;
+                ilu_value[index] = vsh_is_ilu_opcode(ins->Opcode);
+            }
+            written[index] |= ins->DstReg.WriteMask;
+            last[index] = i;
+        }
+    }
+
+    for (t=0; t<NUM_ALLOCATABLE_TEMPS; t++) {
+        busy_until[t] = -1;
+    }
+
+    // Live ranges are allocated in the order they start. A register whose
+    // last read is in the instruction that starts a new range can be reused,
+    // as instructions read their operands before writing the result.
+    for (i=0; i<num_instructions; i++) {
+        for (t=0; t<NUM_ALLOCATABLE_TEMPS; t++) {
+            if (first[t] != i) {
+                continue;
+            }
+
+            // Registers that were never used still hold 0
+            int free_from = reads_unwritten[t] ? -1 : i;
+
+            int r = -1;
+            if (ilu_value[t] && busy_until[PAIRED_ILU_TEMP] <= free_from) {
+                r = PAIRED_ILU_TEMP;
+            } else {
+                int p;
+                for (p=0; p<NUM_ALLOCATABLE_TEMPS; p++) {
+                    if (p != PAIRED_ILU_TEMP && busy_until[p] <= free_from) {
+                        r = p;
+                        break;
+                    }
+                }
+                if (r < 0 && busy_until[PAIRED_ILU_TEMP] <= free_from) {
+                    r = PAIRED_ILU_TEMP;
+                }
+            }
+
+            // The original assignment proves that the ranges fit, ranges
+            // that read unwritten components all start at 0
+            assert(r >= 0);
+            map[t] = r;
+            busy_until[r] = last[t];
+        }
+    }
+
+    for (i=0; i<num_instructions; i++) {
+        struct prog_instruction *ins = &instructions[i];
+
+        int j;
+        for (j=0; j<3; j++) {
+            if (ins->SrcReg[j].File == PROGRAM_TEMPORARY) {
+                ins->SrcReg[j].Index = map[ins->SrcReg[j].Index];
+            }
+        }
+        if (ins->DstReg.File == PROGRAM_TEMPORARY) {
+            ins->DstReg.Index = map[ins->DstReg.Index];
+        }
+    }
+}
+
+static bool vsh_same_src(const struct prog_src_register *a, const struct prog_src_register *b)
+{
+    return a->File == b->File && a->Index == b->Index && a->Swizzle == b->Swizzle &&
+           a->RelAddr == b->RelAddr && a->Negate == b->Negate;
+}
+
+// Whether the ILU instruction can be issued in the same slot as the MAC
+// instruction, which precedes it in program order
+static bool vsh_can_pair(const struct prog_instruction *mac, const struct prog_instruction *ilu)
+{
+    if (mac->Opcode == OPCODE_ARL) {
+        return false;
+    }
+
+    // Both units share the temporary index, the output register and the
+    // operands of the slot
+    if (ilu->DstReg.File == PROGRAM_TEMPORARY) {
+        if (ilu->DstReg.Index != PAIRED_ILU_TEMP) {
+            return false;
+        }
+        if (mac->DstReg.File == PROGRAM_TEMPORARY && mac->DstReg.Index == PAIRED_ILU_TEMP) {
+            return false;
+        }
+    } else if (mac->DstReg.File != PROGRAM_TEMPORARY) {
+        return false;
+    }
+
+    // The ILU reads input C, which MAD uses for its third operand and ADD for
+    // its second one
+    const struct prog_src_register *ilu_src = &ilu->SrcReg[0];
+    int mac_c = -1;
+    if (mac->Opcode == OPCODE_MAD) {
+        mac_c = 2;
+    } else if (mac->Opcode == OPCODE_ADD) {
+        mac_c = 1;
+    }
+    if (mac_c >= 0 && !vsh_same_src(&mac->SrcReg[mac_c], ilu_src)) {
+        return false;
+    }
+
+    // There is only a single constant and a single input index per slot
+    int j;
+    for (j=0; j<3; j++) {
+        const struct prog_src_register *reg = &mac->SrcReg[j];
+        if (reg->File != ilu_src->File) {
+            continue;
+        }
+        if (reg->File == PROGRAM_ENV_PARAM &&
+            (reg->Index != ilu_src->Index || reg->RelAddr != ilu_src->RelAddr)) {
+            return false;
+        }
+        if (reg->File == PROGRAM_INPUT && reg->Index != ilu_src->Index) {
+            return false;
+        }
+    }
+
+    return !vsh_depends(mac, ilu);
+}
+
+static bool vsh_slot_depends(const struct prog_instruction *instructions,
+                             const VshSlot *slot, const struct prog_instruction *ins)
+{
+    return (slot->mac >= 0 && vsh_depends(&instructions[slot->mac], ins)) ||
+           (slot->ilu >= 0 && vsh_depends(&instructions[slot->ilu], ins));
+}
+
+unsigned int vsh_optimize(struct prog_instruction *instructions,
+                          unsigned int num_instructions,
+                          VshSlot *slots, bool optimize)
+{
+    unsigned int i;
+    for (i=0; i<num_instructions; i++) {
+        if (instructions[i].Opcode == OPCODE_END) {
+            break;
+        }
+    }
+    num_instructions = i;
+
+    if (optimize) {
+        num_instructions = vsh_remove_dead_writes(instructions, num_instructions);
+        vsh_allocate_temps(instructions, num_instructions);
+    }
+
+    unsigned int num_slots = 0;
+    for (i=0; i<num_instructions; i++) {
+        const struct prog_instruction *ins = &instructions[i];
+        bool ilu = vsh_is_ilu_opcode(ins->Opcode);
+
+        // Move ILU instructions up into the closest MAC slot they can join,
+        // as long as they don't depend on any slot in between
+        if (optimize && ilu) {
+            int s;
+            for (s=num_slots-1; s>=0; s--) {
+                if (slots[s].mac >= 0 && slots[s].ilu < 0 &&
+                    vsh_can_pair(&instructions[slots[s].mac], ins)) {
+                    slots[s].ilu = i;
+                    break;
+                }
+                if (vsh_slot_depends(instructions, &slots[s], ins)) {
+                    s = -1;
+                    break;
+                }
+            }
+            if (s >= 0) {
+                continue;
+            }
+        }
+
+        slots[num_slots].mac = ilu ? -1 : (int)i;
+        slots[num_slots].ilu = ilu ? (int)i : -1;
+        num_slots++;
+    }
+
+    return num_slots;
+}
@@ -0,0 +1,25 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <stdbool.h>
+
+#include "prog_instruction.h"
+
+// One NV2A instruction slot. The MAC and the ILU execute in parallel, so a
+// slot can hold one instruction for each of them.
+typedef struct VshSlot {
+    int mac; // index of the MAC instruction, or -1
+    int ilu; // index of the ILU instruction, or -1
+} VshSlot;
+
+bool vsh_is_ilu_opcode(enum prog_opcode opcode);
+
+// Turns the parsed instructions into slots, stopping at OPCODE_END. With
+// optimize set, dead writes are removed, temporaries are reallocated and ILU
+// instructions are paired with MAC instructions. Instructions may be
+// modified in place. Returns the number of slots.
+unsigned int vsh_optimize(struct prog_instruction *instructions,
+                          unsigned int num_instructions,
+                          VshSlot *slots, bool optimize);
+
+#endif
@@ -0,0 +1,343 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "mtypes.h"
+#include "nvvertparse.h"
+#include "optimize.h"
+#include "prog_instruction.h"
+#include "vp20.h"
+#include "vsh.h"
+
+_Static_assert(VP20_MAX_SLOTS == MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS, "slot count mismatch");
+_Static_assert(VP20_TOKEN_SIZE == VSH_TOKEN_SIZE, "token size mismatch");
+_Static_assert(VP20_MAX_WARNINGS == NV_PARSE_MAX_WARNINGS, "warning count mismatch");
+
+static uint8_t vsh_mask(unsigned int write_mask) {
+    switch (write_mask) {
+    case WRITEMASK_X: return MASK_X;
+    case WRITEMASK_Y: return MASK_Y;
+    case WRITEMASK_XY: return MASK_XY;
+    case WRITEMASK_Z: return MASK_Z;
+    case WRITEMASK_XZ: return MASK_XZ;
+    case WRITEMASK_YZ: return MASK_YZ;
+    case WRITEMASK_XYZ: return MASK_XYZ;
+    case WRITEMASK_W: return MASK_W;
+    case WRITEMASK_XW: return MASK_XW;
+    case WRITEMASK_YW: return MASK_YW;
+    case WRITEMASK_XYW: return MASK_XYW;
+    case WRITEMASK_ZW: return MASK_ZW;
+    case WRITEMASK_XZW: return MASK_XZW;
+    case WRITEMASK_YZW: return MASK_YZW;
+    case WRITEMASK_XYZW: return MASK_XYZW;
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+// Encodes one instruction into the slot. paired is set for ILU instructions
+// which share the slot with a MAC instruction.
+static void vsh_encode(uint32_t *vsh_ins, struct prog_instruction ins, bool paired)
+{
+    bool ilu = false;
+    bool mac = false;
+
+    switch(ins.Opcode) {
+    case OPCODE_MOV:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_MOV);
+        mac = true;
+        break;
+    case OPCODE_ADD:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_ADD);
+        mac = true;
+        break;
+    case OPCODE_SUB:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_ADD);
+        vsh_set_field(vsh_ins, FLD_C_NEG, 1);
+        assert(false); //TODO: xor negated args
+        mac = true;
+        break;
+    case OPCODE_MAD:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_MAD);
+        mac = true;
+        break;
+    case OPCODE_MUL:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_MUL);
+        mac = true;
+        break;
+    case OPCODE_MAX:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_MAX);
+        mac = true;
+        break;
+    case OPCODE_MIN:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_MIN);
+        mac = true;
+        break;
+    case OPCODE_SGE:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_SGE);
+        mac = true;
+        break;
+    case OPCODE_SLT:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_SLT);
+        mac = true;
+        break;
+    case OPCODE_DP3:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_DP3);
+        mac = true;
+        break;
+    case OPCODE_DP4:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_DP4);
+        mac = true;
+        break;
+    case OPCODE_DPH:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_DPH);
+        mac = true;
+        break;
+    case OPCODE_DST:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_DST);
+        mac = true;
+        break;
+
+    case OPCODE_RCP:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_RCP);
+        ilu = true;
+        break;
+    case OPCODE_RCC:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_RCC);
+        ilu = true;
+        break;
+    case OPCODE_RSQ:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_RSQ);
+        ilu = true;
+        break;
+    case OPCODE_EXP:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_EXP);
+        ilu = true;
+        break;
+    case OPCODE_LOG:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_LOG);
+        ilu = true;
+        break;
+    case OPCODE_LIT:
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_LIT);
+        ilu = true;
+        break;
+    case OPCODE_ARL:
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_ARL);
+        mac = true;
+        break;
+    default:
+        assert(false);
+    }
+
+
+    if (ins.DstReg.File != PROGRAM_UNDEFINED) {
+        if (ins.DstReg.File == PROGRAM_TEMPORARY) {
+            // The ILU of a paired slot always writes to R1, the register
+            // index belongs to the MAC
+            if (!paired) {
+                vsh_set_field(vsh_ins, FLD_OUT_R, ins.DstReg.Index);
+            }
+            if (mac) {
+                vsh_set_field(vsh_ins, FLD_OUT_MAC_MASK, vsh_mask(ins.DstReg.WriteMask));
+            } else if (ilu) {
+                vsh_set_field(vsh_ins, FLD_OUT_ILU_MASK, vsh_mask(ins.DstReg.WriteMask));
+            }
+        } else if (ins.DstReg.File == PROGRAM_OUTPUT) {
+            vsh_set_field(vsh_ins, FLD_OUT_O_MASK, vsh_mask(ins.DstReg.WriteMask));
+            if (mac) {
+                vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
+            } else if (ilu) {
+                vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_ILU);
+            }
+            int out_reg;
+            const char* name = _mesa_nv_vertex_output_register_name(ins.DstReg.Index);
+            for (out_reg = 0; _mesa_nv_vertex_hw_output_register_name(out_reg); out_reg++) {
+                if (strcmp(name, _mesa_nv_vertex_hw_output_register_name(out_reg)) == 0) {
+                    break;
+                }
+            }
+            if (!_mesa_nv_vertex_hw_output_register_name(out_reg)) {
+                assert(false);
+            }
+            vsh_set_field(vsh_ins, FLD_OUT_ORB, OUTPUT_O);
+            vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, out_reg);
+        } else if (ins.DstReg.File == PROGRAM_ENV_PARAM) {
+            vsh_set_field(vsh_ins, FLD_OUT_O_MASK, vsh_mask(ins.DstReg.WriteMask));
+            if (mac) {
+                vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
+            } else if (ilu) {
+                vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_ILU);
+            }
+            vsh_set_field(vsh_ins, FLD_OUT_ORB, OUTPUT_C);
+            // TODO: the index needs ajustment?
+            vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, ins.DstReg.Index);
+        } else if (ins.DstReg.File == PROGRAM_ADDRESS) {
+            // No need to do anything, setting the MAC_ARL is all that's necessary
+        } else {
+            assert(false);
+        }
+    }
+
+    VshFieldName mux_field[3] = {FLD_A_MUX, FLD_B_MUX, FLD_C_MUX};
+    VshFieldName swizzle_field[3][4] = {
+        {FLD_A_SWZ_X, FLD_A_SWZ_Y, FLD_A_SWZ_Z, FLD_A_SWZ_W},
+        {FLD_B_SWZ_X, FLD_B_SWZ_Y, FLD_B_SWZ_Z, FLD_B_SWZ_W},
+        {FLD_C_SWZ_X, FLD_C_SWZ_Y, FLD_C_SWZ_Z, FLD_C_SWZ_W},
+    };
+    VshFieldName reg_field[3] = {FLD_A_R, FLD_B_R, FLD_C_R};
+    VshFieldName neg_field[3] = {FLD_A_NEG, FLD_B_NEG, FLD_C_NEG};
+
+    if (ilu) {
+        // ILU instructions only use input C. Swap src reg 0 and 2.
+        assert(ins.SrcReg[1].File == PROGRAM_UNDEFINED);
+        assert(ins.SrcReg[2].File == PROGRAM_UNDEFINED);
+        struct prog_src_register unused_reg = ins.SrcReg[2];
+        ins.SrcReg[2] = ins.SrcReg[0];
+        ins.SrcReg[0] = unused_reg;
+    }
+
+    if (ins.Opcode == OPCODE_ADD || ins.Opcode == OPCODE_SUB) {
+        // hax. ADD uses A and C. Swap src reg 1 and 2
+        assert(ins.SrcReg[2].File == PROGRAM_UNDEFINED);
+        struct prog_src_register unused_reg = ins.SrcReg[2];
+        ins.SrcReg[2] = ins.SrcReg[1];
+        ins.SrcReg[1] = unused_reg;
+    }
+
+    int j;
+    for (j=0; j<3; j++) {
+        struct prog_src_register reg = ins.SrcReg[j];
+        if (reg.File != PROGRAM_UNDEFINED) {
+            // printf(" - in %d\n", j);
+            if (reg.RelAddr) {
+                vsh_set_field(vsh_ins, FLD_A0X, 1);
+            }
+            if (reg.File == PROGRAM_TEMPORARY) {
+                vsh_set_field(vsh_ins, mux_field[j], PARAM_R);
+                vsh_set_field(vsh_ins, reg_field[j], reg.Index);
+            } else if (reg.File == PROGRAM_ENV_PARAM) {
+                vsh_set_field(vsh_ins, mux_field[j], PARAM_C);
+                // TODO: the index needs ajustment?
+                vsh_set_field(vsh_ins, FLD_CONST, reg.Index+96);
+            } else if (reg.File == PROGRAM_INPUT) {
+                int in_reg;
+                const char* name = _mesa_nv_vertex_input_register_name(reg.Index);
+                for (in_reg = 0; _mesa_nv_vertex_hw_input_register_name(in_reg); in_reg++) {
+                    if (strcmp(name, _mesa_nv_vertex_hw_input_register_name(in_reg)) == 0) {
+                        break;
+                    }
+                }
+                if (!_mesa_nv_vertex_hw_input_register_name(in_reg)) {
+                    assert(false);
+                }
+                vsh_set_field(vsh_ins, mux_field[j], PARAM_V);
+                vsh_set_field(vsh_ins, FLD_V, in_reg);
+            } else {
+                assert(false);
+            }
+
+            if (reg.Negate == NEGATE_XYZW) {
+                vsh_set_field(vsh_ins, neg_field[j], 1);
+            }
+
+            int k;
+            for (k=0; k<4; k++) {
+                vsh_set_field(vsh_ins, swizzle_field[j][k], GET_SWZ(reg.Swizzle, k));
+            }
+        }
+    }
+}
+
+// Encodes the program into vsh_buf, returns the number of slots
+static unsigned int assemble(struct prog_instruction *instructions, unsigned int num_instructions,
+                             bool optimize, uint32_t *vsh_buf)
+{
+    memset(vsh_buf, 0, MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS * VSH_TOKEN_SIZE * sizeof(uint32_t));
+
+    uint32_t* vsh_ins = vsh_buf;
+
+    VshSlot slots[MAX_NV_VERTEX_PROGRAM_INSTRUCTIONS];
+    unsigned int num_slots = vsh_optimize(instructions, num_instructions, slots, optimize);
+
+    int i;
+    for (i=0; i<num_slots; i++) {
+        vsh_set_field(vsh_ins, FLD_ILU, ILU_NOP);
+        vsh_set_field(vsh_ins, FLD_MAC, MAC_NOP);
+        vsh_set_field(vsh_ins, FLD_A_SWZ_X, SWIZZLE_X);
+        vsh_set_field(vsh_ins, FLD_A_SWZ_Y, SWIZZLE_Y);
+        vsh_set_field(vsh_ins, FLD_A_SWZ_Z, SWIZZLE_Z);
+        vsh_set_field(vsh_ins, FLD_A_SWZ_W, SWIZZLE_W);
+        vsh_set_field(vsh_ins, FLD_A_MUX, PARAM_V);
+        vsh_set_field(vsh_ins, FLD_B_SWZ_X, SWIZZLE_X);
+        vsh_set_field(vsh_ins, FLD_B_SWZ_Y, SWIZZLE_Y);
+        vsh_set_field(vsh_ins, FLD_B_SWZ_Z, SWIZZLE_Z);
+        vsh_set_field(vsh_ins, FLD_B_SWZ_W, SWIZZLE_W);
+        vsh_set_field(vsh_ins, FLD_B_MUX, PARAM_V);
+        vsh_set_field(vsh_ins, FLD_C_SWZ_X, SWIZZLE_X);
+        vsh_set_field(vsh_ins, FLD_C_SWZ_Y, SWIZZLE_Y);
+        vsh_set_field(vsh_ins, FLD_C_SWZ_Z, SWIZZLE_Z);
+        vsh_set_field(vsh_ins, FLD_C_SWZ_W, SWIZZLE_W);
+        vsh_set_field(vsh_ins, FLD_C_MUX, PARAM_V);
+        vsh_set_field(vsh_ins, FLD_OUT_R, 7);
+        vsh_set_field(vsh_ins, FLD_OUT_ADDRESS, 0xff);
+        vsh_set_field(vsh_ins, FLD_OUT_MUX, OMUX_MAC);
+
+        if (slots[i].mac >= 0) {
+            vsh_encode(vsh_ins, instructions[slots[i].mac], false);
+        }
+        if (slots[i].ilu >= 0) {
+            vsh_encode(vsh_ins, instructions[slots[i].ilu], slots[i].mac >= 0);
+        }
+
+        vsh_ins += 4;
+    }
+
+    if (num_slots) {
+        vsh_set_field(vsh_ins-4, FLD_FINAL, 1);
+    }
+
+    return num_slots;
+}
+static void vp20_copy_message(Vp20Message *dst, const struct nv_parse_message *src)
+{
+    dst->line = src->line;
+    dst->column = src->column;
+    snprintf(dst->message, sizeof(dst->message), "%s", src->message);
+}
+
+bool vp20_compile(const char *source, bool optimize, Vp20Result *result)
+{
+    struct prog_instruction *instructions = NULL;
+    unsigned int num_instructions = 0;
+    struct nv_parse_log log;
+
+    result->num_slots = 0;
+    result->num_instructions = 0;
+
+    int r = parse_nv_vertex_program(source, &instructions, &num_instructions, &log);
+
+    vp20_copy_message(&result->error, &log.error);
+    result->num_warnings = log.numWarnings;
+    unsigned int i;
+    for (i=0; i<log.numWarnings; i++) {
+        vp20_copy_message(&result->warnings[i], &log.warnings[i]);
+    }
+
+    if (r) {
+        return false;
+    }
+
+    while (result->num_instructions < num_instructions &&
+           instructions[result->num_instructions].Opcode != OPCODE_END) {
+        result->num_instructions++;
+    }
+
+    result->num_slots = assemble(instructions, num_instructions, optimize, result->tokens);
+    _mesa_free_instructions(instructions, num_instructions);
+
+    return true;
+}
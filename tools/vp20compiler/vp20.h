@@ -0,0 +1,45 @@
+#ifndef VP20_H
+#define VP20_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Slots of the transform program and DWORDs per slot
+#define VP20_MAX_SLOTS  136
+#define VP20_TOKEN_SIZE 4
+
+// Further warnings are dropped
+#define VP20_MAX_WARNINGS 16
+
+typedef struct Vp20Message {
+    int line; // 0 if the message isn't tied to a position
+    int column;
+    char message[256];
+} Vp20Message;
+
+typedef struct Vp20Result {
+    // num_slots * VP20_TOKEN_SIZE DWORDs, the last slot has the final bit set
+    uint32_t tokens[VP20_MAX_SLOTS * VP20_TOKEN_SIZE];
+    unsigned int num_slots;
+    // Instructions of the source program, not counting END
+    unsigned int num_instructions;
+    Vp20Message error;
+    unsigned int num_warnings;
+    Vp20Message warnings[VP20_MAX_WARNINGS];
+} Vp20Result;
+
+// Compiles an NV_vertex_program (!!VP1.0, !!VP1.1 or !!VSP1.0) into
+// transform program tokens. All state lives in the call and the result, so
+// any number of threads may compile at once. Returns false and fills in
+// result->error on failure.
+bool vp20_compile(const char *source, bool optimize, Vp20Result *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#include "vsh.h"
+
+static const VshFieldMapping field_mapping[] = {
+    // Field Name         DWORD BitPos BitSize
+    {  FLD_ILU,              1,   25,     3 },
+    {  FLD_MAC,              1,   21,     4 },
+    {  FLD_CONST,            1,   13,     8 },
+    {  FLD_V,                1,    9,     4 },
+    // INPUT A
+    {  FLD_A_NEG,            1,    8,     1 },
+    {  FLD_A_SWZ_X,          1,    6,     2 },
+    {  FLD_A_SWZ_Y,          1,    4,     2 },
+    {  FLD_A_SWZ_Z,          1,    2,     2 },
+    {  FLD_A_SWZ_W,          1,    0,     2 },
+    {  FLD_A_R,              2,   28,     4 },
+    {  FLD_A_MUX,            2,   26,     2 },
+    // INPUT B
+    {  FLD_B_NEG,            2,   25,     1 },
+    {  FLD_B_SWZ_X,          2,   23,     2 },
+    {  FLD_B_SWZ_Y,          2,   21,     2 },
+    {  FLD_B_SWZ_Z,          2,   19,     2 },
+    {  FLD_B_SWZ_W,          2,   17,     2 },
+    {  FLD_B_R,              2,   13,     4 },
+    {  FLD_B_MUX,            2,   11,     2 },
+    // INPUT C
+    {  FLD_C_NEG,            2,   10,     1 },
+    {  FLD_C_SWZ_X,          2,    8,     2 },
+    {  FLD_C_SWZ_Y,          2,    6,     2 },
+    {  FLD_C_SWZ_Z,          2,    4,     2 },
+    {  FLD_C_SWZ_W,          2,    2,     2 },
+    {  FLD_C_R_HIGH,         2,    0,     2 },
+    {  FLD_C_R_LOW,          3,   30,     2 },
+    {  FLD_C_MUX,            3,   28,     2 },
+    // Output
+    {  FLD_OUT_MAC_MASK,     3,   24,     4 },
+    {  FLD_OUT_R,            3,   20,     4 },
+    {  FLD_OUT_ILU_MASK,     3,   16,     4 },
+    {  FLD_OUT_O_MASK,       3,   12,     4 },
+    {  FLD_OUT_ORB,          3,   11,     1 },
+    {  FLD_OUT_ADDRESS,      3,    3,     8 },
+    {  FLD_OUT_MUX,          3,    2,     1 },
+    // Other
+    {  FLD_A0X,              3,    1,     1 },
+    {  FLD_FINAL,            3,    0,     1 }
+};
+
+void vsh_set_field(uint32_t *shader_token, VshFieldName field_name, uint8_t v)
+{
+    if (field_name == FLD_C_R) {
+        vsh_set_field(shader_token, FLD_C_R_LOW, v & 3);
+        vsh_set_field(shader_token, FLD_C_R_HIGH, (v >> 2));
+        return;
+    }
+    VshFieldMapping f = field_mapping[field_name];
+    uint32_t f_bits = (1<<f.bit_length)-1;
+    shader_token[f.subtoken] &= ~(f_bits << f.start_bit);
+    shader_token[f.subtoken] |= (uint32_t)(v & f_bits) << f.start_bit;
+}
+
+uint8_t vsh_get_field(const uint32_t *shader_token, VshFieldName field_name)
+{
+    if (field_name == FLD_C_R) {
+        return (vsh_get_field(shader_token, FLD_C_R_HIGH) << 2) |
+               vsh_get_field(shader_token, FLD_C_R_LOW);
+    }
+    VshFieldMapping f = field_mapping[field_name];
+    uint32_t f_bits = (1<<f.bit_length)-1;
+    return (shader_token[f.subtoken] >> f.start_bit) & f_bits;
+}
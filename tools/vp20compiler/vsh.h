@@ -0,0 +1,135 @@
+#ifndef VSH_H
+#define VSH_H
+
+#include <stdint.h>
+
+#define VSH_TOKEN_SIZE 4
+
+typedef enum {
+    FLD_ILU = 0,
+    FLD_MAC,
+    FLD_CONST,
+    FLD_V,
+    // Input A
+    FLD_A_NEG,
+    FLD_A_SWZ_X,
+    FLD_A_SWZ_Y,
+    FLD_A_SWZ_Z,
+    FLD_A_SWZ_W,
+    FLD_A_R,
+    FLD_A_MUX,
+    // Input B
+    FLD_B_NEG,
+    FLD_B_SWZ_X,
+    FLD_B_SWZ_Y,
+    FLD_B_SWZ_Z,
+    FLD_B_SWZ_W,
+    FLD_B_R,
+    FLD_B_MUX,
+    // Input C
+    FLD_C_NEG,
+    FLD_C_SWZ_X,
+    FLD_C_SWZ_Y,
+    FLD_C_SWZ_Z,
+    FLD_C_SWZ_W,
+    FLD_C_R_HIGH,
+    FLD_C_R_LOW,
+    FLD_C_MUX,
+    // Output
+    FLD_OUT_MAC_MASK,
+    FLD_OUT_R,
+    FLD_OUT_ILU_MASK,
+    FLD_OUT_O_MASK,
+    FLD_OUT_ORB,
+    FLD_OUT_ADDRESS,
+    FLD_OUT_MUX,
+    // Relative addressing
+    FLD_A0X,
+    // Final instruction
+    FLD_FINAL,
+
+    FLD_C_R, //hax
+} VshFieldName;
+
+typedef enum {
+    PARAM_UNKNOWN = 0,
+    PARAM_R,
+    PARAM_V,
+    PARAM_C
+} VshParameterType;
+
+typedef enum {
+    OUTPUT_C = 0,
+    OUTPUT_O
+} VshOutputType;
+
+typedef enum {
+    OMUX_MAC = 0,
+    OMUX_ILU
+} VshOutputMux;
+
+typedef enum {
+    ILU_NOP = 0,
+    ILU_MOV,
+    ILU_RCP,
+    ILU_RCC,
+    ILU_RSQ,
+    ILU_EXP,
+    ILU_LOG,
+    ILU_LIT
+} VshILU;
+
+typedef enum {
+    MAC_NOP,
+    MAC_MOV,
+    MAC_MUL,
+    MAC_ADD,
+    MAC_MAD,
+    MAC_DP3,
+    MAC_DPH,
+    MAC_DP4,
+    MAC_DST,
+    MAC_MIN,
+    MAC_MAX,
+    MAC_SLT,
+    MAC_SGE,
+    MAC_ARL
+} VshMAC;
+
+// typedef enum {
+//     SWIZZLE_X = 0,
+//     SWIZZLE_Y,
+//     SWIZZLE_Z,
+//     SWIZZLE_W
+// } VshSwizzle;
+
+
+typedef struct VshFieldMapping {
+    VshFieldName field_name;
+    uint8_t subtoken;
+    uint8_t start_bit;
+    uint8_t bit_length;
+} VshFieldMapping;
+
+typedef enum {
+    MASK_W = 1,   
+    MASK_Z,   
+    MASK_ZW,  
+    MASK_Y,   
+    MASK_YW,  
+    MASK_YZ,  
+    MASK_YZW, 
+    MASK_X,   
+    MASK_XW,  
+    MASK_XZ,  
+    MASK_XZW, 
+    MASK_XY,  
+    MASK_XYW, 
+    MASK_XYZ, 
+    MASK_XYZW,
+} VshMask;
+
+void vsh_set_field(uint32_t *shader_token, VshFieldName field_name, uint8_t v);
+uint8_t vsh_get_field(const uint32_t *shader_token, VshFieldName field_name);
+
+#endif